@@ -0,0 +1,90 @@
+//
+// BufferCompare.cpp: assert_equal against assert_equal_range/_bytes on
+// 100MB buffers, for both matching and mismatching data.
+// Run from the Linux directory: make bench
+//
+
+#include "../../quick_unit.hpp"
+#include "../../quick_unit_buffers.hpp"
+#include "../../quick_unit_bench.hpp"
+
+namespace {
+  const size_t size = 100 * 1024 * 1024;
+
+  double seconds_since(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+}
+
+// ----------------------------
+ADDITIONAL_REPORTER(BenchEnvironment)
+BEGIN_SUITE(Buffer comparison benchmarks)
+  std::string expected;
+  std::string actual;
+  SETUP_SUITE {
+    expected.assign(size, 'q');
+    actual = expected;
+  }
+  TEARDOWN_SUITE {
+    expected.clear();
+    actual.clear();
+  }
+END_SUITE_AS(data)
+
+TEST(Matching 100MB strings) {
+  clock_t start = clock();
+  Qu_Result old_way = equal(data.expected, data.actual);
+  double old_time = seconds_since(start);
+  start = clock();
+  Qu_Result new_way = equal_range(data.expected, data.actual);
+  double new_time = seconds_since(start);
+  printf("assert_equal:       %8.4fs\nassert_equal_range: %8.4fs\n", old_time, new_time);
+  assert(old_way.pass && new_way.pass, SHOULD(both match));
+}
+
+TEST(Mismatching 100MB strings) {
+  data.actual[size - 10] = 'x';
+  clock_t start = clock();
+  Qu_Result old_way = equal(data.expected, data.actual);
+  double old_time = seconds_since(start);
+  start = clock();
+  Qu_Result new_way = equal_range(data.expected, data.actual);
+  double new_time = seconds_since(start);
+  data.actual[size - 10] = 'q';
+  printf("assert_equal:       %8.4fs, message of %lu bytes\n", old_time, (unsigned long)old_way.msg.length());
+  printf("assert_equal_range: %8.4fs, message of %lu bytes\n", new_time, (unsigned long)new_way.msg.length());
+  assert(!old_way.pass && !new_way.pass, SHOULD(both fail));
+}
+
+TEST(Matching 100MB of ints) {
+  std::vector<int> x(size / sizeof(int), 42);
+  std::vector<int> y(x);
+  clock_t start = clock();
+  bool all_equal = true;
+  for (size_t i = 0; i < x.size(); i++) {
+    all_equal = equal(x[i], y[i]).pass && all_equal; // One assert_equal per element
+  }
+  double old_time = seconds_since(start);
+  start = clock();
+  Qu_Result new_way = equal_range(x, y);
+  double new_time = seconds_since(start);
+  printf("assert_equal per element: %8.4fs\nassert_equal_range:       %8.4fs\n", old_time, new_time);
+  assert(all_equal && new_way.pass, SHOULD(both match));
+}
+
+TEST(Raw 100MB buffers) {
+  clock_t start = clock();
+  bool old_way = memcmp(data.expected.data(), data.actual.data(), size) == 0;
+  double old_time = seconds_since(start);
+  start = clock();
+  Qu_Result new_way = equal_bytes(data.expected.data(), data.actual.data(), size);
+  double new_time = seconds_since(start);
+  printf("memcmp:             %8.4fs\nassert_equal_bytes: %8.4fs\n", old_time, new_time);
+  assert(old_way && new_way.pass, SHOULD(both match));
+}
+
+// ----------------------------
+int main(int argc, char *argv[]) {
+  TEST_ARGS(argc, argv);
+  return RUN_TESTS();
+}
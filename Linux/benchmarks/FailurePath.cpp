@@ -0,0 +1,77 @@
+//
+// FailurePath.cpp: the cost of failing, as in a property run where most
+// cases fail. Built twice by make bench: once with exceptions, and once with
+// -fno-exceptions, where failures longjmp instead.
+// Run from the Linux directory: make bench
+//
+
+#include "../../quick_unit.hpp"
+#include "../../quick_unit_bench.hpp"
+
+namespace {
+  const int cases = 200000;
+  const int depth = 8;
+
+  double seconds_since(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+
+  // A property checked a few calls down, as it usually is
+  EXTEND_TEST(Property)
+    int value;
+    void Run(void) { Check(depth); }
+    void Check(int level) {
+      char frame[32]; // Something on each frame for the failure to unwind
+      sprintf(frame, "%d", level);
+      if (level) {
+        Check(level - 1);
+      } else {
+        assert(value % 10 == 0, "Hold");
+      }
+    }
+  END_EXTEND_TEST
+
+  void run(void *test) {
+    ((QUTest *)test)->Run();
+  }
+
+  // Runs the cases with the given value, and returns how many failed
+  int run_cases(Property &property, int step, double &seconds) {
+    int failed = 0;
+    clock_t start = clock();
+    for (int i = 0; i < cases; i++) {
+      property.Reset();
+      property.value = i * step;
+      failed += QUTestFail::Catch(run, &property) ? 1 : 0;
+    }
+    seconds = seconds_since(start);
+    return failed;
+  }
+}
+
+// ----------------------------
+ADDITIONAL_REPORTER(BenchEnvironment)
+DECLARE_SUITE(Failure path benchmarks)
+
+TEST(Passing and failing cases) {
+  #ifdef QU_NO_EXCEPTIONS
+  const char *mode = "longjmp";
+  #else
+  const char *mode = "exceptions";
+  #endif
+  Property property("property");
+  QUAssertionLock::ThrowsFailures() = true;
+  double passing_time, failing_time;
+  int passing_fails = run_cases(property, 10, passing_time);
+  int failing_fails = run_cases(property, 1, failing_time);
+  printf("%-10s %d passing cases: %8.4fs (%5.0f ns each)\n", mode, cases, passing_time, passing_time * 1e9 / cases);
+  printf("%-10s %d mostly failing cases: %8.4fs (%5.0f ns each)\n", mode, cases, failing_time, failing_time * 1e9 / cases);
+  assert_equal(0, passing_fails, SHOULD(pass every case));
+  assert_equal(cases - cases / 10, failing_fails, SHOULD(fail nine cases in ten));
+}
+
+// ----------------------------
+int main(int argc, char *argv[]) {
+  TEST_ARGS(argc, argv);
+  return RUN_TESTS();
+}
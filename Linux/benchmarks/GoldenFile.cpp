@@ -0,0 +1,57 @@
+//
+// GoldenFile.cpp: reading a 100MB golden file into a string and comparing,
+// against assert_matches_golden mapping it.
+// Run from the Linux directory: make bench
+//
+
+#include <fstream>
+#include "../../quick_unit.hpp"
+#include "../../quick_unit_golden.hpp"
+#include "../../quick_unit_bench.hpp"
+
+namespace {
+  const size_t size = 100 * 1024 * 1024;
+  const char *path = "build/bench/golden.tmp";
+
+  double seconds_since(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+}
+
+// ----------------------------
+ADDITIONAL_REPORTER(BenchEnvironment)
+BEGIN_SUITE(Golden file benchmarks)
+  std::string output;
+  SETUP_SUITE {
+    output.assign(size, 'g');
+    FILE *file = fopen(path, "wb");
+    fwrite(output.data(), 1, output.size(), file);
+    fclose(file);
+  }
+  TEARDOWN_SUITE {
+    output.clear();
+    remove(path);
+  }
+END_SUITE_AS(data)
+
+TEST(Matching a 100MB golden file) {
+  clock_t start = clock();
+  std::ifstream file(path, std::ios::binary);
+  std::string golden((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  bool old_way = golden == data.output;
+  double old_time = seconds_since(start);
+  start = clock();
+  Qu_Result first = matches_golden(path, data.output);
+  double first_time = seconds_since(start);
+  start = clock();
+  Qu_Result again = matches_golden(path, data.output);
+  double again_time = seconds_since(start);
+  printf("Read into a string:           %8.4fs\nassert_matches_golden:        %8.4fs\nassert_matches_golden again:  %8.4fs\n", old_time, first_time, again_time);
+  assert(old_way && first.pass && again.pass, SHOULD(all match));
+}
+
+// ----------------------------
+int main(int argc, char *argv[]) {
+  TEST_ARGS(argc, argv);
+  return RUN_TESTS();
+}
@@ -0,0 +1,76 @@
+//
+// LogScan.cpp: one includes/excludes per pattern against a single
+// assert_include_all/assert_exclude_any pass, on a 64MB log.
+// Run from the Linux directory: make bench
+//
+
+#include "../../quick_unit.hpp"
+#include "../../quick_unit_text.hpp"
+#include "../../quick_unit_bench.hpp"
+
+namespace {
+  const size_t size = 64 * 1024 * 1024;
+  const int pattern_count = 40;
+
+  double seconds_since(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+}
+
+// ----------------------------
+ADDITIONAL_REPORTER(BenchEnvironment)
+BEGIN_SUITE(Log scan benchmarks)
+  std::string log;
+  std::vector<std::string> present, absent;
+  SETUP_SUITE {
+    char line[100];
+    for (int i = 0; log.size() < size; i++) {
+      log.append(line, sprintf(line, "%08d INFO worker %d finished job %d in %d ms\n", i, i % 16, i * 7, i % 1000));
+    }
+    for (int i = 0; i < pattern_count; i++) {
+      sprintf(line, "event-%d", i);
+      absent.push_back(line);
+      log.append(line).append("\n");
+      present.push_back(line);
+      sprintf(line, "missing-%d", i);
+      absent.back() = line;
+    }
+  }
+  TEARDOWN_SUITE {
+    log.clear();
+  }
+END_SUITE_AS(data)
+
+TEST(Finding 40 patterns at the end of 64MB) {
+  clock_t start = clock();
+  bool old_way = true;
+  for (int i = 0; i < pattern_count; i++) {
+    old_way = includes(data.present[i].c_str(), data.log.c_str()).pass && old_way;
+  }
+  double old_time = seconds_since(start);
+  start = clock();
+  Qu_Result new_way = includes_all(data.present, data.log);
+  double new_time = seconds_since(start);
+  printf("includes per pattern: %8.4fs\nincludes_all:         %8.4fs\n", old_time, new_time);
+  assert(old_way && new_way.pass, SHOULD(both find them all));
+}
+
+TEST(Excluding 40 patterns from 64MB) {
+  clock_t start = clock();
+  bool old_way = true;
+  for (int i = 0; i < pattern_count; i++) {
+    old_way = excludes(data.absent[i].c_str(), data.log.c_str()).pass && old_way;
+  }
+  double old_time = seconds_since(start);
+  start = clock();
+  Qu_Result new_way = excludes_any(data.absent, data.log);
+  double new_time = seconds_since(start);
+  printf("excludes per pattern: %8.4fs\nexcludes_any:         %8.4fs\n", old_time, new_time);
+  assert(old_way && new_way.pass, SHOULD(both find none));
+}
+
+// ----------------------------
+int main(int argc, char *argv[]) {
+  TEST_ARGS(argc, argv);
+  return RUN_TESTS();
+}
@@ -0,0 +1,67 @@
+//
+// NumericClose.cpp: near() per element against assert_all_close and
+// assert_all_close_ulps on 100MB of doubles and floats.
+// Run from the Linux directory: make bench
+//
+
+#include "../../quick_unit.hpp"
+#include "../../quick_unit_numeric.hpp"
+#include "../../quick_unit_bench.hpp"
+
+namespace {
+  const size_t size = 100 * 1024 * 1024;
+
+  double seconds_since(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+}
+
+// ----------------------------
+ADDITIONAL_REPORTER(BenchEnvironment)
+BEGIN_SUITE(Numeric comparison benchmarks)
+END_SUITE
+
+TEST(Close 100MB of doubles) {
+  std::vector<double> x(size / sizeof(double));
+  for (size_t i = 0; i < x.size(); i++) {
+    x[i] = i * 0.5;
+  }
+  std::vector<double> y(x);
+  y[y.size() / 2] += 1.0;
+  clock_t start = clock();
+  size_t violations = 0;
+  for (size_t i = 0; i < x.size(); i++) {
+    violations += near(x[i], y[i], 1e-9 + 1e-9 * fabs(x[i])).pass ? 0 : 1; // One assert_near per element
+  }
+  double old_time = seconds_since(start);
+  start = clock();
+  Qu_Result new_way = all_close(x, y, 1e-9, 1e-9);
+  double new_time = seconds_since(start);
+  printf("assert_near per element: %8.4fs\nassert_all_close:        %8.4fs\n", old_time, new_time);
+  assert(violations == 1 && !new_way.pass, SHOULD(both find the one violation));
+}
+
+TEST(Close 100MB of floats in ULPs) {
+  std::vector<float> x(size / sizeof(float));
+  for (size_t i = 0; i < x.size(); i++) {
+    x[i] = i * 0.25f;
+  }
+  std::vector<float> y(x);
+  clock_t start = clock();
+  size_t violations = 0;
+  for (size_t i = 0; i < x.size(); i++) {
+    violations += quick_unit::QUCloseCompare<float>::UlpDistance(x[i], y[i]) > 4 ? 1 : 0;
+  }
+  double old_time = seconds_since(start);
+  start = clock();
+  Qu_Result new_way = all_close_ulps(x, y, 4);
+  double new_time = seconds_since(start);
+  printf("ULP distance per element: %8.4fs\nassert_all_close_ulps:    %8.4fs\n", old_time, new_time);
+  assert(violations == 0 && new_way.pass, SHOULD(both match));
+}
+
+// ----------------------------
+int main(int argc, char *argv[]) {
+  TEST_ARGS(argc, argv);
+  return RUN_TESTS();
+}
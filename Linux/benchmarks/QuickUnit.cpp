@@ -0,0 +1,6 @@
+//
+// QuickUnit.cpp: The one file that compiles the quick_unit runner and
+// reporters when the tests are built with QU_DECLARATIONS_ONLY.
+//
+#define QU_IMPLEMENTATION
+#include "../../quick_unit.hpp"
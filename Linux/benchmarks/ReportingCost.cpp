@@ -0,0 +1,97 @@
+//
+// ReportingCost.cpp: 100k tiny tests reported in Netbeans format, by a
+// reporter that reworks each name for every event, by the Netbeans
+// reporter, which uses names interned when the tests were made, and by the
+// Netbeans reporter in a set, which the runner calls without going through
+// each of its events.
+// Run from the Linux directory: make bench
+//
+
+#include "../../quick_unit.hpp"
+#include "../../quick_unit_netbeans.hpp"
+#include "../../quick_unit_reporters.hpp"
+#include <algorithm>
+
+// How the Netbeans reporter worked before names were interned
+BEGIN_REPORTER(ByName)
+  clock_t started;
+  double seconds;
+  void StartingSuite(const std::string &suite_name) { started = clock(); }
+  void CompletedSuite(const std::string &suite_name, double duration, unsigned passes, unsigned fails) {
+    seconds = (double)(clock() - started) / CLOCKS_PER_SEC;
+  }
+  void StartingTest(const std::string &suite_name, const std::string &test_name) {
+    Output() << "%TEST_STARTED% " << without_whitespace(test_name) << " (" << suite_name << ")" << std::endl;
+  }
+  void CompletedTest(const std::string &suite_name, const std::string &test_name, double duration) {
+    Output() << "%TEST_FINISHED% time=" << std::fixed << duration << " " << without_whitespace(test_name) << " (" << suite_name << ")" << std::endl;
+  }
+  std::string without_whitespace(const std::string &str) {
+    std::string rep(str);
+    std::replace( rep.begin(), rep.end(), ' ', '_' );
+    return rep;
+  }
+END_REPORTER()
+
+namespace {
+  const int test_count = 100000;
+
+  class NullBuffer : public std::streambuf {
+  protected:
+    int overflow(int c) { return c; }
+    std::streamsize xsputn(const char *, std::streamsize count) { return count; }
+  };
+
+  EXTEND_TEST(Tiny)
+    void Run(void) { assert(true); }
+  END_EXTEND_TEST
+
+  // The Netbeans reporter, timed
+  class ByIdReporter : public quick_unit::NetbeansReporter {
+  public:
+    clock_t started;
+    double seconds;
+    void StartingSuiteById(QUNameId suite) { started = clock(); }
+    void CompletedSuiteById(QUNameId suite, double duration, unsigned passes, unsigned fails) {
+      seconds = (double)(clock() - started) / CLOCKS_PER_SEC;
+    }
+  };
+
+  class Suite : public QUTestSuite {
+  public:
+    std::vector<Tiny *> tests;
+    Suite(const char *name) : QUTestSuite(name) {
+      for (int i = 0; i < test_count; i++) {
+        char test_name[64];
+        sprintf(test_name, "tiny test number %d of many", i);
+        tests.push_back(new Tiny(test_name));
+        Add(tests.back());
+      }
+    }
+  };
+}
+
+// ----------------------------
+int main(int argc, char *argv[]) {
+  TEST_ARGS(argc, argv);
+  NullBuffer null_buffer;
+  std::ostream null_stream(&null_buffer);
+  quick_unit::ByNameReporter by_name;
+  ByIdReporter by_id;
+  quick_unit::QUReporterSet<ByIdReporter> in_set;
+  // Each suite takes the reporter current when it is made. The last suite
+  // runs the ones before it first.
+  QUTestSuiteTracker::CurrentQUReporter(&by_name);
+  Suite first("Reported by name");
+  QUTestSuiteTracker::CurrentQUReporter(&by_id);
+  Suite second("Reported by id");
+  QUTestSuiteTracker::CurrentQUReporter(&in_set);
+  Suite third("Reported by a set");
+  TEST_OUTPUT(null_stream);
+  int fails = third.RunAll();
+  TEST_OUTPUT(std::cout);
+  printf("%d tests reported by name: %8.4fs\n", test_count, by_name.seconds);
+  printf("%d tests reported by id:   %8.4fs\n", test_count, by_id.seconds);
+  printf("%d tests reported by a set: %8.4fs\n", test_count, in_set.first().seconds);
+  return fails;
+}
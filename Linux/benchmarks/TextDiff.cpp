@@ -0,0 +1,78 @@
+//
+// TextDiff.cpp: assert_equal failures on 100MB strings, with and without
+// quick_unit_diff.hpp.
+// Run from the Linux directory: make bench
+//
+
+#include "../../quick_unit.hpp"
+
+namespace {
+  const size_t size = 100 * 1024 * 1024;
+
+  double seconds_since(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+
+  std::string lines(const char *prefix) {
+    std::string text;
+    text.reserve(size + 100);
+    char line[64];
+    for (int i = 0; text.size() < size; i++) {
+      text.append(line, sprintf(line, "%s %d\n", prefix, i));
+    }
+    return text;
+  }
+
+  // assert_equal's matcher before the diff add-in is included
+  Qu_Result plain_equal(quick_unit::QUTest &test, const std::string &a, const std::string &b);
+}
+
+#include "../../quick_unit_diff.hpp"
+#include "../../quick_unit_bench.hpp"
+
+// ----------------------------
+ADDITIONAL_REPORTER(BenchEnvironment)
+BEGIN_SUITE(Text diff benchmarks)
+  std::string expected;
+  SETUP_SUITE {
+    expected = lines("line");
+  }
+  TEARDOWN_SUITE {
+    expected.clear();
+  }
+END_SUITE_AS(data)
+
+TEST(One changed line in 100MB) {
+  std::string actual(data.expected);
+  actual[size / 2] = '#';
+  clock_t start = clock();
+  Qu_Result old_way = plain_equal(*this, data.expected, actual);
+  double old_time = seconds_since(start);
+  start = clock();
+  Qu_Result new_way = equal(data.expected, actual);
+  double new_time = seconds_since(start);
+  printf("Whole strings: %8.4fs, message of %lu bytes\n", old_time, (unsigned long)old_way.msg.length());
+  printf("Diff:          %8.4fs, message of %lu bytes\n", new_time, (unsigned long)new_way.msg.length());
+  assert(!old_way.pass && !new_way.pass, SHOULD(both fail));
+}
+
+TEST(100MB of unrelated lines) {
+  std::string actual = lines("other");
+  clock_t start = clock();
+  Qu_Result new_way = equal(data.expected, actual);
+  double new_time = seconds_since(start);
+  printf("Diff:          %8.4fs, message of %lu bytes\n", new_time, (unsigned long)new_way.msg.length());
+  assert(!new_way.pass, SHOULD(fail));
+}
+
+namespace {
+  Qu_Result plain_equal(quick_unit::QUTest &test, const std::string &a, const std::string &b) {
+    return test.quick_unit::QUTest::equal(a, b);
+  }
+}
+
+// ----------------------------
+int main(int argc, char *argv[]) {
+  TEST_ARGS(argc, argv);
+  return RUN_TESTS();
+}
@@ -0,0 +1,63 @@
+#!/bin/sh
+#
+# compile_time.sh: Times the compilation of each test file, first with the
+# whole of quick_unit.hpp and then with QU_DECLARATIONS_ONLY, and checks that
+# the split build still links and runs, with and without QU_PROFILE_ASSERTIONS.
+# Run from the Linux directory: make compile-bench
+#
+CXX=${CXX:-g++}
+RUNS=${RUNS:-10}
+OUT=${OUT:-build/compile-bench}
+mkdir -p $OUT
+
+# Average milliseconds to compile a file: compile_ms <file> [flags...]
+compile_ms() {
+  file=$1; shift
+  start=`date +%s%N`
+  i=0
+  while [ $i -lt $RUNS ]; do
+    $CXX -c -I. "$@" -o $OUT/bench.o $file || exit 1
+    i=`expr $i + 1`
+  done
+  end=`date +%s%N`
+  expr \( $end - $start \) / 1000000 / $RUNS
+}
+
+# Flags that a test file needs to compile at all
+flags_for() {
+  case `basename $1` in
+    AsyncTests.cpp) echo -std=c++20 ;;
+    NoExceptions.cpp) echo -fno-exceptions ;;
+    AssertionSites.cpp) echo -DQU_PROFILE_ASSERTIONS ;;
+  esac
+}
+
+printf "%-28s %12s %12s\n" "Translation unit" "Header-only" "Split"
+full_total=0
+split_total=0
+for file in tests/*.cpp; do
+  full=`compile_ms $file \`flags_for $file\``
+  split=`compile_ms $file -DQU_DECLARATIONS_ONLY \`flags_for $file\``
+  full_total=`expr $full_total + $full`
+  split_total=`expr $split_total + $split`
+  printf "%-28s %9s ms %9s ms\n" `basename $file` $full $split
+done
+impl=`compile_ms benchmarks/QuickUnit.cpp -DQU_DECLARATIONS_ONLY`
+printf "%-28s %12s %9s ms\n" "QuickUnit.cpp (once)" "-" $impl
+printf "%-28s %9s ms %9s ms\n" "Total" $full_total `expr $split_total + $impl`
+
+# The split build must still link: every test file without a main(), plus one with it
+objects=""
+for file in `grep -L "int main" tests/*.cpp` tests/MoreExamples.cpp benchmarks/QuickUnit.cpp ../code_under_test/vcl.cpp; do
+  object=$OUT/`basename $file .cpp`.o
+  $CXX -c -I. -DQU_DECLARATIONS_ONLY `flags_for $file` -o $object $file || exit 1
+  objects="$objects $object"
+done
+$CXX -o $OUT/split_tests $objects && $OUT/split_tests > $OUT/split_tests.txt
+echo "Split build: `grep -c 'OK\.' $OUT/split_tests.txt` tests passed, `grep -c 'FAILED\.' $OUT/split_tests.txt` failed"
+
+# So must a program built with QU_PROFILE_ASSERTIONS, which every file in it shares
+$CXX -c -I. -DQU_DECLARATIONS_ONLY -DQU_PROFILE_ASSERTIONS -o $OUT/QuickUnitSites.o benchmarks/QuickUnit.cpp || exit 1
+$CXX -c -I. -DQU_DECLARATIONS_ONLY -DQU_PROFILE_ASSERTIONS -o $OUT/AssertionSites.o tests/AssertionSites.cpp || exit 1
+$CXX -o $OUT/split_sites $OUT/QuickUnitSites.o $OUT/AssertionSites.o && $OUT/split_sites > $OUT/split_sites.txt
+echo "Split build with QU_PROFILE_ASSERTIONS: `grep -c 'OK\.' $OUT/split_sites.txt` tests passed, `grep -c 'FAILED\.' $OUT/split_sites.txt` failed"
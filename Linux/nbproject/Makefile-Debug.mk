@@ -42,7 +42,9 @@ TESTDIR=build/${CND_CONF}/${CND_PLATFORM}/tests
 # Test Files
 TESTFILES= \
 	${TESTDIR}/TestFiles/f2 \
-	${TESTDIR}/TestFiles/f1
+	${TESTDIR}/TestFiles/f1 \
+	${TESTDIR}/TestFiles/f3 \
+	${TESTDIR}/TestFiles/f4
 
 # C Compiler Flags
 CFLAGS=
@@ -81,7 +83,7 @@ ${OBJECTDIR}/Linux.o: Linux.cpp
 
 # Build Test Targets
 .build-tests-conf: .build-conf ${TESTFILES}
-${TESTDIR}/TestFiles/f2: ${TESTDIR}/tests/MoreExamples.o ${TESTDIR}/tests/RequireSyntax.o ${TESTDIR}/tests/VerifySyntax.o ${OBJECTFILES:%.o=%_nomain.o}
+${TESTDIR}/TestFiles/f2: ${TESTDIR}/tests/MoreExamples.o ${TESTDIR}/tests/RequireSyntax.o ${TESTDIR}/tests/VerifySyntax.o ${TESTDIR}/tests/FuzzTests.o ${TESTDIR}/tests/StaticTests.o ${TESTDIR}/tests/BufferAssertions.o ${TESTDIR}/tests/NumericAssertions.o ${TESTDIR}/tests/DiffAssertions.o ${TESTDIR}/tests/GoldenFiles.o ${TESTDIR}/tests/TextMatchers.o ${TESTDIR}/tests/PooledFixtures.o ${TESTDIR}/tests/LazyFixtures.o ${TESTDIR}/tests/ForkedTests.o ${TESTDIR}/tests/ThreadedAssertions.o ${TESTDIR}/tests/InterleavedTests.o ${TESTDIR}/tests/AsyncTests.o ${TESTDIR}/tests/ReporterIds.o ${TESTDIR}/tests/ReporterSets.o ${TESTDIR}/tests/TraceEvents.o ${TESTDIR}/tests/ProfiledTests.o ${TESTDIR}/tests/ProfilerMarkers.o ${TESTDIR}/tests/TestMetrics.o ${TESTDIR}/tests/LatencyAssertions.o ${TESTDIR}/tests/TimeBudgets.o ${TESTDIR}/tests/BenchEnvironment.o ${OBJECTFILES:%.o=%_nomain.o}
 	${MKDIR} -p ${TESTDIR}/TestFiles
 	${LINK.cc} -o ${TESTDIR}/TestFiles/f2 $^ ${LDLIBSOPTIONS} 
 
@@ -89,6 +91,14 @@ ${TESTDIR}/TestFiles/f1: ${TESTDIR}/tests/VCLTests.o ${OBJECTFILES:%.o=%_nomain.
 	${MKDIR} -p ${TESTDIR}/TestFiles
 	${LINK.cc} -o ${TESTDIR}/TestFiles/f1 $^ ${LDLIBSOPTIONS} 
 
+${TESTDIR}/TestFiles/f3: ${TESTDIR}/tests/NoExceptions.o
+	${MKDIR} -p ${TESTDIR}/TestFiles
+	${LINK.cc} -o ${TESTDIR}/TestFiles/f3 $^ ${LDLIBSOPTIONS} 
+
+${TESTDIR}/TestFiles/f4: ${TESTDIR}/tests/AssertionSites.o
+	${MKDIR} -p ${TESTDIR}/TestFiles
+	${LINK.cc} -o ${TESTDIR}/TestFiles/f4 $^ ${LDLIBSOPTIONS} 
+
 
 ${TESTDIR}/tests/MoreExamples.o: tests/MoreExamples.cpp 
 	${MKDIR} -p ${TESTDIR}/tests
@@ -105,10 +115,128 @@ ${TESTDIR}/tests/VerifySyntax.o: tests/VerifySyntax.cpp
 	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/VerifySyntax.o tests/VerifySyntax.cpp
 
 
+${TESTDIR}/tests/FuzzTests.o: tests/FuzzTests.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/FuzzTests.o tests/FuzzTests.cpp
+
+
+${TESTDIR}/tests/StaticTests.o: tests/StaticTests.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/StaticTests.o tests/StaticTests.cpp
+
+
+${TESTDIR}/tests/BufferAssertions.o: tests/BufferAssertions.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/BufferAssertions.o tests/BufferAssertions.cpp
+
+
+${TESTDIR}/tests/NumericAssertions.o: tests/NumericAssertions.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/NumericAssertions.o tests/NumericAssertions.cpp
+
+
+${TESTDIR}/tests/DiffAssertions.o: tests/DiffAssertions.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/DiffAssertions.o tests/DiffAssertions.cpp
+
+
+${TESTDIR}/tests/GoldenFiles.o: tests/GoldenFiles.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/GoldenFiles.o tests/GoldenFiles.cpp
+
+
+${TESTDIR}/tests/TextMatchers.o: tests/TextMatchers.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/TextMatchers.o tests/TextMatchers.cpp
+
+
+${TESTDIR}/tests/PooledFixtures.o: tests/PooledFixtures.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/PooledFixtures.o tests/PooledFixtures.cpp
+
+
+${TESTDIR}/tests/LazyFixtures.o: tests/LazyFixtures.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/LazyFixtures.o tests/LazyFixtures.cpp
+
+
+${TESTDIR}/tests/ForkedTests.o: tests/ForkedTests.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/ForkedTests.o tests/ForkedTests.cpp
+
+
+${TESTDIR}/tests/ThreadedAssertions.o: tests/ThreadedAssertions.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/ThreadedAssertions.o tests/ThreadedAssertions.cpp
+
+
+${TESTDIR}/tests/InterleavedTests.o: tests/InterleavedTests.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/InterleavedTests.o tests/InterleavedTests.cpp
+
+
+${TESTDIR}/tests/AsyncTests.o: tests/AsyncTests.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -std=c++20 -I. -I. -o ${TESTDIR}/tests/AsyncTests.o tests/AsyncTests.cpp
+
+
+${TESTDIR}/tests/ReporterIds.o: tests/ReporterIds.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/ReporterIds.o tests/ReporterIds.cpp
+
+
+${TESTDIR}/tests/ReporterSets.o: tests/ReporterSets.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/ReporterSets.o tests/ReporterSets.cpp
+
+
+${TESTDIR}/tests/TraceEvents.o: tests/TraceEvents.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/TraceEvents.o tests/TraceEvents.cpp
+
+
+${TESTDIR}/tests/ProfiledTests.o: tests/ProfiledTests.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/ProfiledTests.o tests/ProfiledTests.cpp
+
+
+${TESTDIR}/tests/ProfilerMarkers.o: tests/ProfilerMarkers.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/ProfilerMarkers.o tests/ProfilerMarkers.cpp
+
+
+${TESTDIR}/tests/TestMetrics.o: tests/TestMetrics.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/TestMetrics.o tests/TestMetrics.cpp
+
+
+${TESTDIR}/tests/LatencyAssertions.o: tests/LatencyAssertions.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/LatencyAssertions.o tests/LatencyAssertions.cpp
+
+
+${TESTDIR}/tests/TimeBudgets.o: tests/TimeBudgets.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/TimeBudgets.o tests/TimeBudgets.cpp
+
+
+${TESTDIR}/tests/BenchEnvironment.o: tests/BenchEnvironment.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -I. -I. -o ${TESTDIR}/tests/BenchEnvironment.o tests/BenchEnvironment.cpp
+
+
 ${TESTDIR}/tests/VCLTests.o: tests/VCLTests.cpp 
 	${MKDIR} -p ${TESTDIR}/tests
 	$(COMPILE.cc) -g -I. -I. -I. -o ${TESTDIR}/tests/VCLTests.o tests/VCLTests.cpp
 
+${TESTDIR}/tests/NoExceptions.o: tests/NoExceptions.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -fno-exceptions -I. -o ${TESTDIR}/tests/NoExceptions.o tests/NoExceptions.cpp
+
+${TESTDIR}/tests/AssertionSites.o: tests/AssertionSites.cpp 
+	${MKDIR} -p ${TESTDIR}/tests
+	$(COMPILE.cc) -g -DQU_PROFILE_ASSERTIONS -I. -o ${TESTDIR}/tests/AssertionSites.o tests/AssertionSites.cpp
+
 
 ${OBJECTDIR}/_ext/194468644/vcl_nomain.o: ${OBJECTDIR}/_ext/194468644/vcl.o ../code_under_test/vcl.cpp 
 	${MKDIR} -p ${OBJECTDIR}/_ext/194468644
@@ -140,6 +268,8 @@ ${OBJECTDIR}/Linux_nomain.o: ${OBJECTDIR}/Linux.o Linux.cpp
 	then  \
 	    ${TESTDIR}/TestFiles/f2 || true; \
 	    ${TESTDIR}/TestFiles/f1 || true; \
+	    ${TESTDIR}/TestFiles/f3 || true; \
+	    ${TESTDIR}/TestFiles/f4 || true; \
 	else  \
 	    ./${TEST} || true; \
 	fi
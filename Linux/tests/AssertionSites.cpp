@@ -0,0 +1,125 @@
+//
+// AssertionSites.cpp: Assertions counted at each SHOULD(...), or at their line
+// Built with QU_PROFILE_ASSERTIONS, as a test program of its own: every file
+// in a program must agree on it.
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_static.hpp"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifdef QU_PROFILE_ASSERTIONS
+namespace {
+  QUAssertionSite *site_for(const char *should) {
+    for (QUAssertionSite *site = QUAssertionSite::First(); site; site = site->next()) {
+      if (strstr(site->text, should)) {
+        return site;
+      }
+    }
+    return NULL;
+  }
+
+  // The site of the assertions on a line without a SHOULD(...)
+  QUAssertionSite *site_at(int line) {
+    for (QUAssertionSite *site = QUAssertionSite::First(); site; site = site->next()) {
+      if (site->line == line && strstr(site->file, "AssertionSites.cpp") && !strstr(site->text, "Should")) {
+        return site;
+      }
+    }
+    return NULL;
+  }
+
+  std::string read_file(const char *path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  // A test that is run by hand, to look at how it fails
+  EXTEND_TEST(FailsAtItsSite)
+    void Run(void) { assert(false, SHOULD(fail at this site)); }
+  END_EXTEND_TEST
+
+  void run(void *test) { ((QUTest *)test)->Run(); }
+
+  bool never = false;
+}
+
+// ----------------------------
+DECLARE_SUITE(Assertion sites)
+
+TEST(Each assertion is counted at its site) {
+  for (int i = 0; i < 3; i++) {
+    assert(true,                                               SHOULD(be counted three times));
+  }
+  QUAssertionSite *site = site_for("be counted three times");
+  assert(site != NULL,                                         SHOULD(list the site));
+  assert_equal(3ULL, site->count(),                             SHOULD(count each assertion));
+  assert_equal(0ULL, site->fails(),                             SHOULD(count no fails));
+  assert_include("AssertionSites.cpp", site->file,             SHOULD(know the file));
+  assert_include(": Should be counted three times.", site->text, SHOULD(keep the text));
+}
+
+TEST(Fails are counted at their site) {
+  FailsAtItsSite test("fails at its site");
+  assert(QUTestFail::Catch(run, &test),                        SHOULD(fail));
+  QUAssertionSite *site = site_for("fail at this site");
+  assert(site != NULL && site->fails() == 1,                    SHOULD(count the fail));
+  assert_include("Should fail at this site", test.fail_message().c_str(), SHOULD(still give the message));
+}
+
+TEST(Assertions without a SHOULD are counted at their line) {
+  int line = __LINE__ + 2;
+  for (int i = 0; i < 2; i++) {
+    assert(i < 2);
+  }
+  QUAssertionSite *site = site_at(line);
+  assert(site != NULL,                                         SHOULD(list the line as a site));
+  assert_equal(2ULL, site ? site->count() : 0,                  SHOULD(count each assertion there));
+  assert_equal("line " + std::to_string(line), std::string(site ? site->text : ""), SHOULD(label it with the line));
+}
+
+TEST(Sites that never run are listed) {
+  if (never) {
+    assert(false,                                              SHOULD(never be reached));
+  }
+  QUAssertionSite *site = site_for("never be reached");
+  assert(site != NULL,                                         SHOULD(list the site before it runs));
+  assert_equal(0ULL, site->count(),                             SHOULD(count nothing there));
+}
+
+TEST(Static assertions still compile) {
+  STATIC_ASSERT(sizeof(char) == 1,                             SHOULD(be one byte per char));
+  assert(true);
+}
+
+TEST(The sites are reported) {
+  static char *no_arguments[] = {(char *)"AssertionSites", NULL};
+  static char *arguments[] = {(char *)"AssertionSites", (char *)"--assertion-sites=1", (char *)"--assertion-profile=sites.tmp.csv", NULL};
+  char **saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+  std::ostringstream report;
+  TEST_OUTPUT(report);
+  QUOptionTracker::Argv(arguments);
+  int fails = QUAssertionSite::Report(7);
+  QUOptionTracker::Argv(saved);
+  TEST_OUTPUT(std::cout);
+  std::string csv = read_file("sites.tmp.csv");
+  remove("sites.tmp.csv");
+  assert_equal(7, fails,                                       SHOULD(pass the fails on));
+  assert_include("Assertion sites: ", report.str().c_str(),    SHOULD(give the number of sites));
+  assert_include("Never run:", report.str().c_str(),           SHOULD(list the sites that never ran));
+  assert_include("... and ", report.str().c_str(),             SHOULD(show one site of each));
+  assert_include("file,line,count,fails,nanoseconds,should\n", csv.c_str(), SHOULD(write a header));
+  assert_include(",3,0,", csv.c_str(),                         SHOULD(write the counts));
+  assert_include(",0,0,0,\"line ", csv.c_str(),                SHOULD(write the sites that never ran));
+}
+#else
+ #error AssertionSites.cpp must be built with QU_PROFILE_ASSERTIONS
+#endif
+
+// ----------------------------
+int main(int argc, char *argv[]) {
+  TEST_ARGS(argc, argv);
+  return RUN_TESTS();
+}
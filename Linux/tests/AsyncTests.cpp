@@ -0,0 +1,155 @@
+//
+// AsyncTests.cpp: Coroutine tests on the runner's event loop
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_async.hpp"
+#include "../quick_unit_netbeans.hpp"
+#include <sys/socket.h>
+#include <fcntl.h>
+
+namespace {
+  using namespace std::chrono;
+
+  QUTask<std::string> read_text(int fd) {
+    co_await readable(fd);
+    char buffer[64];
+    ssize_t got = read(fd, buffer, sizeof(buffer));
+    co_return std::string(buffer, got > 0 ? got : 0);
+  }
+
+  // Tests that are run by hand, as a group of their own
+  class Sleeper : public QUTest, public QUAsyncBody {
+  public:
+    Sleeper(const char *msg) : QUTest(msg) {}
+    void Run(void) { QUAsyncGroup::RunAlone(this); }
+    QUTask<> Body(void) {
+      co_await sleep_for(milliseconds(200));
+      assert(true);
+    }
+  };
+  class Failer : public QUTest, public QUAsyncBody {
+  public:
+    Failer(const char *msg) : QUTest(msg) {}
+    void Run(void) { QUAsyncGroup::RunAlone(this); }
+    QUTask<> Body(void) {
+      co_await sleep_for(milliseconds(10));
+      printf("woke up");
+      assert_equal(1, 2, "Add up");
+      assert(true);
+    }
+  };
+  class Stuck : public QUTest, public QUAsyncBody {
+  public:
+    int fd;
+    Stuck(const char *msg) : QUTest(msg), fd(-1) {}
+    void Run(void) { QUAsyncGroup::RunAlone(this); }
+    QUTask<> Body(void) {
+      assert(true);
+      co_await readable(fd); // Nothing is ever written
+    }
+  };
+}
+
+// ----------------------------
+BEGIN_SUITE(Async tests)
+  int setups;
+  int teardowns;
+  SETUP_SUITE { setups = teardowns = 0; }
+  SETUP { setups++; }
+  TEARDOWN { teardowns++; }
+  void run_together(QUTest **tests, size_t count, QUTestOutcome *outcomes, const char *option = NULL) {
+    static char *no_arguments[] = {(char *)"AsyncTests", NULL};
+    char **saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+    char *argv[] = {(char *)"AsyncTests", (char *)option, NULL};
+    QUOptionTracker::Argv(argv);
+    QUAsyncGroup::Instance().RunTogether(*this, tests, count, outcomes);
+    QUOptionTracker::Argv(saved);
+  }
+END_SUITE_AS(async)
+
+ASYNC_TEST(A timer wakes the test) {
+  QUClock::time_point start = QUClock::now();
+  co_await sleep_for(milliseconds(20));
+  assert(QUClock::now() - start >= milliseconds(20),           SHOULD(wait for the timer));
+}
+
+ASYNC_TEST(A test can wait for an fd) {
+  int ends[2];
+  assert_equal(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, ends), SHOULD(make a socket pair));
+  co_await writable(ends[0]);
+  assert_equal(4L, (long)write(ends[0], "ping", 4),            SHOULD(write));
+  std::string text = co_await read_text(ends[1]);
+  assert_equal("ping", text.c_str(),                           SHOULD(read what was written));
+  close(ends[0]);
+  close(ends[1]);
+}
+
+ASYNC_TEST(A test can wait for a future) {
+  std::future<int> answer = std::async(std::launch::async, [] {
+    std::this_thread::sleep_for(milliseconds(20));
+    return 42;
+  });
+  int value = co_await when_ready(answer);
+  assert_equal(42, value,                                      SHOULD(get the value));
+}
+
+ASYNC_TEST(A test with nothing to wait for still runs) {
+  assert(true);
+  co_return;
+}
+
+TEST(Async tests ran set up and torn down) {
+  assert_equal(4, async.teardowns,                             SHOULD(tear down each one as it finished));
+  assert_equal(5, async.setups,                                SHOULD(set up each one and then this test));
+}
+
+TEST(Hundreds of tests wait together) {
+  std::vector<Sleeper *> sleepers;
+  std::vector<QUTest *> tests;
+  for (int i = 0; i < 300; i++) {
+    sleepers.push_back(new Sleeper("sleeper"));
+    tests.push_back(sleepers.back());
+  }
+  std::vector<QUTestOutcome> outcomes(tests.size());
+  QUClock::time_point start = QUClock::now();
+  async.run_together(&tests[0], tests.size(), &outcomes[0]);
+  double took = duration<double>(QUClock::now() - start).count();
+  assert(took < 5,                                             SHOULD(sleep at the same time));
+  int passed = 0;
+  for (size_t i = 0; i < outcomes.size(); i++) {
+    passed += outcomes[i].failed ? 0 : 1;
+    delete sleepers[i];
+  }
+  assert_equal(300, passed,                                    SHOULD(pass every test));
+  assert(outcomes[0].duration >= 200,                          SHOULD(time each test on its own));
+}
+
+TEST(A failure fails only its own test) {
+  Sleeper sleeper("sleeper");
+  Failer failer("failer");
+  QUTest *tests[] = {&sleeper, &failer};
+  QUTestOutcome outcomes[2];
+  async.run_together(tests, 2, outcomes);
+  assert_false(outcomes[0].failed,                             SHOULD(pass the sleeper));
+  assert(outcomes[1].failed,                                   SHOULD(fail the failer));
+  assert_include("Add up (Expected: 1, got: 2)", outcomes[1].fail_message.c_str(), SHOULD(give the message));
+  assert_equal("woke up", outcomes[1].output.c_str(),          SHOULD(keep its output));
+  assert_equal(0, failer.passes(),                             SHOULD(stop at the failure));
+}
+
+TEST(A test that never finishes times out) {
+  int ends[2];
+  assert_equal(0, socketpair(AF_UNIX, SOCK_STREAM, 0, ends),   SHOULD(make a socket pair));
+  Stuck stuck("stuck");
+  stuck.fd = ends[0];
+  Sleeper sleeper("sleeper");
+  QUTest *tests[] = {&stuck, &sleeper};
+  QUTestOutcome outcomes[2];
+  async.run_together(tests, 2, outcomes, "--async-timeout=0.5");
+  assert(outcomes[0].failed,                                   SHOULD(fail the stuck test));
+  assert_include("did not finish within 0.5s", outcomes[0].fail_message.c_str(), SHOULD(say why));
+  assert_false(outcomes[1].failed,                             SHOULD(pass the other test));
+  close(ends[0]);
+  close(ends[1]);
+}
@@ -0,0 +1,147 @@
+//
+// BenchEnvironment.cpp: Steadying benchmarks, and the machine they ran on
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_bench.hpp"
+#include <iostream>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+namespace {
+  // Writes a file under root, making its directories
+  void write_file(const std::string &root, const std::string &path, const char *text) {
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+      mkdir((root + path.substr(0, slash)).c_str(), 0700);
+    }
+    std::ofstream((root + path).c_str()) << text;
+  }
+
+  // A /sys and /proc for CPU 2 of a machine
+  std::string machine(const char *governor, const char *siblings, const char *no_turbo, const char *loadavg, const char *online) {
+    char dir[] = "/tmp/qu_bench_XXXXXX";
+    std::string root = mkdtemp(dir);
+    write_file(root, "/proc/cpuinfo", "processor\t: 0\nmodel\t\t: 85\nmodel name\t: Test CPU @ 3.00GHz\n");
+    write_file(root, "/proc/loadavg", loadavg);
+    write_file(root, "/sys/devices/system/cpu/cpu2/cpufreq/scaling_governor", governor);
+    write_file(root, "/sys/devices/system/cpu/cpu2/topology/thread_siblings_list", siblings);
+    write_file(root, "/sys/devices/system/cpu/intel_pstate/no_turbo", no_turbo);
+    write_file(root, "/sys/devices/system/cpu/online", online);
+    return root;
+  }
+
+  void remove_machine(const std::string &root) {
+    std::string command = "rm -rf " + root;
+    if (system(command.c_str()) != 0) {
+      perror(command.c_str());
+    }
+  }
+
+  // The first CPU this thread may run on
+  int allowed_cpu(cpu_set_t &allowed) {
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        return cpu;
+      }
+    }
+    return 0;
+  }
+}
+
+// ----------------------------
+DECLARE_SUITE(Benchmark environment)
+
+TEST(CPU lists are read) {
+  std::vector<int> cpus = QUBenchEnvironment::CpuList("0-3,8\n");
+  assert_equal(5u, (unsigned)cpus.size(),                      SHOULD(read ranges and single CPUs));
+  if (cpus.size() == 5) {
+    assert(cpus[0] == 0 && cpus[3] == 3 && cpus[4] == 8,       SHOULD(list each CPU));
+  }
+  assert(QUBenchEnvironment::CpuList("").empty(),              SHOULD(read nothing from nothing));
+}
+
+TEST(A quiet machine gets no warnings) {
+  std::string root = machine("performance\n", "2\n", "1\n", "3.12 2.00 1.00 4/100 1234\n", "0-7\n");
+  QUBenchEnvironment environment(2, root);
+  remove_machine(root);
+  assert_equal("Test CPU @ 3.00GHz", environment.model.c_str(), SHOULD(read the model));
+  assert_equal("performance", environment.governor.c_str(),    SHOULD(read the governor));
+  assert_equal(0u, (unsigned)environment.warnings.size(),      SHOULD(find nothing to warn about on eight CPUs));
+  assert_equal("Test CPU @ 3.00GHz, CPU 2 (pinned), governor performance", environment.Describe(true).c_str(), SHOULD(describe the machine));
+}
+
+TEST(A noisy machine is warned about) {
+  std::string root = machine("powersave\n", "2,6\n", "0\n", "3.12 2.00 1.00 4/100 1234\n", "0-1\n");
+  QUBenchEnvironment environment(2, root);
+  remove_machine(root);
+  assert_equal(4u, (unsigned)environment.warnings.size(),      SHOULD(give four warnings));
+  if (environment.warnings.size() == 4) {
+    assert_equal("the CPU 2 governor is powersave, so its clock speed follows the load", environment.warnings[0].c_str(), SHOULD(warn of frequency scaling));
+    assert_equal("CPU 2 shares its core with CPU 6 (SMT), so work there slows it down", environment.warnings[1].c_str(), SHOULD(warn of an SMT sibling));
+    assert_equal("turbo boost is on, so the clock speed depends on load and temperature", environment.warnings[2].c_str(), SHOULD(warn of turbo));
+    assert_equal("the load average is 3.12 on 2 CPUs, so other work is competing for them", environment.warnings[3].c_str(), SHOULD(warn of load));
+  }
+}
+
+TEST(Pinning moves the thread) {
+  cpu_set_t allowed;
+  int cpu = allowed_cpu(allowed);
+  std::string problem = QUBenchEnvironment::Pin(cpu);
+  int now_on = sched_getcpu();
+  sched_setaffinity(0, sizeof(allowed), &allowed);
+  assert_equal("", problem.c_str(),                            SHOULD(pin to a CPU it may use));
+  assert_equal(cpu, now_on,                                    SHOULD(run there));
+  assert_equal("no CPU -1", QUBenchEnvironment::Pin(-1).c_str(), SHOULD(refuse a CPU that cannot be));
+}
+
+TEST(The reporter pins and describes the machine) {
+  cpu_set_t allowed;
+  std::ostringstream text;
+  text << allowed_cpu(allowed);
+  std::string cpu = text.str();
+  std::string pin_option = "--bench-cpu=" + cpu;
+  std::ostringstream nice;
+  nice << "--bench-priority=" << getpriority(PRIO_PROCESS, 0);    // Where it is, which needs no privileges
+  std::string priority_option = nice.str();
+  static char *no_arguments[] = {(char *)"BenchEnvironment", NULL};
+  char *arguments[] = {(char *)"BenchEnvironment", (char *)pin_option.c_str(), (char *)priority_option.c_str(), NULL};
+  char **saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+  std::ostringstream report;
+  TEST_OUTPUT(report);
+  QUOptionTracker::Argv(arguments);
+  {
+    BenchEnvironmentReporter reporter;
+    reporter.StartingSuite("Benchmarks");
+    reporter.StartedSuite("Benchmarks");
+    reporter.StartingSuite("More benchmarks");
+    reporter.StartedSuite("More benchmarks");
+  }
+  QUOptionTracker::Argv(saved);
+  TEST_OUTPUT(std::cout);
+  sched_setaffinity(0, sizeof(allowed), &allowed);
+  assert_include("Benchmark environment: ", report.str().c_str(), SHOULD(describe the machine));
+  assert_include((", CPU " + cpu + " (pinned)").c_str(), report.str().c_str(), SHOULD(give the pinned CPU));
+  assert_include(", nice ", report.str().c_str(),              SHOULD(give the priority));
+  assert_exclude("could not", report.str().c_str(),            SHOULD(pin without a problem));
+  size_t first = report.str().find("Benchmark environment: ");
+  assert(report.str().find("Benchmark environment: ", first + 1) != std::string::npos, SHOULD(read the machine for each suite));
+}
+
+TEST(Problems isolating are warned about) {
+  static char *no_arguments[] = {(char *)"BenchEnvironment", NULL};
+  static char *arguments[] = {(char *)"BenchEnvironment", (char *)"--bench-cpu=99999", NULL};
+  char **saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+  std::ostringstream report;
+  TEST_OUTPUT(report);
+  QUOptionTracker::Argv(arguments);
+  {
+    BenchEnvironmentReporter reporter;
+    reporter.StartingSuite("Benchmarks");
+    reporter.StartedSuite("Benchmarks");
+  }
+  QUOptionTracker::Argv(saved);
+  TEST_OUTPUT(std::cout);
+  assert_include("Warning: could not pin to CPU 99999: no CPU 99999\n", report.str().c_str(), SHOULD(say why));
+  assert_exclude("(pinned)", report.str().c_str(),             SHOULD(not claim to be pinned));
+}
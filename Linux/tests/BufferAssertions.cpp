@@ -0,0 +1,80 @@
+//
+// BufferAssertions.cpp: Comparing big buffers and containers
+//
+
+#include <list>
+#include "../quick_unit.hpp"
+#include "../quick_unit_buffers.hpp"
+#include "../quick_unit_netbeans.hpp"
+
+// ----------------------------
+BEGIN_SUITE(Buffer assertions)
+  std::vector<unsigned char> bytes;
+  SETUP {
+    bytes.assign(100000, 0x5a);
+  }
+END_SUITE_AS(buffers)
+
+TEST(Equal buffers match) {
+  std::vector<unsigned char> copy(buffers.bytes);
+  assert_equal_bytes(&buffers.bytes[0], &copy[0], copy.size(), SHOULD(match byte for byte));
+  assert_equal_range(buffers.bytes, copy,                      SHOULD(match as vectors));
+  assert_equal_bytes("", "", 0,                                SHOULD(match when empty));
+}
+
+TEST(The first difference is found wherever it is) {
+  std::vector<unsigned char> copy(buffers.bytes);
+  size_t places[] = {0, 1, 15, 16, 31, 32, 63, 64, 65, 99999};
+  for (size_t i = 0; i < sizeof(places) / sizeof(places[0]); i++) {
+    copy[places[i]] ^= 0x10;
+    assert_equal(places[i], quick_unit::QUBufferCompare::FirstMismatch(&buffers.bytes[0], &copy[0], copy.size()), SHOULD(find the changed byte));
+    copy[places[i]] ^= 0x10;
+  }
+}
+
+TEST(A difference is reported with a small window) {
+  std::vector<unsigned char> copy(buffers.bytes);
+  copy[50000] = 0x41;
+  Qu_Result result = equal_range(buffers.bytes, copy);
+  assert_false(result.pass,                                   SHOULD(notice the difference));
+  assert_include("Differs at index 50000 of 100000", result.msg.c_str(), SHOULD(give the index));
+  assert_include("5a 5a [41] 5a", result.msg.c_str(),         SHOULD(show the bytes around it));
+  assert(result.msg.length() < 200,                           SHOULD(keep the message short));
+}
+
+TEST(Different lengths are reported) {
+  std::vector<int> x(10, 7);
+  std::vector<int> y(12, 7);
+  Qu_Result result = equal_range(x, y);
+  assert_false(result.pass,                                   SHOULD(notice the extra elements));
+  assert_include("Expected 10 elements, got 12", result.msg.c_str(), SHOULD(give both sizes));
+  assert_include("7 [end]", result.msg.c_str(),               SHOULD(mark the end of the shorter one));
+}
+
+TEST(Other containers are compared element by element) {
+  std::list<double> x(5, 1.5);
+  std::list<double> y(x);
+  assert_equal_range(x, y,                                    SHOULD(match lists));
+  y.back() = 2.5;
+  Qu_Result result = equal_range(x, y);
+  assert_include("Differs at index 4 of 5", result.msg.c_str(), SHOULD(give the index));
+  assert_include("1.5 [2.5]", result.msg.c_str(),             SHOULD(show the elements));
+}
+
+TEST(Strings are compared as bytes) {
+  std::string x(1000, 'a');
+  std::string y(x);
+  assert_equal_range(x, y,                                    SHOULD(match strings));
+  y[999] = 'b';
+  assert_include("61 61 [62]", equal_range(x, y).msg.c_str(), SHOULD(show the bytes around it));
+}
+
+TEST(Vectors of bool are compared element by element) {
+  std::vector<bool> x(100, true);
+  std::vector<bool> y(x);
+  assert_equal_range(x, y,                                    SHOULD(match packed bits));
+  y[70] = false;
+  Qu_Result result = equal_range(x, y);
+  assert_include("Differs at index 70 of 100", result.msg.c_str(), SHOULD(give the index));
+  assert_include("true [false] true", result.msg.c_str(),     SHOULD(show the elements));
+}
@@ -0,0 +1,89 @@
+//
+// DiffAssertions.cpp: Diffs for long strings that differ
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_diff.hpp"
+#include "../quick_unit_netbeans.hpp"
+
+// ----------------------------
+BEGIN_SUITE(Diff assertions)
+  std::string text;
+  SETUP {
+    std::ostringstream os;
+    for (int i = 1; i <= 1000; i++) {
+      os << "line " << i << "\n";
+    }
+    text = os.str();
+  }
+  std::string replace(std::string from, const char *line, const char *with) {
+    return from.replace(from.find(line), strlen(line), with);
+  }
+END_SUITE_AS(diffs)
+
+TEST(Equal strings still match) {
+  std::string copy(diffs.text);
+  assert_equal(diffs.text, copy,                               SHOULD(match as std::strings));
+  assert_equal(diffs.text.c_str(), copy.c_str(),               SHOULD(match as C strings));
+  assert_equal(1, 1,                                           SHOULD(leave other types alone));
+}
+
+TEST(Short strings are shown in full) {
+  Qu_Result result = equal(std::string("abc"), std::string("abd"));
+  assert_false(result.pass,                                    SHOULD(notice the difference));
+  assert_equal(" (Expected: abc, got: abd)", result.msg.c_str(), SHOULD(use the usual message));
+}
+
+TEST(A changed line is shown with context) {
+  Qu_Result result = equal(diffs.text, diffs.replace(diffs.text, "line 500\n", "line five hundred\n"));
+  assert_false(result.pass,                                    SHOULD(notice the difference));
+  assert_include("Strings differ at byte 4388 (line 500, column 6)", result.msg.c_str(), SHOULD(say where));
+  assert_include("@@ -497,7 +497,7 @@\n line 497\n line 498\n line 499\n-line 500\n+line five hundred\n line 501\n", result.msg.c_str(), SHOULD(show the hunk));
+  assert(result.msg.length() < 250,                            SHOULD(leave out the rest));
+}
+
+TEST(Inserted and deleted lines make separate hunks) {
+  std::string changed = diffs.replace(diffs.text, "line 10\n", "line 10\nnew line\n");
+  changed = diffs.replace(changed, "line 900\n", "");
+  Qu_Result result = equal(diffs.text, changed);
+  assert_include("@@ -8,6 +8,7 @@", result.msg.c_str(),        SHOULD(show the insertion));
+  assert_include(" line 10\n+new line\n line 11", result.msg.c_str(), SHOULD(mark the new line));
+  assert_include("@@ -897,7 +898,6 @@", result.msg.c_str(),    SHOULD(show the deletion));
+  assert_include(" line 899\n-line 900\n line 901", result.msg.c_str(), SHOULD(mark the lost line));
+}
+
+TEST(Nearby changes share a hunk) {
+  std::string changed = diffs.replace(diffs.text, "line 20\n", "line twenty\n");
+  changed = diffs.replace(changed, "line 24\n", "line twenty four\n");
+  Qu_Result result = equal(diffs.text, changed);
+  assert_include("@@ -17,11 +17,11 @@", result.msg.c_str(),    SHOULD(show one hunk));
+  assert_exclude("@@ -21", result.msg.c_str(),                 SHOULD(not start another));
+}
+
+TEST(A missing final newline is pointed out) {
+  std::string shorter(diffs.text, 0, diffs.text.size() - 1);
+  Qu_Result result = equal(diffs.text, shorter);
+  assert_include("Expected 8893 bytes, got 8892 bytes", result.msg.c_str(), SHOULD(give the sizes));
+  assert_include("Only the final newline differs", result.msg.c_str(), SHOULD(say why));
+}
+
+TEST(Long lines are cut down around the change) {
+  std::string x(100000, 'a');
+  std::string y(x);
+  y[60000] = 'b';
+  Qu_Result result = equal(x, y);
+  assert_include("Strings differ at byte 60000 (line 1, column 60001)", result.msg.c_str(), SHOULD(say where));
+  assert_include("aaab", result.msg.c_str(),                   SHOULD(show the changed byte));
+  assert_include("(100000 bytes)", result.msg.c_str(),         SHOULD(give the line length));
+  assert(result.msg.length() < 600,                            SHOULD(leave out the rest));
+}
+
+TEST(Unrelated texts give a bounded diff) {
+  std::string x, y;
+  for (int i = 0; i < 20000; i++) {
+    x += "x" + std::string(i % 7, 'x') + "\n";
+    y += "y" + std::string(i % 5, 'y') + "\n";
+  }
+  Qu_Result result = equal(x, y);
+  assert_include("... (diff cut short)", result.msg.c_str(),   SHOULD(stop after QU_DIFF_MAX_LINES lines));
+}
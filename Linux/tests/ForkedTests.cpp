@@ -0,0 +1,225 @@
+//
+// ForkedTests.cpp: Tests run in forked copies of the test process
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_netbeans.hpp"
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+  int counter = 0;
+
+  // Counts its releases in memory shared with the children
+  int *releases = (int *)mmap(NULL, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  struct Tracked {
+    ~Tracked() { (*releases)++; }
+  };
+
+  // Tests that are run by hand, rather than added to a suite
+  EXTEND_TEST(CountingTest)
+    void Run(void) { counter++; assert_equal(1, counter, "Count from one"); }
+  END_EXTEND_TEST
+  EXTEND_TEST(FailingTest)
+    void Run(void) { assert_false(true, "Fail"); }
+  END_EXTEND_TEST
+  EXTEND_TEST(PrintingTest)
+    void Run(void) { printf("from the child"); assert(true); }
+  END_EXTEND_TEST
+  EXTEND_TEST(CrashingTest)
+    void Run(void) { raise(SIGSEGV); }
+  END_EXTEND_TEST
+}
+
+// ----------------------------
+BEGIN_SUITE(Forked tests)
+  FIXTURE(Tracked, tracked) { return new Tracked(); }
+  void run_forked(QUTest **tests, size_t count, QUTestOutcome *outcomes) {
+    RunForked(tests, count, outcomes);
+  }
+END_SUITE_AS(forked)
+
+namespace {
+  EXTEND_TEST(FixtureTest)
+    void Run(void) { forked.tracked(); assert(true); }
+  END_EXTEND_TEST
+}
+
+#ifdef QU_FORK_TESTS
+TEST(Each child starts from the parent state) {
+  CountingTest first("first"), second("second");
+  QUTest *tests[] = {&first, &second};
+  QUTestOutcome outcomes[2];
+  forked.run_forked(&tests[0], 1, &outcomes[0]);
+  forked.run_forked(&tests[1], 1, &outcomes[1]);
+  assert_false(outcomes[0].failed,                             SHOULD(pass in its own process));
+  assert_false(outcomes[1].failed,                             SHOULD(not see what the first test changed));
+  assert_equal(0, counter,                                     SHOULD(leave the parent alone));
+}
+
+TEST(Tests in a batch share a child) {
+  CountingTest first("first"), second("second");
+  QUTest *tests[] = {&first, &second};
+  QUTestOutcome outcomes[2];
+  forked.run_forked(tests, 2, outcomes);
+  assert_false(outcomes[0].failed,                             SHOULD(pass first));
+  assert(outcomes[1].failed,                                   SHOULD(see what the first test changed));
+  assert_include("Count from one", outcomes[1].fail_message.c_str(), SHOULD(bring back the message));
+}
+
+TEST(A crash fails one test and the batch carries on) {
+  FailingTest failing("failing");
+  CrashingTest crashing("crashing");
+  PrintingTest printing("printing");
+  QUTest *tests[] = {&failing, &crashing, &printing};
+  QUTestOutcome outcomes[3];
+  forked.run_forked(tests, 3, outcomes);
+  assert(outcomes[0].failed,                                   SHOULD(fail the failing test));
+  assert(outcomes[1].failed,                                   SHOULD(fail the crashing test));
+  assert_include("killed by signal 11", outcomes[1].fail_message.c_str(), SHOULD(say why));
+  assert_false(outcomes[2].failed,                             SHOULD(run the rest in a new child));
+  assert_equal("from the child", outcomes[2].output.c_str(),   SHOULD(bring back the output));
+}
+TEST(Fixtures built in a child are released there) {
+  FixtureTest first("first"), second("second");
+  QUTest *tests[] = {&first, &second};
+  QUTestOutcome outcomes[2];
+  *releases = 0;
+  forked.run_forked(tests, 2, outcomes);
+  assert_false(outcomes[0].failed || outcomes[1].failed,        SHOULD(build the fixture in the child));
+  assert_equal(1, *releases,                                   SHOULD(release it once the batch is done));
+  forked.run_forked(&tests[0], 1, &outcomes[0]);
+  assert_equal(2, *releases,                                   SHOULD(build and release it again in the next child));
+}
+#endif
+
+// ----------------------------
+// A suite run by RunAll with --fork=2, logged by a reporter of its own
+namespace {
+  std::vector<std::string> logged;   // "<event> <test>"
+  pid_t runner = getpid();
+  int changes = 0;
+
+  // Runs its tests one after another, here
+  struct HereGroup : public QUTestGroup {
+    static void run(void *test) { ((QUTest *)test)->Run(); }
+    void RunTogether(QUTestSuite &suite, QUTest **tests, size_t count, QUTestOutcome *outcomes) {
+      for (size_t i = 0; i < count; i++) {
+        Before(suite);
+        outcomes[i].failed = QUTestFail::Catch(run, tests[i]) || tests[i]->fails();
+        outcomes[i].fail_message = outcomes[i].failed ? tests[i]->fail_message() : "";
+        After(suite);
+      }
+    }
+  } here_group;
+}
+
+BEGIN_REPORTER(ForkLog)
+  void StartingTest(const std::string &suite_name, const std::string &test_name) { logged.push_back("starting " + test_name); }
+  void StartedTest(const std::string &suite_name, const std::string &test_name) { logged.push_back("started " + test_name); }
+  void StoppingTest(const std::string &suite_name, const std::string &test_name) { logged.push_back("stopping " + test_name); }
+  void FailedTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &fail_message) {
+    logged.push_back("failed " + test_name + ": " + fail_message);
+  }
+  void PassedTest(const std::string &suite_name, const std::string &test_name, double duration) { logged.push_back("passed " + test_name); }
+  void SlowTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &overrun) {
+    logged.push_back("slow " + test_name + ": " + overrun);
+  }
+  void TestOutput(const std::string &suite_name, const std::string &test_name, const std::string &text) { logged.push_back("output " + test_name + ": " + text); }
+  void TestMetric(const std::string &suite_name, const std::string &test_name, const QUMetric &metric) {
+    logged.push_back("metric " + test_name + ": " + metric.name);
+  }
+  void CompletedTest(const std::string &suite_name, const std::string &test_name, double duration) { logged.push_back("completed " + test_name); }
+END_REPORTER()
+
+// Only this reporter sees the suite, whose fails are on purpose. The
+// reporter from before is put back after.
+namespace {
+  QUReporter *reporter_before = QUTestSuiteTracker::CurrentQUReporter();
+}
+TEST_REPORTER(ForkLog)
+BEGIN_SUITE(Forked suite)
+  char **saved;
+  SETUP_SUITE {
+    static char *no_arguments[] = {(char *)"ForkedTests", NULL};
+    static char *arguments[] = {(char *)"ForkedTests", (char *)"--fork=2", NULL};
+    saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+    QUOptionTracker::Argv(arguments); // RunAll reads --fork once the suite is set up
+  }
+  TEARDOWN_SUITE {
+    QUOptionTracker::Argv(saved);
+  }
+END_SUITE
+namespace {
+  QUReporter *reporter_put_back = QUTestSuiteTracker::CurrentQUReporter(reporter_before);
+}
+
+TEST(A test forked on its own) {
+  assert(getpid() != runner,                                   SHOULD(run in a child));
+  assert_equal(1, ++changes,                                   SHOULD(start from the parent state));
+  RECORD_METRIC("items", 10, "items");
+  printf("from a child");
+}
+
+namespace {
+  // In a group, so run in the test program ahead of the forked tests
+  class GroupedTest : public QU_TEST_ANCESTOR {
+  public:
+    GroupedTest() : QU_TEST_ANCESTOR("A grouped test") { QUTestSuiteTracker::CurrentQUTestSuite()->Add(this); }
+    QUTestGroup *Group(void) { return &here_group; }
+    void Run(void) {
+      assert_equal(runner, getpid(),                           SHOULD(run in the test program));
+      assert_equal(0, changes,                                 SHOULD(not see the forked tests));
+    }
+  } static grouped;
+}
+
+TEST(The first of a batch) {
+  assert(getpid() != runner,                                   SHOULD(run in a child));
+  assert_equal(1, ++changes,                                   SHOULD(start from the parent state));
+}
+
+TEST(The second of a batch) {
+  assert_equal(2, ++changes,                                   SHOULD(share the child of the test before));
+}
+
+TEST_WITHIN(A slow forked test, WALL_MS(1)) {
+  usleep(20000);
+  assert(true);
+}
+
+TEST(A failing forked test) {
+  assert(false,                                                SHOULD(fail in the child));
+}
+
+// ----------------------------
+DECLARE_SUITE(Forked suite reported)
+
+TEST(Forked tests are reported in their turn) {
+  const char *expected[] = {
+    "starting A test forked on its own", "started A test forked on its own", "stopping A test forked on its own",
+    "passed A test forked on its own", "output A test forked on its own: from a child",
+    "metric A test forked on its own: items", "completed A test forked on its own",
+    "starting A grouped test", "started A grouped test", "stopping A grouped test", "passed A grouped test", "completed A grouped test",
+    "starting The first of a batch"};
+  size_t count = sizeof(expected) / sizeof(expected[0]);
+  assert(logged.size() > count,                                SHOULD(log every event));
+  for (size_t i = 0; i < count && i < logged.size(); i++) {
+    assert_equal(expected[i], logged[i].c_str(),               SHOULD(give the events in order));
+  }
+}
+
+TEST(Forked tests pass and fail as they did in the child) {
+  std::string log;
+  for (size_t i = 0; i < logged.size(); i++) {
+    log += logged[i] + "\n";
+  }
+  assert_include("passed The first of a batch\n", log.c_str(), SHOULD(pass the first of the batch));
+  assert_include("passed The second of a batch\n", log.c_str(), SHOULD(run a batch of two in one child));
+  assert_include("slow A slow forked test: took ", log.c_str(), SHOULD(hold the time in the child to the budget));
+  assert_include("failed A failing forked test: line ", log.c_str(), SHOULD(bring back the fail));
+  assert_include("Should fail in the child.", log.c_str(),     SHOULD(bring back the message));
+  assert_include("completed A failing forked test\n", log.c_str(), SHOULD(complete the last test));
+}
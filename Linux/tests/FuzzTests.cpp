@@ -0,0 +1,137 @@
+//
+// FuzzTests.cpp: Throwing arbitrary input at the code under test.
+// Run with --fuzz=<seconds> to go looking for new failures.
+//
+
+#include "../code_under_test/vcl.h"
+#include "../quick_unit.hpp"
+#include "../quick_unit_fuzz.hpp"
+#include "../quick_unit_netbeans.hpp"
+#include <set>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace {
+  std::set<std::string> seen;     // Each input the hand-run tests were given
+  unsigned long executions = 0;
+
+  // Fuzz tests that are run by hand against a corpus of their own
+  class RecordingFuzz : public QUFuzzTest {
+  public:
+    RecordingFuzz(const char *msg) : QUFuzzTest(msg) {}
+    void Fuzz(const uint8_t *data, size_t size) {
+      executions++;
+      seen.insert(std::string((const char *)data, size));
+      assert(true);
+    }
+  };
+  // Fails on any input but the empty one and the seed
+  class PickyFuzz : public QUFuzzTest {
+  public:
+    PickyFuzz(const char *msg) : QUFuzzTest(msg) {}
+    void Fuzz(const uint8_t *data, size_t size) {
+      std::string input((const char *)data, size);
+      assert(input.empty() || input == "seed",                 SHOULD(only take the seed));
+    }
+  };
+
+  void run(void *test) { ((QUTest *)test)->Run(); }
+
+  // Writes a file into a corpus directory
+  void plant(const std::string &dir, const char *name, const char *contents) {
+    mkdir(dir.c_str(), 0700);
+    std::ofstream((dir + "/" + name).c_str(), std::ios::binary) << contents;
+  }
+
+  void remove_dir(const std::string &dir) {
+    std::string command = "rm -rf " + dir;
+    if (system(command.c_str()) != 0) {
+      perror(command.c_str());
+    }
+  }
+
+  // Runs a test with the options given, with --fuzz-corpus a new directory
+  struct HandRun {
+    std::string root, corpus_option;
+    HandRun() {
+      char dir[] = "/tmp/qu_fuzz_XXXXXX";
+      root = mkdtemp(dir);
+      corpus_option = "--fuzz-corpus=" + root;
+    }
+    ~HandRun() { remove_dir(root); }
+    bool Run(QUFuzzTest &test, const char *option = NULL, const char *more = NULL) {
+      static char *no_arguments[] = {(char *)"FuzzTests", NULL};
+      char *arguments[] = {(char *)"FuzzTests", (char *)corpus_option.c_str(), (char *)option, (char *)more, NULL};
+      char **saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+      QUOptionTracker::Argv(arguments);
+      bool failed = QUTestFail::Catch(run, &test);
+      QUOptionTracker::Argv(saved);
+      return failed;
+    }
+  };
+}
+
+// ----------------------------
+DECLARE_SUITE(Fuzz tests)
+
+FUZZ_TEST(ToIntDef copes with any text)(const uint8_t *data, size_t size) {
+  AnsiString text(std::string((const char *)data, size).c_str());
+  int a = text.ToIntDef(1);
+  int b = text.ToIntDef(2);
+  assert(a == b || (a == 1 && b == 2), SHOULD(return the parsed value or the default));
+}
+
+FUZZ_TEST(SubString stays inside the string)(const uint8_t *data, size_t size) {
+  AnsiString text(std::string((const char *)data, size).c_str());
+  for (int start = 1; start <= text.Length(); start += 7) {
+    assert(text.SubString(start, 3).Length() <= 3, SHOULD(return at most the requested length));
+  }
+}
+
+TEST(Fuzzing runs mutated inputs until --fuzz-runs) {
+  HandRun hand;
+  RecordingFuzz test("recording");
+  plant(hand.root + "/recording", "seed", "12345");
+  seen.clear();
+  executions = 0;
+  assert_false(hand.Run(test, "--fuzz-runs=200", "--fuzz-seed=7"), SHOULD(pass));
+  assert_equal(202ul, executions,                              SHOULD(replay two inputs then fuzz 200));
+  assert(seen.count("") && seen.count("12345"),                SHOULD(replay the empty input and the corpus));
+  assert(seen.size() > 20,                                     SHOULD(make new inputs));
+  assert_include("Fuzzed 200 inputs", test.test_output_text().c_str(), SHOULD(report the runs));
+}
+
+TEST(Without a fuzz option the corpus is only replayed) {
+  HandRun hand;
+  RecordingFuzz test("recording");
+  plant(hand.root + "/recording", "seed", "12345");
+  executions = 0;
+  assert_false(hand.Run(test),                                 SHOULD(pass));
+  if (!getenv("QU_FUZZ") && !getenv("QU_FUZZ_RUNS")) {
+    assert_equal(2ul, executions,                              SHOULD(run the empty input and the seed));
+  }
+}
+
+TEST(A failing corpus input is named) {
+  HandRun hand;
+  PickyFuzz test("picky");
+  plant(hand.root + "/picky", "planted", "boom");
+  assert(hand.Run(test),                                       SHOULD(fail));
+  assert_include("Should only take the seed.", test.fail_message().c_str(), SHOULD(give the assertion));
+  assert_include(("[input: " + hand.root + "/picky/planted]").c_str(), test.fail_message().c_str(), SHOULD(name the input));
+}
+
+TEST(A failing mutation is saved into the corpus) {
+  HandRun hand;
+  PickyFuzz test("picky");
+  plant(hand.root + "/picky", "seed", "seed");
+  assert(hand.Run(test, "--fuzz-runs=1000", "--fuzz-seed=7"),  SHOULD(find an input that fails));
+  QUFuzzCorpus corpus(hand.root + "/picky");
+  std::list<std::string> files = corpus.Files();
+  assert_equal(2ul, (unsigned long)files.size(),               SHOULD(save the input beside the seed));
+  std::string saved = files.front();
+  assert_include("/crash-", saved.c_str(),                     SHOULD(save it as a crash));
+  assert_include(("[input: " + saved + "]").c_str(), test.fail_message().c_str(), SHOULD(name the saved file));
+  PickyFuzz again("picky");
+  assert(hand.Run(again),                                      SHOULD(fail again when replayed));
+}
@@ -0,0 +1,76 @@
+//
+// GoldenFiles.cpp: Comparing output with golden files
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_golden.hpp"
+#include "../quick_unit_netbeans.hpp"
+
+// ----------------------------
+BEGIN_SUITE(Golden files)
+  std::string report;
+  SETUP {
+    report = "Report\n======\ntotal: 14\nname: alpha\nname: beta\n";
+  }
+  // Runs matches_golden as if --update-golden had been given
+  Qu_Result updating(QUTest *test, const char *path, const std::string &data) {
+    char *argv[] = {(char *)"tests", (char *)"--update-golden", NULL};
+    static char *no_arguments[] = {(char *)"tests", NULL};       // Argv(NULL) cannot put back "none"
+    char **saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+    QUOptionTracker::Argv(argv);
+    Qu_Result result = ((QUTestGolden *)test)->matches_golden(path, data);
+    QUOptionTracker::Argv(saved);
+    return result;
+  }
+END_SUITE_AS(golden)
+
+TEST(Output that matches passes) {
+  assert_matches_golden("golden/report.txt", golden.report,  SHOULD(match the golden file));
+  assert_matches_golden("golden/report.txt", golden.report.data(), golden.report.size(), SHOULD(match as bytes));
+}
+
+TEST(Each golden file is mapped once) {
+  quick_unit::QUGoldenFile &first = quick_unit::QUGoldenFile::Mapped("golden/report.txt");
+  quick_unit::QUGoldenFile &second = quick_unit::QUGoldenFile::Mapped("golden/report.txt");
+  assert(&first == &second && first.data == second.data,      SHOULD(share the mapping));
+  assert_equal(golden.report.size(), first.size,               SHOULD(map the whole file));
+}
+
+TEST(A text difference gives the line and column) {
+  std::string changed(golden.report);
+  changed[changed.find("alpha") + 3] = 'x';
+  Qu_Result result = matches_golden("golden/report.txt", changed);
+  assert_false(result.pass,                                    SHOULD(notice the difference));
+  assert_include("Differs from golden/report.txt at byte 33 (line 4, column 10)", result.msg.c_str(), SHOULD(say where));
+  assert_include("Expected: ...\"\\ntotal: 14\\nname: alp[h]a\\nname: beta\\n\", got: ...\"\\ntotal: 14\\nname: alp[x]a\\nname: beta\\n\"", result.msg.c_str(), SHOULD(show the text around it));
+}
+
+TEST(Extra output is reported) {
+  Qu_Result result = matches_golden("golden/report.txt", golden.report + "name: gamma\n");
+  assert_include("Expected 47 bytes, got 59", result.msg.c_str(), SHOULD(give both sizes));
+  assert_include("beta\\n[end]\"", result.msg.c_str(),         SHOULD(mark the end of the file));
+}
+
+TEST(A binary difference is shown in hex) {
+  std::string changed(golden.report);
+  changed[21] = 1;
+  Qu_Result result = matches_golden("golden/report.txt", changed);
+  assert_include("Expected: ... 61 6c 3a 20 [31] 34 0a 6e 61 ..., got: ... 61 6c 3a 20 [01] 34 0a 6e 61 ...", result.msg.c_str(), SHOULD(show bytes));
+}
+
+TEST(A missing golden file fails) {
+  Qu_Result result = matches_golden("golden/no_such_file.txt", golden.report);
+  assert_false(result.pass,                                    SHOULD(fail));
+  assert_include("Run with --update-golden to create it", result.msg.c_str(), SHOULD(say how to make it));
+}
+
+TEST(Update mode writes the golden file) {
+  const char *path = "golden/updated.tmp.txt";
+  remove(path);
+  assert_true(golden.updating(this, path, golden.report).pass, SHOULD(create the missing file));
+  assert_matches_golden(path, golden.report,                   SHOULD(then match the new file));
+  assert_true(golden.updating(this, path, "changed\n").pass,   SHOULD(replace a different file));
+  assert_matches_golden(path, std::string("changed\n"),        SHOULD(see the replacement));
+  assert_false(matches_golden(path, golden.report).pass,       SHOULD(fail against the old output));
+  remove(path);
+}
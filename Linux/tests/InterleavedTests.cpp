@@ -0,0 +1,113 @@
+//
+// InterleavedTests.cpp: Exploring thread interleavings
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_interleave.hpp"
+#include "../quick_unit_netbeans.hpp"
+
+namespace {
+  struct Account {
+    int balance;
+    QUMutex lock;
+    void Deposit(int amount) {  // Races
+      int seen = balance;
+      QU_YIELD();
+      balance = seen + amount;
+    }
+    void SafeDeposit(int amount) {
+      std::lock_guard<QUMutex> hold(lock);
+      Deposit(amount);
+    }
+  };
+
+  // Tests that are run by hand, to look at how they fail
+  EXTEND_TEST(RacyDeposits)
+    void Run(void) {
+      Account account;
+      explore_interleavings(2,
+        [&] { account.balance = 0; },
+        [&](unsigned thread) { account.Deposit(10); },
+        [&] { assert_equal(20, account.balance, "Keep both deposits"); });
+    }
+  END_EXTEND_TEST
+  EXTEND_TEST(LocksInTheWrongOrder)
+    void Run(void) {
+      QUMutex a, b;
+      explore_interleavings(2,
+        [&] {},
+        [&](unsigned thread) {
+          std::lock_guard<QUMutex> first(thread ? a : b);
+          QU_YIELD();
+          std::lock_guard<QUMutex> second(thread ? b : a);
+        },
+        [&] { assert(true); });
+    }
+  END_EXTEND_TEST
+}
+
+// ----------------------------
+BEGIN_SUITE(Interleaved tests)
+  char **saved;
+  SETUP {
+    static char *no_arguments[] = {(char *)"InterleavedTests", NULL};
+    saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+  }
+  // Runs a test by hand with an option, and returns its failure
+  std::string run(QUTest &test, const std::string &option = "--interleave=random") {
+    char *argv[] = {(char *)"InterleavedTests", (char *)option.c_str(), NULL};
+    QUOptionTracker::Argv(argv);
+    test.Reset();
+    try {
+      test.Run();
+    } catch(QUTestFail * /*err*/) {
+    }
+    QUOptionTracker::Argv(saved);
+    return test.fails() ? test.fail_message() : "";
+  }
+  std::string replay_option(const std::string &failure) {
+    size_t start = failure.find("--interleave-");
+    return failure.substr(start, failure.find(']', start) - start);
+  }
+END_SUITE_AS(interleaved)
+
+TEST(A lost update is found and its seed replays it) {
+  RacyDeposits test("racy deposits");
+  std::string failure = interleaved.run(test);
+  assert_include("Keep both deposits (Expected: 20, got: 10) [schedule --interleave-seed=", failure.c_str(), SHOULD(find the race));
+  std::string seed = interleaved.replay_option(failure);
+  assert_equal(failure, interleaved.run(test, seed),            SHOULD(fail the same way again));
+  assert_include("Explored 1 schedules", test.test_output_text().c_str(), SHOULD(replay just that schedule));
+}
+
+TEST(A search of every schedule finds the race and replays it) {
+  RacyDeposits test("racy deposits");
+  std::string failure = interleaved.run(test, "--interleave=all");
+  assert_include("[schedule --interleave-choices=", failure.c_str(), SHOULD(find the race));
+  std::string choices = interleaved.replay_option(failure);
+  assert_equal(failure, interleaved.run(test, choices),         SHOULD(fail the same way again));
+}
+
+TEST(Locked code passes every schedule) {
+  Account account;
+  explore_interleavings(3,
+    [&] { account.balance = 0; },
+    [&](unsigned thread) { account.SafeDeposit(10); },
+    [&] { assert_equal(30, account.balance,                    SHOULD(keep every deposit)); });
+}
+
+TEST(Deadlocks are found) {
+  LocksInTheWrongOrder test("locks in the wrong order");
+  std::string failure = interleaved.run(test);
+  assert_include("Deadlock", failure.c_str(),                  SHOULD(report the deadlock));
+  assert_include("[schedule --interleave-seed=", failure.c_str(), SHOULD(give the schedule));
+}
+
+TEST(Assertions on the threads are checked) {
+  int schedules = 0;
+  explore_interleavings(2,
+    [&] { schedules++; },
+    [&](unsigned thread) { QU_YIELD(); assert(thread < 2,     SHOULD(number the threads)); },
+    [&] { assert(true); });
+  assert_equal(3 * schedules, passes(),                        SHOULD(run both threads and the check every time));
+}
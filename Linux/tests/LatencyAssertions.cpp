@@ -0,0 +1,110 @@
+//
+// LatencyAssertions.cpp: Percentiles of call times with assert_latency
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_latency.hpp"
+#include <thread>
+
+namespace {
+  // Quick, except that one call in ten sleeps for 2ms
+  struct SometimesSlow {
+    int calls;
+    SometimesSlow() : calls(0) {}
+    void operator()() {
+      if (++calls % 10 == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      }
+    }
+  };
+}
+
+// ----------------------------
+DECLARE_SUITE(Latency histograms)
+
+TEST(Small times have a bucket each) {
+  for (uint64_t ns = 0; ns < 256; ns++) {
+    assert_equal(ns, QUHistogram::Top(QUHistogram::Bucket(ns)), SHOULD(keep the exact time));
+  }
+}
+
+TEST(Large times are kept to within one percent) {
+  const uint64_t times[] = {256, 1000, 123456, 9999999, 3000000000ULL, UINT64_MAX};
+  for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+    size_t bucket = QUHistogram::Bucket(times[i]);
+    uint64_t top = QUHistogram::Top(bucket);
+    assert(bucket < QUHistogram::buckets,                      SHOULD(fit in the histogram));
+    assert(top >= times[i],                                     SHOULD(hold the time in its bucket));
+    assert(top - times[i] <= times[i] / 128,                    SHOULD(be close to the time));
+    assert(QUHistogram::Top(bucket - 1) < times[i],             SHOULD(not fit in the bucket before));
+  }
+}
+
+TEST(Percentiles come from the counts) {
+  QUHistogram histogram;
+  for (uint64_t ns = 1; ns <= 100; ns++) {
+    histogram.Record(ns * 1000);
+  }
+  assert_equal(100ULL, (unsigned long long)histogram.count(),  SHOULD(count each time));
+  assert_equal(1000ULL, (unsigned long long)histogram.min(),   SHOULD(keep the least));
+  assert_equal(100000ULL, (unsigned long long)histogram.max(), SHOULD(keep the most));
+  assert_equal(50500.0, histogram.mean(),                      SHOULD(keep the mean));
+  uint64_t median = histogram.Percentile(50), p99th = histogram.Percentile(99);
+  assert(median >= 50000 && median <= 50500,                  SHOULD(find the median));
+  assert(p99th >= 99000 && p99th <= 99800,                    SHOULD(find the 99th));
+  assert_equal(100000ULL, (unsigned long long)histogram.Percentile(100), SHOULD(give the max exactly));
+}
+
+TEST(Times are described in the nearest unit) {
+  assert_equal("850ns", QUHistogram::Describe(850).c_str(),   SHOULD(give nanoseconds));
+  assert_equal("12.30us", QUHistogram::Describe(12300).c_str(), SHOULD(give microseconds));
+  assert_equal("4.56ms", QUHistogram::Describe(4560000).c_str(), SHOULD(give milliseconds));
+}
+
+// ----------------------------
+DECLARE_SUITE(Latency assertions)
+
+TEST(Bounds that hold pass) {
+  assert_latency([] {}, 1000, p50 < std::chrono::milliseconds(1), pmax < std::chrono::seconds(1), SHOULD(pass));
+  assert_equal(1000ULL, (unsigned long long)last_latency().count(), SHOULD(time each call));
+}
+
+TEST(The slow tail fails a bound on it) {
+  SometimesSlow fn;
+  QULatencyBound bounds[] = {p50 < std::chrono::milliseconds(1), p99 < std::chrono::milliseconds(1)};
+  Qu_Result result = latency_within(fn, 100, bounds, 2);
+  assert_false(result.pass,                                    SHOULD(notice the slow calls));
+  assert_equal(100, fn.calls,                                  SHOULD(call it each time));
+  assert_include("(p99 was not under 1.00ms. 100 calls:", result.msg.c_str(), SHOULD(name the bound));
+  assert_include("\n  p99.9", result.msg.c_str(),              SHOULD(list each percentile));
+  assert_include("  (over 1.00ms)\n  p99.9", result.msg.c_str(), SHOULD(mark the bound that failed));
+  assert_exclude("(over 1.00ms)\n  p90", result.msg.c_str(),   SHOULD(not mark the bound that held));
+}
+
+TEST(The quick calls pass a bound on the median) {
+  SometimesSlow fn;
+  assert_latency(fn, 100, p50 < std::chrono::milliseconds(1), SHOULD(ignore the slow tail));
+}
+
+TEST(Percentiles are recorded as metrics) {
+  assert_latency([] {}, 10, pmax < std::chrono::seconds(1));
+  const std::vector<QUMetric> &recorded = metrics();
+  assert_equal(5u, (unsigned)recorded.size(),                  SHOULD(record five percentiles));
+  if (recorded.size() == 5) {
+    assert_equal("latency p50", recorded[0].name.c_str(),      SHOULD(name the percentile));
+    assert_equal("ns", recorded[0].unit.c_str(),               SHOULD(give nanoseconds));
+    assert_false(recorded[0].rate,                             SHOULD(have no rate));
+    assert_equal("latency max", recorded[4].name.c_str(),      SHOULD(end with the max));
+  }
+}
+
+TEST(Timed calls can wait on threads that print and assert) {
+  assert_latency([this] {
+    std::thread thread([this] {
+      printf("tick ");
+      assert(true,                                             SHOULD(assert from the thread));
+    });
+    thread.join();
+  }, 3, pmax < std::chrono::seconds(1),                        SHOULD(not deadlock));
+  assert_include("tick tick tick ", test_output_text().c_str(), SHOULD(keep what the threads printed));
+}
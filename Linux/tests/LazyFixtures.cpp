@@ -0,0 +1,92 @@
+//
+// LazyFixtures.cpp: Fixtures built on first use, and test filters
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_netbeans.hpp"
+
+namespace {
+  std::string events;
+  struct Level {
+    std::string name;
+    Level(const char *level_name) : name(level_name) { events += "build " + name + ";"; }
+    ~Level() { events += "release " + name + ";"; }
+  };
+}
+
+// ----------------------------
+BEGIN_SUITE(Lazy fixtures)
+  FIXTURE(Level, outer) { return new Level("outer"); }
+  FIXTURE(Level, inner) { outer(); return new Level("inner"); }
+  FIXTURE(Level, unused) { return new Level("unused"); }
+  SETUP_SUITE { events += "setup suite;"; }
+END_SUITE_AS(lazy)
+
+TEST(Nothing is built until a test asks) {
+  assert_equal("setup suite;", events.c_str(),                 SHOULD(not build fixtures up front));
+}
+
+TEST(Asking builds the levels below first) {
+  assert_equal("inner", lazy.inner().name.c_str(),          SHOULD(give the fixture));
+  assert_equal("setup suite;build outer;build inner;", events.c_str(), SHOULD(build outer then inner));
+}
+
+TEST(Fixtures are only built once) {
+  lazy.inner();
+  lazy.outer();
+  assert_equal("setup suite;build outer;build inner;", events.c_str(), SHOULD(reuse the built fixtures));
+}
+
+// ----------------------------
+BEGIN_SUITE(Lazy fixture teardown)
+  FIXTURE(Level, first) { return new Level("first"); }
+  FIXTURE(Level, second) { first(); return new Level("second"); }
+  void finish(void) { ReleaseFixtures(); } // As the suite does once its tests have run
+END_SUITE_AS(teardown)
+
+TEST(Fixtures are released newest first when the suite finishes) {
+  // Forked tests build and release the fixtures of the suite before in their own process
+  if (!QUOptionTracker::Option("fork")) {
+    assert_equal("setup suite;build outer;build inner;release inner;release outer;", events.c_str(), SHOULD(release the suite before in reverse));
+  }
+  events = "";
+  teardown.second();
+  teardown.finish();
+  assert_equal("build first;build second;release second;release first;", events.c_str(), SHOULD(release in reverse));
+  teardown.finish();
+  assert_equal("build first;build second;release second;release first;", events.c_str(), SHOULD(release each fixture once));
+}
+
+// ----------------------------
+BEGIN_SUITE(Test filters)
+  char **saved;
+  bool selects(const char *filter, const char *test_name) {
+    std::string option = std::string("--filter=") + filter;
+    char *argv[] = {(char *)"LazyFixtures", (char *)option.c_str(), NULL};
+    QUOptionTracker::Argv(argv);
+    bool selected = Selected(test_name);
+    QUOptionTracker::Argv(saved);
+    return selected;
+  }
+  SETUP {
+    static char *no_arguments[] = {(char *)"LazyFixtures", NULL};
+    saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+  }
+END_SUITE_AS(filters)
+
+TEST(Without a filter every test is selected) {
+  assert(filters.Selected("anything"),                         SHOULD(select everything));
+}
+
+TEST(A filter selects tests containing any of its texts) {
+  assert(filters.selects("slow", "a slow test"),               SHOULD(match the test name));
+  assert(filters.selects("Test filters/", "a test"),           SHOULD(match the suite name));
+  assert(filters.selects("fast,slow", "a slow test"),          SHOULD(match any text));
+  assert_false(filters.selects("fast", "a slow test"),         SHOULD(leave out other tests));
+}
+
+TEST(A text starting with minus leaves tests out) {
+  assert_false(filters.selects("-slow", "a slow test"),        SHOULD(leave out matches));
+  assert(filters.selects("-slow", "a fast test"),              SHOULD(keep the rest));
+  assert_false(filters.selects("Test filters/,-slow", "a slow test"), SHOULD(leave out even when included));
+}
@@ -0,0 +1,117 @@
+//
+// NoExceptions.cpp: Failing tests in a build without exceptions
+// Built with -fno-exceptions, as a test program of its own: every file in a
+// program must agree on QU_NO_EXCEPTIONS.
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_fuzz.hpp"
+#include "../quick_unit_threads.hpp"
+#include "../quick_unit_netbeans.hpp"
+
+#ifdef QU_NO_EXCEPTIONS
+namespace {
+  bool reached = false;
+
+  // Tests that are run by hand, to look at how they fail
+  EXTEND_TEST(FailsHalfway)
+    void Run(void) { assert_equal(1, 2, "Add up"); reached = true; }
+  END_EXTEND_TEST
+  EXTEND_TEST(Passes)
+    void Run(void) { assert(true); }
+  END_EXTEND_TEST
+  EXTEND_TEST(FailsInAStressThread)
+    void Run(void) { quick_unit::QUStress::Run(this, 4, &FailsInAStressThread::Stress); }
+    void Stress(unsigned thread) { assert(thread != 2, "Not be thread 2"); }
+  END_EXTEND_TEST
+  class FuzzesBadly : public quick_unit::QUFuzzTest {
+  public:
+    FuzzesBadly(const char *msg) : quick_unit::QUFuzzTest(msg) {}
+    void Fuzz(const uint8_t *data, size_t size) { assert(size > 0, "Have data"); }
+  };
+
+  void run(void *test) {
+    ((QUTest *)test)->Reset();
+    ((QUTest *)test)->Run();
+  }
+}
+
+// ----------------------------
+BEGIN_SUITE(Failing without exceptions)
+  QUTest *current;
+  SETUP { current = NULL; }
+  TEARDOWN {
+    if (current) {
+      current->printf("torn down");
+    }
+  }
+  void run_forked(QUTest **tests, size_t count, QUTestOutcome *outcomes) {
+    RunForked(tests, count, outcomes);
+  }
+END_SUITE_AS(suite)
+
+TEST(A failed assertion ends the test) {
+  FailsHalfway test("fails halfway");
+  reached = false;
+  assert(QUTestFail::Catch(run, &test),                        SHOULD(catch the failure));
+  assert_false(reached,                                        SHOULD(not carry on after it));
+  assert_include("Add up (Expected: 1, got: 2)", test.fail_message().c_str(), SHOULD(give the message));
+}
+
+TEST(A failure is caught by the innermost catch) {
+  Passes passes("passes");
+  assert_false(QUTestFail::Catch(run, &passes),                SHOULD(pass a passing test));
+  FailsHalfway test("fails halfway");
+  for (int i = 0; i < 3; i++) {
+    assert(QUTestFail::Catch(run, &test),                      SHOULD(catch it every time));
+  }
+  assert(true,                                                 SHOULD(still be running this test));
+}
+
+TEST(A failed assertion leaves no lock held) {
+  FailsHalfway test("fails halfway");
+  QUTestFail::Catch(run, &test);
+  std::thread other([this] { assert(true); });
+  other.join();
+  assert_equal(1, passes(),                                    SHOULD(let another thread assert));
+}
+
+#ifdef QU_FORK_TESTS
+TEST(The runner tears down a failed test and carries on) {
+  class Failing : public FailsHalfway {
+  public:
+    Failing() : FailsHalfway("failing") {}
+    void Run(void) { suite.current = this; FailsHalfway::Run(); }
+  } failing;
+  Passes passing("passing");
+  QUTest *tests[] = {&failing, &passing};
+  QUTestOutcome outcomes[2];
+  suite.run_forked(tests, 2, outcomes);
+  assert(outcomes[0].failed,                                   SHOULD(fail the failing test));
+  assert_include("Add up", outcomes[0].fail_message.c_str(),   SHOULD(give the message));
+  assert_equal("torn down", outcomes[0].output.c_str(),        SHOULD(tear it down));
+  assert_false(outcomes[1].failed,                             SHOULD(run the next test));
+}
+#endif
+
+TEST(A failure in a stress thread ends just that thread) {
+  FailsInAStressThread test("fails in a stress thread");
+  assert_false(QUTestFail::Catch(run, &test),                  SHOULD(not end the test));
+  assert_equal(1, test.fails(),                                SHOULD(fail once));
+  assert_include("(in thread 2)", test.fail_message().c_str(), SHOULD(name the thread));
+}
+
+TEST(A failing fuzz input is named) {
+  FuzzesBadly test("fuzzes badly");
+  assert(QUTestFail::Catch(run, &test),                        SHOULD(fail on the empty input));
+  assert_include("[input: <empty>]", test.fail_message().c_str(), SHOULD(name the input));
+}
+#else
+ #error NoExceptions.cpp must be built without exceptions
+#endif
+
+// ----------------------------
+int main(int argc, char *argv[]) {
+  TEST_ARGS(argc, argv);
+  return RUN_TESTS();
+}
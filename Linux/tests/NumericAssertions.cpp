@@ -0,0 +1,91 @@
+//
+// NumericAssertions.cpp: Approximate floating point comparisons
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_numeric.hpp"
+#include "../quick_unit_netbeans.hpp"
+
+// ----------------------------
+BEGIN_SUITE(Numeric assertions)
+  std::vector<double> doubles;
+  std::vector<float> floats;
+  SETUP {
+    doubles.resize(1001);
+    floats.resize(1001);
+    for (size_t i = 0; i < doubles.size(); i++) {
+      doubles[i] = 1.0 + i / 1000.0;
+      floats[i] = (float)doubles[i];
+    }
+  }
+END_SUITE_AS(numeric)
+
+TEST(Near values pass) {
+  assert_near(1.0, 1.0 + 1e-10, 1e-9,                          SHOULD(be within the tolerance));
+  assert_near(-2.5, -2.5, 0.0,                                 SHOULD(allow a zero tolerance for equal values));
+  Qu_Result result = near(1.0, 1.1, 0.01);
+  assert_false(result.pass,                                    SHOULD(fail outside the tolerance));
+  assert_include("Expected: 1 +/- 0.01, got: 1.1", result.msg.c_str(), SHOULD(give the values));
+}
+
+TEST(Close arrays pass) {
+  std::vector<double> copy(numeric.doubles);
+  for (size_t i = 0; i < copy.size(); i++) {
+    copy[i] *= 1.0 + 1e-9;
+  }
+  assert_all_close(numeric.doubles, copy, 1e-8, 0.0,           SHOULD(be within the relative tolerance));
+  assert_all_close(&numeric.doubles[0], &copy[0], copy.size(), 0.0, 1e-6, SHOULD(be within the absolute tolerance));
+  assert_all_close(std::vector<float>(), std::vector<float>(), 0.0, 0.0, SHOULD(pass when empty));
+}
+
+TEST(Every violation is counted and the largest is reported) {
+  std::vector<double> copy(numeric.doubles);
+  size_t places[] = {0, 3, 4, 517, 1000};
+  for (size_t i = 0; i < sizeof(places) / sizeof(places[0]); i++) {
+    copy[places[i]] += 0.01 * (i + 1);
+  }
+  quick_unit::QUCloseness closeness = quick_unit::QUCloseCompare<double>::Tolerance(&numeric.doubles[0], &copy[0], copy.size(), 1e-6, 1e-6);
+  assert_equal((size_t)5, closeness.violations,                SHOULD(count each one));
+  assert_equal((size_t)1000, closeness.worst,                  SHOULD(find the largest in the tail));
+  copy[42] += 1.0;
+  Qu_Result result = all_close(numeric.doubles, copy, 1e-6, 1e-6);
+  assert_false(result.pass,                                    SHOULD(fail));
+  assert_include("6 of 1001 values out of tolerance", result.msg.c_str(), SHOULD(give the count));
+  assert_include("at index 42: expected 1.042, got 2.042", result.msg.c_str(), SHOULD(give the worst value));
+  assert_include("rtol 1e-06, atol 1e-06", result.msg.c_str(), SHOULD(give the limits));
+}
+
+TEST(NaN is never close) {
+  std::vector<float> copy(numeric.floats);
+  copy[9] = std::numeric_limits<float>::quiet_NaN();
+  Qu_Result result = all_close(numeric.floats, copy, 1.0, 1.0);
+  assert_false(result.pass,                                    SHOULD(fail on NaN));
+  assert_include("1 of 1001 values out of tolerance. Largest error inf at index 9", result.msg.c_str(), SHOULD(point at the NaN));
+  assert_false(all_close_ulps(numeric.floats, copy, 1000000).pass, SHOULD(fail on NaN by ULPs too));
+}
+
+TEST(ULP distances are measured across zero) {
+  typedef quick_unit::QUCloseCompare<float> Floats;
+  assert_equal(0.0, Floats::UlpDistance(0.0f, -0.0f),          SHOULD(treat the zeros as equal));
+  assert_equal(2.0, Floats::UlpDistance(-std::numeric_limits<float>::denorm_min(), std::numeric_limits<float>::denorm_min()), SHOULD(count across zero));
+  assert_equal(1.0, quick_unit::QUCloseCompare<double>::UlpDistance(1.0, 1.0 + std::numeric_limits<double>::epsilon()), SHOULD(count one step));
+}
+
+TEST(Arrays are compared in ULPs) {
+  std::vector<float> copy(numeric.floats);
+  for (size_t i = 0; i < copy.size(); i += 7) {
+    copy[i] = nextafterf(nextafterf(copy[i], 10.0f), 10.0f);
+  }
+  assert_all_close_ulps(numeric.floats, copy, 2,               SHOULD(allow two ULPs));
+  Qu_Result result = all_close_ulps(&numeric.floats[0], &copy[0], copy.size(), 1);
+  assert_false(result.pass,                                    SHOULD(not allow one ULP));
+  assert_include("143 of 1001 values out of tolerance. Largest error 2 ulps at index 0", result.msg.c_str(), SHOULD(report the first of the worst));
+  assert_include("max ulps 1", result.msg.c_str(),             SHOULD(give the limit));
+}
+
+TEST(Different lengths are reported) {
+  std::vector<double> shorter(numeric.doubles.begin(), numeric.doubles.end() - 1);
+  Qu_Result result = all_close(numeric.doubles, shorter, 1.0, 1.0);
+  assert_false(result.pass,                                    SHOULD(notice the missing value));
+  assert_include("Expected 1001 values, got 1000", result.msg.c_str(), SHOULD(give both sizes));
+}
@@ -0,0 +1,123 @@
+//
+// PooledFixtures.cpp: Fixtures built once and leased to each test
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_pool.hpp"
+#include "../quick_unit_netbeans.hpp"
+#include <stdexcept>
+
+namespace {
+  int built = 0;
+  struct Index {
+    std::vector<int> entries;
+    int resets;
+    Index() : resets(0) {
+      built++;
+      for (int i = 0; i < 1000; i++) {
+        entries.push_back(i * i);
+      }
+    }
+    void Reset() {
+      entries.resize(1000);
+      resets++;
+    }
+  };
+}
+
+QUPool<Index> indexes("Index");
+QUPool<Index> pair_of_indexes("Index pair", 2);
+
+// ----------------------------
+DECLARE_SUITE(Pooled fixtures)
+
+TEST(A lease gets a built fixture) {
+  QUPool<Index>::Lease index(indexes);
+  assert_equal((size_t)1000, index->entries.size(),            SHOULD(be built));
+  assert_equal(81, (*index).entries[9],                        SHOULD(be usable through *));
+}
+
+TEST(The next lease reuses it after a Reset) {
+  QUPool<Index> own("Own index");                              // So it does not matter which tests ran before
+  {
+    QUPool<Index>::Lease first(own);
+    first->entries.push_back(-1);                              // Reset() removes this
+  }
+  int before = built;
+  QUPool<Index>::Lease index(own);
+  assert_equal(before, built,                                  SHOULD(not build another));
+  assert_equal((size_t)1000, index->entries.size(),            SHOULD(have been reset));
+  assert_equal(1, index->resets,                               SHOULD(count the reset));
+  assert_equal(1ul, own.reuses,                                SHOULD(count a hit));
+}
+
+TEST(A second lease from a full pool gets a spare) {
+  QUPool<Index>::Lease first(indexes);
+  unsigned long spares = indexes.spares;
+  {
+    QUPool<Index>::Lease second(indexes);
+    assert(first.get() != second.get(),                        SHOULD(not share the object));
+  }
+  assert_equal(spares + 1, indexes.spares,                     SHOULD(count the spare));
+}
+
+TEST(A bigger pool builds up to its capacity) {
+  QUPool<Index>::Lease first(pair_of_indexes);
+  QUPool<Index>::Lease second(pair_of_indexes);
+  assert(first.get() != second.get(),                          SHOULD(lease different objects));
+  assert_equal(2ul, pair_of_indexes.builds,                    SHOULD(build two));
+  assert_equal(0ul, pair_of_indexes.spares,                    SHOULD(not need a spare));
+}
+
+#ifdef QU_POOL_THREADS
+TEST(Threads wait for a fixture to come back) {
+  QUPool<Index> shared("Shared");
+  std::vector<std::thread> threads;
+  std::vector<Index *> used(8);
+  for (int i = 0; i < 8; i++) {
+    threads.push_back(std::thread([&shared, &used, i]() {
+      QUPool<Index>::Lease index(shared);
+      index->entries.push_back(i);
+      used[i] = index.get();
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+  assert_equal(1ul, shared.builds,                             SHOULD(build once));
+  assert_equal(0ul, shared.spares,                             SHOULD(never need a spare));
+  assert_equal(7ul, shared.reuses,                             SHOULD(share it out in turn));
+  assert(used[0] == used[7],                                   SHOULD(hand out the same object));
+}
+#endif
+
+#ifndef QU_NO_EXCEPTIONS
+namespace {
+  // Throws the first time it is built
+  int unlucky_builds = 0;
+  struct Unlucky {
+    Unlucky() {
+      if (unlucky_builds++ == 0) {
+        throw std::runtime_error("first build");
+      }
+    }
+    void Reset() {}
+  };
+}
+
+TEST(A fixture that fails to build can be built again) {
+  QUPool<Unlucky> unlucky("Unlucky");
+  bool thrown = false;
+  try {
+    QUPool<Unlucky>::Lease first(unlucky);
+  } catch (std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown,                                               SHOULD(pass on the exception));
+  assert_equal(0ul, unlucky.builds,                            SHOULD(not count the failed build));
+  QUPool<Unlucky>::Lease second(unlucky);                      // Would wait for ever on the failed slot
+  assert(second.get() != NULL,                                 SHOULD(build it on the next lease));
+  assert_equal(1ul, unlucky.builds,                            SHOULD(count the build));
+  assert_equal(0ul, unlucky.spares,                            SHOULD(use the pool not a spare));
+}
+#endif
@@ -0,0 +1,86 @@
+//
+// ProfiledTests.cpp: Sampling the stacks of slow tests
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_profile.hpp"
+#include <fstream>
+#include <iterator>
+
+namespace {
+  volatile double sink;
+
+  // Kept out of line, so they have frames of their own
+  __attribute__((noinline)) void spin_inner(double seconds) {
+    double until = QUReporter::now() + seconds;
+    double total = 0;
+    while (QUReporter::now() < until) {
+      for (int i = 0; i < 1000; i++) {
+        total += i * 0.5;
+      }
+    }
+    sink = total;
+  }
+  __attribute__((noinline)) void spin_outer(double seconds) {
+    spin_inner(seconds);
+    sink = sink + 1;
+  }
+
+  std::string read_file(const std::string &path) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  // Runs work as the reporter's test "Profiled/<test>"
+  void profile(quick_unit::ProfileReporter &profiler, const char *test, void (*work)(double), double seconds) {
+    QUReporter &reporter = profiler;
+    QUNameId suite = QUNames::Intern("Profiled");
+    QUNameId name = QUNames::Intern(test);
+    reporter.StartingSpanById(QU_SPAN_TEST, suite, name, 0);
+    double start = QUReporter::now();
+    work(seconds);
+    reporter.SpanById(QU_SPAN_TEST, suite, name, start, QUReporter::now(), 0);
+  }
+}
+
+// ----------------------------
+DECLARE_SUITE(Profiled tests)
+
+// A run with --profile is already sampling these tests, and there is only
+// one SIGPROF timer
+#define SKIP_IF_PROFILING if (QUOptionTracker::Option("profile")) { assert(true); return; }
+
+TEST(A slow test gets a collapsed stack profile) {
+  SKIP_IF_PROFILING
+  quick_unit::ProfileReporter profiler("profiles.tmp");
+  assert(profiler.WantsSpans(),                                SHOULD(want spans once it has a directory));
+  profile(profiler, "a slow test", spin_outer, 0.2);
+  std::string path = profiler.last_profile();
+  assert_equal("profiles.tmp/Profiled.a_slow_test.folded", path.c_str(), SHOULD(name the file after the test));
+  std::string folded = read_file(path);
+  remove(path.c_str());
+  rmdir("profiles.tmp");
+  assert_include("spin_outer(double);", folded.c_str(),         SHOULD(name the caller));
+  assert_include(";(anonymous namespace)::spin_inner(double)", folded.c_str(), SHOULD(name the function that spun));
+  assert_include(" ", folded.c_str(),                          SHOULD(give each stack a count));
+}
+
+TEST(Only tests over the threshold are kept) {
+  SKIP_IF_PROFILING
+  static char *no_arguments[] = {(char *)"ProfiledTests", NULL};
+  static char *arguments[] = {(char *)"ProfiledTests", (char *)"--profile-threshold=10000", NULL};
+  char **saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+  QUOptionTracker::Argv(arguments);
+  quick_unit::ProfileReporter profiler("profiles.tmp");
+  profiler.WantsSpans();
+  QUOptionTracker::Argv(saved);
+  profile(profiler, "a quick test", spin_outer, 0.05);
+  rmdir("profiles.tmp");
+  assert_equal("", profiler.last_profile().c_str(),            SHOULD(not keep a quick test));
+}
+
+TEST(Without a directory the profiler wants no spans) {
+  SKIP_IF_PROFILING
+  quick_unit::ProfileReporter profiler;
+  assert_false(profiler.WantsSpans(),                          SHOULD(not ask the runner for spans));
+}
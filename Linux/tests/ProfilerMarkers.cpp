@@ -0,0 +1,73 @@
+//
+// ProfilerMarkers.cpp: USDT probes and thread names around each test
+//
+
+#include "../quick_unit.hpp"
+#include <fstream>
+#include <iterator>
+#include <stdlib.h>
+#include <sys/prctl.h>
+
+namespace {
+  std::string read_file(const char *path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  std::string thread_name() {
+    char name[17] = {0};
+    prctl(PR_GET_NAME, name, 0, 0, 0);
+    return name;
+  }
+
+  std::string runner_name = thread_name();
+}
+
+// ----------------------------
+DECLARE_SUITE(Profiler probes)
+
+TEST(The probes are described in the program) {
+  #ifdef QU_PROBES
+  std::string program = read_file("/proc/self/exe");
+  const char *probes[] = {"test__start", "test__done", "suite__start", "suite__done"};
+  for (size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); i++) {
+    std::string note = std::string("quick_unit") + '\0' + probes[i] + '\0';
+    assert(program.find(note) != std::string::npos,           SHOULD(have a stapsdt note for the probe));
+  }
+  #else
+  assert(true);
+  #endif
+}
+
+// ----------------------------
+// Turns the names on for the next suite. SETUP_SUITE runs in the runner
+// even with --fork, where the option is read.
+BEGIN_SUITE(Thread names on)
+  SETUP_SUITE { setenv("QU_THREAD_NAMES", "", 1); }
+END_SUITE
+
+TEST(The next suite names its threads) {
+  assert(getenv("QU_THREAD_NAMES") != NULL,                    SHOULD(have set the option));
+}
+
+BEGIN_SUITE(Thread names)
+  TEARDOWN_SUITE { unsetenv("QU_THREAD_NAMES"); }
+END_SUITE
+
+TEST(Short name) {
+  assert_equal("Short name", thread_name().c_str(),            SHOULD(name the thread after the test));
+}
+
+TEST(A name too long for the kernel) {
+  assert_equal("A name too long", thread_name().c_str(),       SHOULD(keep the first 15 characters));
+}
+
+// ----------------------------
+DECLARE_SUITE(Thread names off)
+
+TEST(The thread gets its own name back) {
+  if (!QUOptionTracker::Option("thread-names")) {
+    assert_equal(runner_name.c_str(), thread_name().c_str(),   SHOULD(put the name back after each test));
+  }
+  assert_false(thread_name() == "Short name",                  SHOULD(not keep the last test name));
+}
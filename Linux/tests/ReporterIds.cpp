@@ -0,0 +1,53 @@
+//
+// ReporterIds.cpp: Interned suite and test names for reporters
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_netbeans.hpp"
+
+namespace {
+  std::string shouted(const std::string &name) {
+    std::string loud(name);
+    for (size_t i = 0; i < loud.length(); i++) {
+      loud[i] = (char)toupper(loud[i]);
+    }
+    return loud;
+  }
+}
+
+// Overrides only the events that take names
+BEGIN_REPORTER(Named)
+  std::string heard;
+  void StartingTest(const std::string &suite_name, const std::string &test_name) {
+    heard = suite_name + "/" + test_name;
+  }
+END_REPORTER()
+
+// ----------------------------
+DECLARE_SUITE(Reporter ids)
+
+TEST(A name always gets the same id) {
+  QUNameId id = QUNames::Intern("reporter ids: a name");
+  assert_equal(id, QUNames::Intern(std::string("reporter ids: a name")), SHOULD(give the same id));
+  assert_not_equal(id, QUNames::Intern("reporter ids: another name"), SHOULD(give another name another id));
+  assert_equal("reporter ids: a name", QUNames::Name(id).c_str(), SHOULD(give the name back));
+}
+
+TEST(Tests and their names share ids) {
+  assert_equal(QUNames::Intern(test_name()), test_id(),        SHOULD(intern the test name));
+}
+
+TEST(Forms are made for names from before and after) {
+  QUNameId before = QUNames::Intern("reporter ids: before");
+  unsigned form = QUNames::AddForm(shouted);
+  QUNameId after = QUNames::Intern("reporter ids: after");
+  assert_equal("REPORTER IDS: BEFORE", QUNames::Form(before, form).c_str(), SHOULD(make a form of earlier names));
+  assert_equal("REPORTER IDS: AFTER", QUNames::Form(after, form).c_str(), SHOULD(make a form of later names));
+}
+
+TEST(Events by id reach reporters that take names) {
+  quick_unit::NamedReporter reporter;
+  QUReporter &base = reporter;
+  base.StartingTestById(QUNames::Intern("Suite"), QUNames::Intern("test"));
+  assert_equal("Suite/test", reporter.heard.c_str(),           SHOULD(pass the names on));
+}
@@ -0,0 +1,84 @@
+//
+// ReporterSets.cpp: Reporters declared together at compile time
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_reporters.hpp"
+
+namespace {
+  std::string heard;
+  unsigned started_tests = 0;
+  unsigned passed_tests = 0;
+}
+
+BEGIN_REPORTER(SetFirst)
+  void StartingTestById(QUNameId suite, QUNameId test) { heard += "first starting,"; }
+  void CompletedTestById(QUNameId suite, QUNameId test, double duration) { heard += "first completed,"; }
+END_REPORTER()
+
+BEGIN_REPORTER(SetSecond)
+  void StartingTestById(QUNameId suite, QUNameId test) { heard += "second starting,"; }
+  void CompletedTestById(QUNameId suite, QUNameId test, double duration) { heard += "second completed,"; }
+END_REPORTER()
+
+// Overrides only the events that take names
+BEGIN_REPORTER(SetNamed)
+  void StartingTest(const std::string &suite_name, const std::string &test_name) {
+    heard += suite_name + "/" + test_name + ",";
+  }
+END_REPORTER()
+
+BEGIN_REPORTER(SetCounting)
+  void StartingTestById(QUNameId suite, QUNameId test) { started_tests++; }
+  void PassedTestById(QUNameId suite, QUNameId test, double duration) { passed_tests++; }
+END_REPORTER()
+
+// ----------------------------
+// The set is only for this suite: the reporter from before is put back after
+namespace {
+  QUReporter *reporter_before = QUTestSuiteTracker::CurrentQUReporter();
+}
+REPORTERS(Default, SetCounting)
+DECLARE_SUITE(Reporter sets)
+namespace {
+  QUReporter *reporter_put_back = QUTestSuiteTracker::CurrentQUReporter(reporter_before);
+}
+
+TEST(Starting events go first to last) {
+  quick_unit::QUReporterSet<quick_unit::SetFirstReporter, quick_unit::SetSecondReporter> set;
+  QUReporter &reporter = set;
+  heard.clear();
+  reporter.StartingTestById(QUNames::Intern("Suite"), QUNames::Intern("test"));
+  assert_equal("first starting,second starting,", heard.c_str(), SHOULD(start with the first reporter));
+}
+
+TEST(Finishing events go last to first) {
+  quick_unit::QUReporterSet<quick_unit::SetFirstReporter, quick_unit::SetSecondReporter> set;
+  QUReporter &reporter = set;
+  heard.clear();
+  reporter.CompletedTestById(QUNames::Intern("Suite"), QUNames::Intern("test"), 0.0);
+  assert_equal("second completed,first completed,", heard.c_str(), SHOULD(finish with the first reporter));
+}
+
+TEST(Events by id reach members that take names) {
+  quick_unit::QUReporterSet<quick_unit::SetNamedReporter, quick_unit::SetFirstReporter> set;
+  QUReporter &reporter = set;
+  heard.clear();
+  reporter.StartingTestById(QUNames::Intern("Suite"), QUNames::Intern("test"));
+  assert_equal("Suite/test,first starting,", heard.c_str(), SHOULD(pass the names on));
+}
+
+TEST(Events a member does not handle are not passed on) {
+  quick_unit::QUReporterSet<quick_unit::SetFirstReporter, quick_unit::SetSecondReporter> set;
+  QUReporter &reporter = set;
+  heard.clear();
+  reporter.StartedTestById(QUNames::Intern("Suite"), QUNames::Intern("test"));
+  reporter.PassedTestById(QUNames::Intern("Suite"), QUNames::Intern("test"), 0.0);
+  assert_equal("", heard.c_str(),                              SHOULD(call no one));
+}
+
+TEST(The suite reports to every reporter in its set) {
+  // Forked tests are reported once they have run, so this one may not be yet
+  assert(started_tests >= 4,                                   SHOULD(have seen the tests before start));
+  assert_equal(4u, passed_tests,                               SHOULD(have seen the tests before pass));
+}
@@ -0,0 +1,42 @@
+//
+// StaticTests.cpp: Checks that the compiler does for us
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_static.hpp"
+#include "../quick_unit_netbeans.hpp"
+
+namespace {
+  const char hex_digits[] = "0123456789abcdef";
+
+  constexpr int count_bits(unsigned x) {
+    return x ? (int)(x & 1) + count_bits(x >> 1) : 0;
+  }
+
+  constexpr int hex_value(char c) {
+    return (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+  }
+
+  constexpr bool hex_table_matches(int i) {
+    return i == 16 || (hex_value("0123456789abcdef"[i]) == i && hex_table_matches(i + 1));
+  }
+}
+
+// ----------------------------
+DECLARE_SUITE(Static tests)
+
+STATIC_TEST(Sizes are as expected) {
+  STATIC_ASSERT(sizeof(hex_digits) == 17,  SHOULD(hold sixteen digits and a terminator));
+  STATIC_ASSERT(sizeof(char) == 1,         SHOULD(be one byte per char));
+}
+
+STATIC_TEST(Bits are counted at compile time) {
+  STATIC_ASSERT_EQUAL(0, count_bits(0),           SHOULD(find no bits in zero));
+  STATIC_ASSERT_EQUAL(3, count_bits(7),           SHOULD(count three bits));
+  STATIC_ASSERT_EQUAL(32, count_bits(0xffffffffU), SHOULD(count every bit));
+}
+
+STATIC_TEST(Hex table is consistent) {
+  STATIC_ASSERT(hex_table_matches(0), SHOULD(map every digit to its position));
+  STATIC_ASSERT_EQUAL(-1, hex_value('g'), SHOULD(reject non-hex characters));
+}
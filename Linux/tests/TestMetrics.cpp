@@ -0,0 +1,82 @@
+//
+// TestMetrics.cpp: Numbers recorded by tests with RECORD_METRIC
+//
+
+#include "../quick_unit.hpp"
+#include <vector>
+
+namespace {
+  std::vector<std::string> reported;
+  bool per_second = false;
+  bool ratio_per_second = true;
+
+  // Takes some CPU time, so the test has a duration
+  double busy(int rounds) {
+    volatile double sum = 0;
+    for (int i = 0; i < rounds; i++) {
+      sum += i * 0.5;
+    }
+    return sum;
+  }
+}
+
+// Keeps a note of the metrics it is given, as "<name>=<value> <unit>"
+BEGIN_REPORTER(MetricLog)
+  void TestMetricById(QUNameId suite, QUNameId test, const QUMetric &metric) {
+    std::ostringstream text;
+    text << QUNames::Name(test) << ": " << metric.name << "=" << metric.value << " " << metric.unit;
+    reported.push_back(text.str());
+    if (metric.name == "items" && metric.per_second > 0) {
+      per_second = true;
+    }
+    if (metric.name == "compression ratio") {
+      ratio_per_second = metric.per_second > 0;
+    }
+  }
+END_REPORTER()
+
+// ----------------------------
+// The log is only for this suite: the reporter from before is put back after
+namespace {
+  QUReporter *reporter_before = QUTestSuiteTracker::CurrentQUReporter();
+}
+ADDITIONAL_REPORTER(MetricLog)
+DECLARE_SUITE(Test metrics)
+namespace {
+  QUReporter *reporter_put_back = QUTestSuiteTracker::CurrentQUReporter(reporter_before);
+}
+
+TEST(Measured) {
+  busy(5000000);
+  RECORD_METRIC("items", 1000, "items");
+  RECORD_VALUE("compression ratio", 2.5);
+  assert(true);
+}
+
+TEST(Measured twice) {
+  RECORD_METRIC("items", 1);
+  RECORD_METRIC("items", 2);
+  assert(true);
+}
+
+TEST(Not measured) {
+  assert(true);
+}
+
+// ----------------------------
+DECLARE_SUITE(Test metrics reported)
+
+TEST(Each metric is reported in the order it was recorded) {
+  assert_equal(4u, (unsigned)reported.size(),                  SHOULD(report four metrics));
+  if (reported.size() == 4) {
+    assert_equal("Measured: items=1000 items", reported[0].c_str(), SHOULD(give the value and unit));
+    assert_equal("Measured: compression ratio=2.5 ", reported[1].c_str(), SHOULD(leave the unit empty));
+    assert_equal("Measured twice: items=1 ", reported[2].c_str(), SHOULD(report the first));
+    assert_equal("Measured twice: items=2 ", reported[3].c_str(), SHOULD(report the second));
+  }
+}
+
+TEST(Metrics are given per second of the test) {
+  assert(per_second,                                           SHOULD(work out a rate from the duration));
+  assert_false(ratio_per_second,                               SHOULD(give no rate for a value));
+}
@@ -0,0 +1,83 @@
+//
+// TextMatchers.cpp: Pattern sets and regular expressions
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_text.hpp"
+#include "../quick_unit_netbeans.hpp"
+
+// ----------------------------
+BEGIN_SUITE(Text matchers)
+  std::string log;
+  SETUP {
+    log = "config loaded\nlistening on port 8080\nWARN: slow disk\nready\n";
+  }
+END_SUITE_AS(text)
+
+TEST(All patterns are found in one pass) {
+  const char *steps[] = {"config loaded", "listening on", "ready"};
+  assert_include_all(steps, text.log,                          SHOULD(find every step));
+  assert_include_all(steps, text.log.c_str(),                  SHOULD(search C strings too));
+  std::vector<std::string> none;
+  assert_include_all(none, text.log,                           SHOULD(pass with no patterns));
+}
+
+TEST(Missing patterns are listed) {
+  const char *steps[] = {"config loaded", "shutting down", "ready", "crashed"};
+  Qu_Result result = includes_all(steps, text.log);
+  assert_false(result.pass,                                    SHOULD(fail));
+  assert_include("Expected to see all of 4 patterns in 59 bytes of text. Missing: 'shutting down', 'crashed'", result.msg.c_str(), SHOULD(list the missing ones));
+}
+
+TEST(Excluded patterns are not found) {
+  const char *problems[] = {"ERROR", "retrying", "fatal"};
+  assert_exclude_any(problems, text.log,                       SHOULD(find no problems));
+  std::vector<std::string> warnings(1, "WARN");
+  Qu_Result result = excludes_any(warnings, text.log);
+  assert_false(result.pass,                                    SHOULD(find the warning));
+  assert_include("Expected not to see 'WARN', found at byte 37 (line 3): 'WARN: slow disk'", result.msg.c_str(), SHOULD(say where));
+}
+
+TEST(Overlapping patterns are all found) {
+  const char *patterns[] = {"he", "she", "his", "hers", "s"};
+  std::vector<size_t> first;
+  quick_unit::QUPatternSet set(std::vector<std::string>(patterns, patterns + 5));
+  assert_equal((size_t)4, set.Search("ushers", 6, first),      SHOULD(find four of them));
+  assert_equal((size_t)2, first[0],                            SHOULD(find he inside she));
+  assert_equal((size_t)1, first[1],                            SHOULD(find she));
+  assert_equal(std::string::npos, first[2],                    SHOULD(not find his));
+  assert_equal((size_t)2, first[3],                            SHOULD(find hers));
+  assert_equal((size_t)1, first[4],                            SHOULD(find the first s));
+}
+
+TEST(Each pattern set is built once) {
+  std::vector<std::string> patterns(1, "ready");
+  const quick_unit::QUPatternSet *first = &quick_unit::QUPatternSet::Cached(patterns);
+  assert(first == &quick_unit::QUPatternSet::Cached(patterns), SHOULD(reuse the automaton));
+  patterns.push_back("loaded");
+  assert(first != &quick_unit::QUPatternSet::Cached(patterns), SHOULD(build another for new patterns));
+}
+
+#ifdef QU_HAS_REGEX
+TEST(Regular expressions match anywhere in the text) {
+  assert_matches("port [0-9]+", text.log,                      SHOULD(find the port));
+  Qu_Result result = matches("port [a-z]+", text.log);
+  assert_false(result.pass,                                    SHOULD(fail without a match));
+  assert_include("Expected to match /port [a-z]+/ in 59 bytes of text: 'config loaded'", result.msg.c_str(), SHOULD(show the regex and text));
+}
+
+TEST(Each pattern is compiled once) {
+  const std::regex *compiled = NULL;
+  for (int i = 0; i < 3; i++) {
+    std::string pattern = std::string("ready") + "$";          // A new string each time
+    const std::regex *now = &quick_unit::QURegexCache::Compiled(pattern.c_str());
+    assert(!compiled || compiled == now,                       SHOULD(reuse the regex));
+    compiled = now;
+  }
+  char pattern[] = "abc";
+  const std::regex &first = quick_unit::QURegexCache::Compiled(pattern);
+  strcpy(pattern, "xyz");
+  assert(std::regex_search("xyz", quick_unit::QURegexCache::Compiled(pattern)), SHOULD(notice a changed pattern));
+  assert(std::regex_search("xabcx", first),                    SHOULD(keep the first regex as it was));
+}
+#endif
@@ -0,0 +1,78 @@
+//
+// ThreadedAssertions.cpp: Assertions from many threads, and STRESS_TEST
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_threads.hpp"
+#include "../quick_unit_netbeans.hpp"
+#include "../../code_under_test/vcl.h"
+
+namespace {
+  TCriticalSection section;
+  long total = 0;
+  std::atomic<int> finished(0);
+
+  // Tests that are run by hand, to look at how they fail
+  EXTEND_TEST(FailsInAThread)
+    void Run(void) {
+      std::thread worker([this] { assert_equal(1, 2, "Add up"); printf("still going"); assert(true); });
+      worker.join();
+      assert(true);
+    }
+  END_EXTEND_TEST
+  EXTEND_TEST(FailsInAStressThread)
+    void Run(void) { quick_unit::QUStress::Run(this, 4, &FailsInAStressThread::Stress); }
+    void Stress(unsigned thread) { assert(thread != 2, "Not be thread 2"); }
+  END_EXTEND_TEST
+}
+
+// ----------------------------
+DECLARE_SUITE(Threaded assertions)
+
+TEST(Threads started by a test can make assertions) {
+  std::vector<std::thread> workers;
+  for (int t = 0; t < 8; t++) {
+    workers.push_back(std::thread([this] {
+      for (int i = 0; i < 1000; i++) {
+        assert_equal(i, i);
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+  assert_equal(8000, passes(),                                 SHOULD(count every assertion));
+}
+
+TEST(A failure in a thread fails the test without ending the thread) {
+  FailsInAThread test("fails in a thread");
+  test.Reset();
+  test.Run();
+  assert(test.fails() > 0,                                     SHOULD(fail the test));
+  assert_equal(2, test.passes(),                               SHOULD(carry on after the failure));
+  assert_equal("still going", test.test_output_text().c_str(), SHOULD(keep printf output from the thread));
+  assert_include("(in a thread started by the test)", test.fail_message().c_str(), SHOULD(say where));
+}
+
+TEST(A failure in a stress thread names the thread) {
+  FailsInAStressThread test("fails in a stress thread");
+  test.Reset();
+  test.Run();
+  assert_equal(1, test.fails(),                                SHOULD(fail once));
+  assert_equal(3, test.passes(),                               SHOULD(pass on the other threads));
+  assert_include("Not be thread 2", test.fail_message().c_str(), SHOULD(give the message));
+  assert_include("(in thread 2)", test.fail_message().c_str(), SHOULD(name the thread));
+}
+
+STRESS_TEST(Concurrent adds under a critical section are not lost, 8) {
+  for (int i = 0; i < 20000; i++) {
+    section.Acquire();
+    total++;
+    section.Release();
+  }
+  if (++finished == 8) {
+    assert_equal(8L * 20000, total,                            SHOULD(see every add));
+  } else {
+    assert(true);
+  }
+}
@@ -0,0 +1,135 @@
+//
+// TimeBudgets.cpp: Tests and suites that are too slow for their budgets
+//
+
+#include "../quick_unit.hpp"
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+  std::vector<std::string> failed;    // "<test>: <message>"
+  std::vector<std::string> slow;      // "<test>: <overrun>"
+  std::vector<std::string> passed;
+  std::string slow_suite;
+
+  void sleep_ms(int ms) {
+    usleep(ms * 1000);
+  }
+
+  // Spins until the process has used ms of CPU time
+  void busy_ms(int ms) {
+    clock_t start = clock();
+    volatile double sum = 0;
+    while ((clock() - start) * 1000.0 / CLOCKS_PER_SEC < ms) {
+      sum += 0.5;
+    }
+  }
+}
+
+// Knows nothing of budgets, so takes slow tests as failed
+BEGIN_REPORTER(BudgetFails)
+  void FailedTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &fail_message) {
+    failed.push_back(test_name + ": " + fail_message);
+  }
+  void PassedTest(const std::string &suite_name, const std::string &test_name, double duration) {
+    passed.push_back(test_name);
+  }
+END_REPORTER()
+
+BEGIN_REPORTER(BudgetOverruns)
+  void SlowTestById(QUNameId suite, QUNameId test, double duration, const std::string &overrun) {
+    slow.push_back(QUNames::Name(test) + ": " + overrun);
+  }
+  void SlowSuite(const std::string &suite_name, double duration, const std::string &overrun) {
+    slow_suite = suite_name + ": " + overrun;
+  }
+END_REPORTER()
+
+// ----------------------------
+// Only these reporters see the slow suite, which would otherwise fail the
+// run. The reporter from before is put back after.
+namespace {
+  QUReporter *reporter_before = QUTestSuiteTracker::CurrentQUReporter();
+}
+TEST_REPORTER(BudgetFails)
+ADDITIONAL_REPORTER(BudgetOverruns)
+BEGIN_SUITE_WITHIN(Time budgets, WALL_MS(1))
+END_SUITE
+namespace {
+  QUReporter *reporter_put_back = QUTestSuiteTracker::CurrentQUReporter(reporter_before);
+}
+
+TEST_WITHIN(Within its budget, WALL_MS(60000)) {
+  assert(true);
+}
+
+TEST_WITHIN(Over its budget on the clock, WALL_MS(1)) {
+  sleep_ms(20);
+  assert(true);
+}
+
+TEST_WITHIN(Over its budget of CPU time, CPU_MS(1)) {
+  busy_ms(20);
+  assert(true);
+}
+
+TEST_WITHIN(Sleeping takes no CPU time, CPU_MS(10000)) {
+  sleep_ms(20);
+  assert(true);
+}
+
+TEST_WITHIN(Failed and slow, WALL_MS(1)) {
+  sleep_ms(20);
+  assert(false,                                                SHOULD(fail first));
+}
+
+// ----------------------------
+DECLARE_SUITE(Time budgets reported)
+
+TEST(Tests within their budgets pass) {
+  assert_equal(2u, (unsigned)passed.size(),                    SHOULD(pass two tests));
+  if (passed.size() == 2) {
+    assert_equal("Within its budget", passed[0].c_str(),       SHOULD(pass the quick test));
+    assert_equal("Sleeping takes no CPU time", passed[1].c_str(), SHOULD(only count CPU time against a CPU budget));
+  }
+}
+
+TEST(Slow tests get their own event) {
+  assert_equal(2u, (unsigned)slow.size(),                      SHOULD(report two slow tests));
+  if (slow.size() == 2) {
+    assert_include("Over its budget on the clock: took ", slow[0].c_str(), SHOULD(name the test));
+    assert_include("ms on the clock, over its budget of 1.0ms", slow[0].c_str(), SHOULD(give the budget));
+    assert_include("ms of CPU time, over its budget of 1.0ms", slow[1].c_str(), SHOULD(say the budget was CPU time));
+  }
+}
+
+TEST(Reporters that do not know of budgets see a fail) {
+  assert_equal(3u, (unsigned)failed.size(),                    SHOULD(report three fails));
+  if (failed.size() == 3) {
+    assert_include("Over its budget on the clock: Too slow: took ", failed[0].c_str(), SHOULD(say it was too slow));
+    assert_include("Failed and slow: line ", failed[2].c_str(), SHOULD(report a fail ahead of being slow));
+  }
+}
+
+TEST(Slow suites are reported) {
+  assert_include("Time budgets: took ", slow_suite.c_str(),    SHOULD(name the suite));
+  assert_include("over its budget of 1.0ms", slow_suite.c_str(), SHOULD(give the budget));
+}
+
+TEST(Budgets can be scaled) {
+  static char *no_arguments[] = {(char *)"TimeBudgets", NULL};
+  static char *arguments[] = {(char *)"TimeBudgets", (char *)"--budget-scale=2", NULL};
+  char **saved = QUOptionTracker::Argv() ? QUOptionTracker::Argv() : no_arguments;
+  QUBudget budget = WALL_MS(10);
+  std::string unscaled = budget.Overrun(15, 0);
+  QUOptionTracker::Argv(arguments);
+  std::string scaled = budget.Overrun(15, 0);
+  std::string still_over = budget.Overrun(25, 0);
+  QUOptionTracker::Argv(saved);
+  if (!getenv("QU_BUDGET_SCALE") && !QUOptionTracker::Option("budget-scale")) {
+    assert_equal("took 15.0ms on the clock, over its budget of 10.0ms", unscaled.c_str(), SHOULD(be over without a scale));
+  }
+  assert_equal("", scaled.c_str(),                             SHOULD(stretch the budget));
+  assert_equal("took 25.0ms on the clock, over its budget of 10.0ms x 2.0", still_over.c_str(), SHOULD(show the scale));
+}
@@ -0,0 +1,130 @@
+//
+// TraceEvents.cpp: Timing spans, and the Chrome trace reporter
+//
+
+#include "../quick_unit.hpp"
+#include "../quick_unit_trace.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace {
+  std::vector<std::string> spans;
+  std::string last_waiting;
+
+  const char *kinds[] = {"suite", "suite setup", "suite teardown", "test", "test setup", "test teardown", "fixture setup", "fixture teardown", "reporting"};
+
+  bool spanned(const std::string &span) {
+    return std::find(spans.begin(), spans.end(), span) != spans.end();
+  }
+
+  std::string read_file(const char *path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+}
+
+// Keeps a note of the spans it is given, as "<kind>: <name>"
+BEGIN_REPORTER(SpanLog)
+  bool WantsSpans(void) { return true; }
+  void SpanById(QUSpanKind kind, QUNameId suite, QUNameId name, double start, double end, unsigned lane) {
+    if (end >= start) {
+      spans.push_back(std::string(kinds[kind]) + ": " + QUNames::Name(name));
+    }
+  }
+  void CounterById(QUNameId suite, const char *counter, double value) {
+    std::ostringstream text;
+    text << counter << " " << value;
+    last_waiting = text.str();
+  }
+END_REPORTER()
+
+// ----------------------------
+// The log is only for this suite: the reporter from before is put back after
+namespace {
+  QUReporter *reporter_before = QUTestSuiteTracker::CurrentQUReporter();
+}
+ADDITIONAL_REPORTER(SpanLog)
+BEGIN_SUITE(Trace events)
+  FIXTURE(std::string, greeting) { return new std::string("hello"); }
+END_SUITE_AS(traced)
+namespace {
+  QUReporter *reporter_put_back = QUTestSuiteTracker::CurrentQUReporter(reporter_before);
+}
+
+TEST(A test that came first) {
+  assert(true);
+}
+
+TEST(The suite setup and earlier tests are timed) {
+  assert(spanned("suite setup: Trace events"),                 SHOULD(time SETUP_SUITE));
+  assert(spanned("test setup: The suite setup and earlier tests are timed"), SHOULD(time this test setup));
+  // Forked tests are reported once they have all run
+  if (!QUOptionTracker::Option("fork")) {
+    assert(spanned("reporting: A test that came first"),       SHOULD(time the reporting of the first test));
+  }
+}
+
+TEST(Fixtures are timed as they are built) {
+  assert_equal("hello", traced.greeting().c_str(),            SHOULD(build the fixture));
+  assert(spanned("fixture setup: greeting"),                   SHOULD(time the build));
+}
+
+TEST(The tests waiting are counted) {
+  assert_include("tests waiting", last_waiting.c_str(),        SHOULD(give the count));
+  if (!QUOptionTracker::Option("fork")) {
+    assert_equal("tests waiting 3", last_waiting.c_str(),      SHOULD(count the tests after this one));
+  }
+}
+
+TEST(The trace reporter writes trace events) {
+  const char *path = "trace.tmp.json";
+  {
+    quick_unit::TraceReporter trace(path);
+    QUReporter &reporter = trace;
+    assert(reporter.WantsSpans(),                              SHOULD(want spans once it has a file));
+    double now = QUReporter::now();
+    reporter.SpanById(QU_SPAN_TEST, QUNames::Intern("Suite"), QUNames::Intern("a \"quoted\" test"), now, now + 0.5, 0);
+    reporter.SpanById(QU_SPAN_FIXTURE_SETUP, QUNames::Intern("Suite"), QUNames::Intern("db"), now, now + 0.25, 2);
+    reporter.CounterById(QUNames::Intern("Suite"), "tests waiting", 3);
+    trace.Close();
+  }
+  std::string json = read_file(path);
+  remove(path);
+  assert_equal(0u, (unsigned)json.find("[\n"),                 SHOULD(start an array));
+  assert_include("\"name\":\"a \\\"quoted\\\" test\",\"cat\":\"test\",\"ph\":\"X\"", json.c_str(), SHOULD(write a complete event));
+  assert_include("\"dur\":500000.000", json.c_str(),           SHOULD(give its duration in microseconds));
+  assert_include("\"name\":\"build db\",\"cat\":\"fixture setup\"", json.c_str(), SHOULD(name the fixture));
+  assert_include("\"args\":{\"name\":\"runner\"}", json.c_str(), SHOULD(name the runner track));
+  assert_include("\"args\":{\"name\":\"lane 2\"}", json.c_str(), SHOULD(name the lane track));
+  assert_include("\"ph\":\"C\"", json.c_str(),                 SHOULD(write the counter));
+  assert_include("\"args\":{\"tests waiting\":3}", json.c_str(), SHOULD(give the count));
+  assert_include("}\n]\n", json.c_str(),                        SHOULD(end the array));
+}
+
+TEST(The trace reporter writes metrics as counters) {
+  const char *path = "trace.tmp.json";
+  {
+    quick_unit::TraceReporter trace(path);
+    QUReporter &reporter = trace;
+    QUMetric metric("parsed", 2048, "bytes");
+    metric.per_second = 4096;
+    reporter.TestMetricById(QUNames::Intern("Suite"), QUNames::Intern("test"), metric);
+    reporter.TestMetricById(QUNames::Intern("Suite"), QUNames::Intern("test"), QUMetric("ratio", 2.5, ""));
+    trace.Close();
+  }
+  std::string json = read_file(path);
+  remove(path);
+  assert_include("\"name\":\"parsed\",\"cat\":\"metric\",\"ph\":\"C\"", json.c_str(), SHOULD(write a counter));
+  assert_include("\"args\":{\"bytes\":2048,\"bytes/s\":4096}", json.c_str(), SHOULD(give the value and rate in its unit));
+  assert_include("\"args\":{\"value\":2.5}", json.c_str(),      SHOULD(give a value without a unit));
+}
+
+TEST(Without a file the trace reporter wants no spans) {
+  quick_unit::TraceReporter trace;
+  QUReporter &reporter = trace;
+  if (!QUOptionTracker::Option("trace")) {
+    assert_false(reporter.WantsSpans(),                        SHOULD(not ask the runner for spans));
+  }
+}
@@ -12,6 +12,7 @@
 
 #ifdef unix
 typedef unsigned DWORD;
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
@@ -24,7 +25,57 @@ typedef unsigned DWORD;
 //----------------------------------------------------
 class TCriticalSection {
 //----------------------------------------------------
+protected:
+#ifdef unix
+  pthread_mutex_t _mutex;
+#else
+  CRITICAL_SECTION _section;
+#endif
+
+public:
+  // Like the Windows critical section, a thread can acquire it again
+  TCriticalSection() {
+#ifdef unix
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&_mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+#else
+    InitializeCriticalSection(&_section);
+#endif
+  };
 
+  ~TCriticalSection() {
+#ifdef unix
+    pthread_mutex_destroy(&_mutex);
+#else
+    DeleteCriticalSection(&_section);
+#endif
+  };
+
+  void Acquire(void) {
+#ifdef unix
+    pthread_mutex_lock(&_mutex);
+#else
+    EnterCriticalSection(&_section);
+#endif
+  }
+
+  void Release(void) {
+#ifdef unix
+    pthread_mutex_unlock(&_mutex);
+#else
+    LeaveCriticalSection(&_section);
+#endif
+  }
+
+  void Enter(void) { Acquire(); }
+  void Leave(void) { Release(); }
+
+private:
+  TCriticalSection(const TCriticalSection &);
+  TCriticalSection &operator=(const TCriticalSection &);
 };
 
 //----------------------------------------------------
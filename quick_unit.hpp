@@ -46,12 +46,51 @@
  *  See GitHub/readme.
  *
  *  Test Setup/Teardown methods can be declared. (Also per-suite
- *  setup/teardown.) See GitHub/readme.
+ *  setup/teardown, and FIXTUREs that a suite only builds if a test uses
+ *  them.) See GitHub/readme.
  *
  *  Tests can use printf, or stream text to Output(). Such text
  *  gets routed through the reporters, so can be redirected to
  *  the stream that the reporters are using. See GitHub/readme.
  *
+ *  From C++11, threads that a test starts can make assertions and
+ *  use printf. quick_unit_threads.hpp adds STRESS_TEST, which runs a
+ *  test body on many threads at once. See GitHub/readme.
+ *
+ *  From C++20 on Linux, quick_unit_async.hpp adds ASYNC_TEST, whose body
+ *  is a coroutine. A suite's ASYNC_TESTs all run together on one thread,
+ *  on an event loop that waits for their timers, fds and futures.
+ *
+ *  Big test suites can compile faster: define QU_DECLARATIONS_ONLY for
+ *  every file, and QU_IMPLEMENTATION as well in exactly one of them. Only
+ *  that one then compiles the runner and reporters. See GitHub/readme.
+ *
+ *  RECORD_METRIC(name, value[, unit]) in a test hands a number it measured
+ *  to the reporters, along with its rate per second. RECORD_VALUE is the
+ *  same for numbers that are not counts, so have no rate. See GitHub/readme.
+ *
+ *  Options for add-ins can be given on the command line by passing
+ *  argc/argv to TEST_ARGS(), or through QU_* environment variables.
+ *  e.g. --fuzz-runs=1000 or QU_FUZZ_RUNS=1000. See GitHub/readme.
+ *  --filter=<text>,-<text> runs just the tests whose "suite/test" names
+ *  contain a text and none of the -texts.
+ *  --fork runs each test in a forked copy of the process. See GitHub/readme.
+ *  --thread-names names the thread running a test after the test, for
+ *  profilers. On Linux each test also fires USDT probes (quick_unit:
+ *  test__start and test__done) that perf and bpftrace can attach to.
+ *
+ *  TEST_WITHIN(name, WALL_MS(50)) and BEGIN_SUITE_WITHIN(name, CPU_MS(500))
+ *  give a test or suite a time budget. Going over it fails as "too slow";
+ *  --budget-scale=<x> stretches every budget for slower machines.
+ *
+ *  Define QU_PROFILE_ASSERTIONS (C++11) to count the assertions made at
+ *  each SHOULD(...), or on each line without one, and list the busiest
+ *  sites and those that never ran once the tests are done. See GitHub/readme.
+ *
+ *  Builds without exceptions (-fno-exceptions, or define QU_NO_EXCEPTIONS)
+ *  end a failed test with longjmp instead of a throw. Local destructors in
+ *  the test are then skipped. See GitHub/readme.
+ *
  * Tested on:
  *  Visual Studio 2010
  *  Visual Studio 2005
@@ -62,16 +101,124 @@
 #define QUICK_UNIT_HPP
 
 #include <sstream>
-#include <iostream>
 #include <string>
-#include <list>
-#include <time.h>
-#include <algorithm>
-#include <functional>
+#include <vector>
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
 
+// In a QU_DECLARATIONS_ONLY build only the QU_IMPLEMENTATION translation unit
+// compiles the bodies at the end of this file, so they are not inlined there.
+#if !defined(QU_DECLARATIONS_ONLY)
+ #define QU_INLINE inline
+ #define QU_DEFINE_IMPLEMENTATION
+#elif defined(QU_IMPLEMENTATION)
+ #define QU_INLINE
+ #define QU_DEFINE_IMPLEMENTATION
+#endif
+
+// Tests can make assertions from threads they start
+#if __cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)
+ #define QU_THREADS
+#endif
+// Without exceptions a failed assertion longjmps back to the runner
+#if !defined(QU_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS) && !defined(_CPPUNWIND)
+ #define QU_NO_EXCEPTIONS
+#endif
+#ifdef QU_NO_EXCEPTIONS
+ #include <setjmp.h>
+#endif
+// Each SHOULD(...) counts the assertions made with it, and each assertion
+// without one is counted at its line (see QUAssertionSite)
+#ifdef QU_PROFILE_ASSERTIONS
+ #ifndef QU_THREADS
+  #error QU_PROFILE_ASSERTIONS needs C++11
+ #endif
+ #include <atomic>
+ #include <chrono>
+ #include <deque>
+ #include <map>
+ #if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1926)
+  #define QU_CALLER_FILE __builtin_FILE()
+  #define QU_CALLER_LINE __builtin_LINE()
+ #else
+  #define QU_CALLER_FILE NULL
+  #define QU_CALLER_LINE 0
+ #endif
+#endif
+#ifdef QU_DEFINE_IMPLEMENTATION
+#include <iostream>
+#include <list>
+#include <time.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <deque>
+#include <map>
+#ifdef QU_THREADS
+ #include <mutex>
+#endif
+#ifdef QU_PROFILE_ASSERTIONS
+ #include <algorithm>
+ #include <fstream>
+ #include <iomanip>
+#endif
+#ifndef _WIN32
+ #include <unistd.h>
+ #include <sys/mman.h>
+ #include <sys/wait.h>
+#endif
+#ifdef __linux__
+ #include <sys/prctl.h>
+#endif
+#endif
+
+// Tests can run in forked processes (see --fork)
+#ifndef _WIN32
+ #define QU_FORK_TESTS
+#endif
+// Space kept in shared memory for each forked test's message and output
+#ifndef QU_FORK_RESULT_BYTES
+ #define QU_FORK_RESULT_BYTES 65536
+#endif
+
+// Each test's start and end is marked by a USDT probe, as <sys/sdt.h> would
+// write it, for perf, bpftrace and SystemTap to attach to. A probe is a nop
+// until a tool attaches. Define QU_NO_PROBES to leave them out.
+#if !defined(QU_NO_PROBES) && defined(__GNUC__) && defined(__ELF__) && (defined(__x86_64__) || defined(__aarch64__))
+ #define QU_PROBES
+ #define QU_PROBE_NOTE(name, args) \
+  "990: nop\n" \
+  ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+  ".balign 4\n" \
+  ".4byte 992f-991f, 994f-993f, 3\n" \
+  "991: .asciz \"stapsdt\"\n" \
+  "992: .balign 4\n" \
+  "993: .8byte 990b\n" \
+  ".8byte _.stapsdt.base\n" \
+  ".8byte 0\n" \
+  ".asciz \"quick_unit\"\n" \
+  ".asciz \"" #name "\"\n" \
+  ".asciz \"" args "\"\n" \
+  "994: .balign 4\n" \
+  ".popsection\n" \
+  ".ifndef _.stapsdt.base\n" \
+  ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+  ".weak _.stapsdt.base\n" \
+  ".hidden _.stapsdt.base\n" \
+  "_.stapsdt.base: .space 1\n" \
+  ".size _.stapsdt.base, 1\n" \
+  ".popsection\n" \
+  ".endif\n"
+ // A probe's arguments are pointers or counts, each passed as 8 bytes
+ #define QU_PROBE1(name, a) __asm__ __volatile__(QU_PROBE_NOTE(name, "8@%0") :: "r"((unsigned long)(a)))
+ #define QU_PROBE2(name, a, b) __asm__ __volatile__(QU_PROBE_NOTE(name, "8@%0 8@%1") :: "r"((unsigned long)(a)), "r"((unsigned long)(b)))
+ #define QU_PROBE3(name, a, b, c) __asm__ __volatile__(QU_PROBE_NOTE(name, "8@%0 8@%1 8@%2") :: "r"((unsigned long)(a)), "r"((unsigned long)(b)), "r"((unsigned long)(c)))
+#else
+ #define QU_PROBE1(name, a)
+ #define QU_PROBE2(name, a, b)
+ #define QU_PROBE3(name, a, b, c)
+#endif
+
 namespace quick_unit {
 
 struct Qu_Result {
@@ -84,7 +231,9 @@ struct Qu_Result {
   }
 };
 
+class QUTest;
 class QUTestSuite;
+class QUTestGroup;
 
 /******************************************************************************/
 // Construction tools
@@ -107,19 +256,81 @@ public:
   // Used to track the current output stream.
   // When called with NULL argument it just returns the current output stream
   // When called with a new_stream, the output stream gets changed
-  static std::ostream &Output(std::ostream *new_stream = NULL) {
-    static std::ostream *current;
-    if (!current) {
-      current = &std::cout;
-    }
-    if (new_stream) {
-      current = new_stream;
-    }
-    return *current;
-  }
+  static std::ostream &Output(std::ostream *new_stream = NULL);
 };
 #define TEST_OUTPUT(stream) quick_unit::QUStdOutTracker::Output(&stream);
 
+/******************************************************************************/
+class QUOptionTracker {
+/******************************************************************************/
+public:
+  // Used to track the command line handed over by TEST_ARGS.
+  // When called with NULL argument it just returns the current argv
+  // When called with new_argv, the command line gets changed
+  static char **Argv(char **new_argv = NULL);
+
+  // Looks up an option by name. For Option("fuzz-runs") this returns the
+  // value of --fuzz-runs=<value> ("" for a bare --fuzz-runs), else the value
+  // of environment variable QU_FUZZ_RUNS, else NULL.
+  static const char *Option(const char *name);
+};
+#define TEST_ARGS(argc, argv) quick_unit::QUOptionTracker::Argv(argv);
+
+typedef unsigned QUNameId;
+
+/******************************************************************************/
+class QUNames {  // Suite and test names, interned once as they are registered
+/******************************************************************************/
+public:
+  // The ID of a name. The same name always gets the same ID.
+  static QUNameId Intern(const std::string &name);
+  static const std::string &Name(QUNameId id);
+
+  // Adds a form of every name, such as a reporter's escaped version. Each
+  // name's form is made once, now or when the name is interned. Returns the
+  // form's number, for Form().
+  static unsigned AddForm(std::string (*make)(const std::string &name));
+  static const std::string &Form(QUNameId id, unsigned form);
+};
+
+// The kinds of span the runner times, for reporters that draw a timeline
+enum QUSpanKind {
+  QU_SPAN_SUITE, QU_SPAN_SUITE_SETUP, QU_SPAN_SUITE_TEARDOWN,
+  QU_SPAN_TEST, QU_SPAN_TEST_SETUP, QU_SPAN_TEST_TEARDOWN,
+  QU_SPAN_FIXTURE_SETUP, QU_SPAN_FIXTURE_TEARDOWN,
+  QU_SPAN_REPORTING // Reporters taking a test's results, and writing them out
+};
+
+/******************************************************************************/
+struct QUMetric {  // A number a test recorded with RECORD_METRIC
+/******************************************************************************/
+  std::string name;
+  std::string unit;
+  double value;
+  double per_second;  // value over the test's time on the clock, or 0 if it took no time or !rate
+  bool rate;          // The value is a count, so per_second means something
+
+  QUMetric(const std::string &metric_name, double metric_value, const std::string &metric_unit, bool metric_rate = true)
+    : name(metric_name), unit(metric_unit), value(metric_value), per_second(0), rate(metric_rate) {}
+};
+
+/******************************************************************************/
+struct QUBudget {  // The most time a test or suite should take: WALL_MS(50) or CPU_MS(20)
+/******************************************************************************/
+  double milliseconds;  // 0 for no budget
+  bool cpu;             // CPU time rather than time on the clock
+
+  QUBudget(double budget_milliseconds = 0, bool cpu_time = false) : milliseconds(budget_milliseconds), cpu(cpu_time) {}
+
+  // What went over the budget, scaled by Scale(), given the time taken in
+  // ms on the clock and of the CPU. Empty if it is within the budget.
+  std::string Overrun(double wall, double cpu_time) const;
+  // --budget-scale=<x> (or QU_BUDGET_SCALE) multiplies every budget. 1 if not given.
+  static double Scale(void);
+};
+#define WALL_MS(ms) quick_unit::QUBudget(ms, false)
+#define CPU_MS(ms) quick_unit::QUBudget(ms, true)
+
 /******************************************************************************/
 class QUReporter {  // Base class for all test reporters
 /******************************************************************************/
@@ -139,54 +350,68 @@ public:
   virtual void FailedTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &fail_message) {} // After AfterEachTest();
   virtual void PassedTest(const std::string &suite_name, const std::string &test_name, double duration) {} // After AfterEachTest();
   virtual void TestOutput(const std::string &suite_name, const std::string &test_name, const std::string &text) {} // Before CompletedTest();
+  virtual void TestMetric(const std::string &suite_name, const std::string &test_name, const QUMetric &metric) {} // Each RECORD_METRIC, after TestOutput();
   virtual void CompletedTest(const std::string &suite_name, const std::string &test_name, double duration) {} // After AfterEachTest();
+  virtual void SlowTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &overrun) { // Instead of PassedTest(), for a test over its budget.
+    FailedTestById(QUNames::Intern(suite_name), QUNames::Intern(test_name), duration, "Too slow: " + overrun);   // By default it fails.
+  }
+  virtual void SlowSuite(const std::string &suite_name, double duration, const std::string &overrun) {} // Before CompletedSuite(), for a suite over its budget
+
+  // The runner raises the events below, which name the suite and test by
+  // their QUNames IDs. By default they raise the events above; a reporter
+  // that is called for many tests can override these instead, and use
+  // QUNames::Form() for names it would otherwise rework for every event.
+  virtual void StartingSuiteById(QUNameId suite) { StartingSuite(QUNames::Name(suite)); }
+  virtual void StartedSuiteById(QUNameId suite) { StartedSuite(QUNames::Name(suite)); }
+  virtual void StoppingSuiteById(QUNameId suite, double duration, unsigned passes, unsigned fails) { StoppingSuite(QUNames::Name(suite), duration, passes, fails); }
+  virtual void CompletedSuiteById(QUNameId suite, double duration, unsigned passes, unsigned fails) { CompletedSuite(QUNames::Name(suite), duration, passes, fails); }
+
+  virtual void StartingTestById(QUNameId suite, QUNameId test) { StartingTest(QUNames::Name(suite), QUNames::Name(test)); }
+  virtual void StartedTestById(QUNameId suite, QUNameId test) { StartedTest(QUNames::Name(suite), QUNames::Name(test)); }
+  virtual void StoppingTestById(QUNameId suite, QUNameId test) { StoppingTest(QUNames::Name(suite), QUNames::Name(test)); }
+  virtual void FailedTestById(QUNameId suite, QUNameId test, double duration, const std::string &fail_message) { FailedTest(QUNames::Name(suite), QUNames::Name(test), duration, fail_message); }
+  virtual void PassedTestById(QUNameId suite, QUNameId test, double duration) { PassedTest(QUNames::Name(suite), QUNames::Name(test), duration); }
+  virtual void TestOutputById(QUNameId suite, QUNameId test, const std::string &text) { TestOutput(QUNames::Name(suite), QUNames::Name(test), text); }
+  virtual void TestMetricById(QUNameId suite, QUNameId test, const QUMetric &metric) { TestMetric(QUNames::Name(suite), QUNames::Name(test), metric); }
+  virtual void CompletedTestById(QUNameId suite, QUNameId test, double duration) { CompletedTest(QUNames::Name(suite), QUNames::Name(test), duration); }
+  virtual void SlowTestById(QUNameId suite, QUNameId test, double duration, const std::string &overrun) { SlowTest(QUNames::Name(suite), QUNames::Name(test), duration, overrun); }
+  virtual void SlowSuiteById(QUNameId suite, double duration, const std::string &overrun) { SlowSuite(QUNames::Name(suite), duration, overrun); }
+
+  // Where the time went. The runner only times spans if a reporter wants
+  // them, and raises them from the process that did the work, so a forked
+  // test's spans come from its child. Each span is raised as it starts and
+  // when it is done. name is the suite, test or fixture. Times are from
+  // now(). lane is 0, or for tests run alongside each other (such as
+  // ASYNC_TESTs), which of them this is, from 1.
+  virtual bool WantsSpans(void) { return false; }
+  virtual void StartingSpanById(QUSpanKind kind, QUNameId suite, QUNameId name, unsigned lane) {}
+  virtual void SpanById(QUSpanKind kind, QUNameId suite, QUNameId name, double start, double end, unsigned lane) {}
+  // A count that changes as the suite runs, such as the tests still waiting
+  virtual void CounterById(QUNameId suite, const char *counter, double value) {}
 
   QUReporter() {_chain = NULL; }
   void chain(QUReporter *chain) { _chain = chain; }
   QUReporter *chain(void) {return _chain; }
 
   // Helper: returns the current date/time
-  static const char *current_time(void) {
-    time_t szClock;
-    time( &szClock );
-    #ifdef _MSC_VER
-    static char timebuf[26];
-    struct tm newtime;
-    localtime_s(&newtime, &szClock);
-    asctime_s(timebuf, 26, &newtime);
-    return timebuf;
-    #else
-    return asctime(localtime(&szClock));
-    #endif
-  }
+  static const char *current_time(void);
+  // Helper: seconds on a clock that only goes forward, shared by forked children
+  static double now(void);
 };
 
 /******************************************************************************/
 class DefaultReporter : public QUReporter { // The default test reporter
 /******************************************************************************/
 public:
-  void StartingSuite(const std::string &suite_name) {
-    Output() << std::endl << "====================================================" << std::endl << "Starting " << suite_name << " at " << QUReporter::current_time() << std::endl;
-  }
-  void StoppingSuite(const std::string &suite_name, double duration, unsigned passes, unsigned fails) {
-    Output() << std::endl << "----------------------------------------------------" << std::endl << "Finished " << suite_name << " at " << QUReporter::current_time() <<
-      "Passes: " << passes << " Fails: " << fails << std::endl << "----------------------------------------------------" << std::endl;
-  }
-  void StartingTest(const std::string &suite_name, const std::string &test_name) {
-    Output() << "Test: " << test_name << " => ";
-  }
-  void FailedTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &fail_message) {
-    Output() << "FAILED. " << fail_message << std::endl;
-  }
-  void PassedTest(const std::string &suite_name, const std::string &test_name, double duration) {
-    Output() << "OK." << std::endl;
-  }
-  void TestOutput(const std::string &suite_name, const std::string &test_name, const std::string &text) {
-    Output()
-      << "-- Output --" << std::endl
-      << text
-      << "------------" << std::endl;
-  }
+  void StartingSuite(const std::string &suite_name);
+  void StoppingSuite(const std::string &suite_name, double duration, unsigned passes, unsigned fails);
+  void StartingTest(const std::string &suite_name, const std::string &test_name);
+  void FailedTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &fail_message);
+  void PassedTest(const std::string &suite_name, const std::string &test_name, double duration);
+  void TestOutput(const std::string &suite_name, const std::string &test_name, const std::string &text);
+  void TestMetric(const std::string &suite_name, const std::string &test_name, const QUMetric &metric);
+  void SlowTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &overrun);
+  void SlowSuite(const std::string &suite_name, double duration, const std::string &overrun);
 };
 
 /******************************************************************************/
@@ -198,40 +423,107 @@ public:
   // QUTestSuite calls this from its constructor to set the current suite and
   // get the old one.
   // QUTests call this with a NULL parameter to get the current suite.
-  static QUTestSuite *CurrentQUTestSuite(QUTestSuite *cur = NULL) {
-    static QUTestSuite *current;
-    if (cur) {
-      QUTestSuite *old_cur = current;
-      current = cur;
-      return old_cur;
-    }
-    return current;
-  }
+  static QUTestSuite *CurrentQUTestSuite(QUTestSuite *cur = NULL);
 
   // Used to track the current QUReporter, and to set it to the
   // default reporter if no other reporter is declared.
-  static QUReporter *CurrentQUReporter(QUReporter *cur = NULL, bool chain = false) {
-    static DefaultReporter defaultQUReporter;
-    static QUReporter *current;
-    if (!current) {
-      current = &defaultQUReporter;
-    }
-    if (cur) {
-      if (chain) {
-        cur->chain(current);
-      }
-      current = cur;
-    }
-    return current;
-  }
+  static QUReporter *CurrentQUReporter(QUReporter *cur = NULL, bool chain = false);
 };
 
 /******************************************************************************/
 class QUTestFail {
 /******************************************************************************/
-  // Exception object thrown when a test fails
+  // Exception object thrown when a test fails. With QU_NO_EXCEPTIONS nothing
+  // is thrown: the failure longjmps to the innermost Catch() on its thread.
+public:
+  // Runs body(context), and returns true if an assertion in it failed
+  static bool Catch(void (*body)(void *), void *context);
+  // Ends the failed test: throws, or jumps to the innermost Catch()
+  static void Raise(void);
+
+#ifdef QU_NO_EXCEPTIONS
+private:
+  static jmp_buf *&Landing(void);
+#endif
+};
+
+#ifdef QU_PROFILE_ASSERTIONS
+/******************************************************************************/
+struct QUCaller {  // The file and line an assertion was made on
+/******************************************************************************/
+  const char *file;   // NULL if unknown
+  int line;
+
+  // As a default argument, gives the caller's file and line
+  static QUCaller Here(const char *caller_file = QU_CALLER_FILE, int caller_line = QU_CALLER_LINE) {
+    QUCaller caller = {caller_file, caller_line};
+    return caller;
+  }
 };
 
+/******************************************************************************/
+class QUAssertionSite {  // A SHOULD(...), or a line, and the assertions made there
+/******************************************************************************/
+public:
+  const char *file;
+  int line;
+  const char *text;
+
+  // Every site is listed as the program starts, so those that never run
+  // are listed too
+  QUAssertionSite(const char *site_file, int site_line, const char *site_text);
+  static QUAssertionSite *First(void) { return Head(); }
+  QUAssertionSite *next(void) { return _next; }
+
+  unsigned long long count(void) { return _counts->count.load(); } // Assertions made here
+  unsigned long long fails(void) { return _counts->fails.load(); }
+  unsigned long long nanoseconds(void) { return _counts->nanoseconds.load(); } // With --assertion-timing
+
+  // SHOULD(...) calls this as the assertion's arguments are worked out.
+  // The assertion then calls Recorded() with the text it was given, and
+  // where it was made, which is its site if the text was not a SHOULD(...).
+  const char *Hit(void) {
+    _counts->count.fetch_add(1, std::memory_order_relaxed);
+    Pending &pending = ThisThread();
+    pending.site = this;
+    if (Timing()) {
+      pending.start = std::chrono::steady_clock::now();
+    }
+    return text;
+  }
+  static void Recorded(const char *msg, bool pass, const QUCaller &caller);
+
+  // Writes out the sites once the tests have run, and passes on their fails
+  static int Report(int fails);
+
+private:
+  // The counts are kept in memory shared with children forked by --fork
+  struct Counts {
+    std::atomic<unsigned long long> count;
+    std::atomic<unsigned long long> fails;
+    std::atomic<unsigned long long> nanoseconds;
+  };
+  struct Pending {
+    QUAssertionSite *site;
+    std::chrono::steady_clock::time_point start;
+  };
+  QUAssertionSite *_next;
+  Counts *_counts;
+  static Counts *NewCounts(void);
+  static QUAssertionSite *At(const QUCaller &caller);
+  static QUAssertionSite *&Head(void) { static QUAssertionSite *head = NULL; return head; }
+  static std::map<const char *, QUAssertionSite *> &Texts(void) { static std::map<const char *, QUAssertionSite *> texts; return texts; }
+  static Pending &ThisThread(void) { static thread_local Pending pending = {NULL, std::chrono::steady_clock::time_point()}; return pending; }
+  static bool Timing(void) { static const bool timing = QUOptionTracker::Option("assertion-timing") != NULL; return timing; }
+};
+
+// Each SHOULD(...) has a Site type of its own, and so a record of its own
+template <class Site> struct QUAssertionSiteOf {
+  static QUAssertionSite site;
+};
+template <class Site> QUAssertionSite QUAssertionSiteOf<Site>::site(Site::file(), Site::line(), Site::text());
+#endif
+
 #define ADD_MATCHER(name,...) Qu_Result name(__VA_ARGS__)
 #define MATCHER(condition, ...) \
     bool is_true = condition;\
@@ -241,12 +533,76 @@ class QUTestFail {
       _expectation = _expectation_builder.str();\
     }\
     return result(is_true, _expectation);
-#define ADD_ASSERTION(name,...) void QU_TOKEN_MERGE(QU_ASSERT,_ ## name)(__VA_ARGS__, const char *msg = NULL)
-#define ASSERTION(test) _assert(test, msg);
+// With QU_PROFILE_ASSERTIONS each assertion is also given where it was made
+#ifdef QU_PROFILE_ASSERTIONS
+ #define QU_CALLER_PARAMETER , quick_unit::QUCaller qu_caller = quick_unit::QUCaller::Here()
+ #define QU_CALLER_ARGUMENT , qu_caller
+#else
+ #define QU_CALLER_PARAMETER
+ #define QU_CALLER_ARGUMENT
+#endif
+#define ADD_ASSERTION(name,...) void QU_TOKEN_MERGE(QU_ASSERT,_ ## name)(__VA_ARGS__, const char *msg = NULL QU_CALLER_PARAMETER)
+// The matcher runs without the lock, which _record() only takes to record
+// its result. The failure is raised once the result is gone, as a longjmp
+// (with QU_NO_EXCEPTIONS) would skip its destructor.
+#define ASSERTION(test) { bool qu_failed = _record(test, msg QU_CALLER_ARGUMENT); if (qu_failed) quick_unit::QUTestFail::Raise(); }
+
+/******************************************************************************/
+class QUAssertionLock {  // Lets threads started by a test make assertions
+/******************************************************************************/
+public:
+  // Held while an assertion's result, output or a metric is recorded (from
+  // C++11). Never while a matcher runs, as it may wait on a thread that
+  // asserts too.
+  QUAssertionLock();
+  ~QUAssertionLock();
+
+  // True on threads where a failed assertion throws to end the test: the
+  // thread running the tests, and STRESS_TEST threads. Other threads just
+  // record the failure and carry on, as an exception would end the program.
+  static bool &ThrowsFailures();
+  // Named threads are named in the failure message
+  static std::string &ThreadName();
+  // Unlocks whatever this thread holds, before a longjmp skips the
+  // destructors that would have
+  static void ReleaseAll();
+};
+
+#ifdef QU_THREADS
+/******************************************************************************/
+class QUScratchStream {  // A matcher's _expectation_builder: one per thread
+/******************************************************************************/
+public:
+  template <class T> std::ostream &operator<<(const T &value) { return Stream() << value; }
+  std::ostream &operator<<(std::ostream &(*manipulator)(std::ostream &)) { return Stream() << manipulator; }
+  std::string str(void) const { return Stream().str(); }
+  void str(const std::string &text) { Stream().str(text); }
+private:
+  static std::ostringstream &Stream(void) { static thread_local std::ostringstream stream; return stream; }
+};
+
+/******************************************************************************/
+class QUScratchString {  // A matcher's _expectation: one per thread
+/******************************************************************************/
+public:
+  QUScratchString &operator=(const std::string &text) { Text() = text; return *this; }
+  operator const std::string &() const { return Text(); }
+private:
+  static std::string &Text(void) { static thread_local std::string text; return text; }
+};
+#else
+typedef std::ostringstream QUScratchStream;
+typedef std::string QUScratchString;
+#endif
 
 /******************************************************************************/
 class QUTest {  // Pure base class for all tests
 /******************************************************************************/
+private:
+  friend class QUTestSuite;
+  QUTest *_next_test; // The suite keeps its tests in a chain
+  QUNameId _test_id;
+
 protected:
   int _fails;
   int _passes;
@@ -254,89 +610,47 @@ protected:
   std::string _test_name;
   std::string _fail_message;
   std::ostringstream _info_message;
-  std::ostringstream _expectation_builder;
+  QUScratchStream _expectation_builder; // Per thread, as matchers can run on many at once
   std::string _full_message;
   std::ostringstream _output;
   std::string _output_message;
-  std::string _expectation;
+  QUScratchString _expectation;         // Per thread too
+  std::vector<QUMetric> _metrics;
 
 protected:
   // test printf helper
-  int format_arg_list(std::string& out, int length, const char *fmt, va_list args) {
-    if (!fmt) return -1;
-    int result = 0;
-    char *buffer = NULL;
-    buffer = new char [length + 1];
-    memset(buffer, 0, length + 1);
-    #ifdef _MSC_VER
-    result = vsnprintf_s(buffer, length + 1, _TRUNCATE, fmt, args);
-    #else
-    result = vsnprintf(buffer, length, fmt, args);
-    #endif
-    out = buffer;
-    delete [] buffer;
-    return result;
-  }
+  int format_arg_list(std::string& out, int length, const char *fmt, va_list args);
 
 public:
   QUTest(const char *msg) {
+    _next_test = NULL;
     _test_name = msg;
+    _test_id = QUNames::Intern(_test_name);
      Reset();
   }
-  void Reset() {
-    _fails = 0;
-    _passes = 0;
-    _assertions = 0;
-    _fail_message = "";
-     _info_message.str("");
-  }
+  void Reset();
   virtual void Run(void) = 0; // Must be subclassed
+  virtual QUTestGroup *Group(void) { return NULL; } // Tests in a group run together
+  virtual QUBudget Budget(void) { return QUBudget(); } // TEST_WITHIN gives a test a time budget
   const std::string &test_name() { return _test_name; }
+  QUNameId test_id() { return _test_id; }
 
   // Pass/fail tracking
   int passes() { return _passes; }
-  int fails() {
-    if (_passes + _fails == 0) {
-      return 1; // No asserts - not a valid test. Report as a fail
-    }
-    return _fails;
-  }
-  const std::string &fail_message() {
-    if (_passes + _fails == 0) {
-      _full_message = "No assertions were executed/completed";
-    } else {
-      _full_message = _fail_message + _info_message.str();
-    }
-    return _full_message;
-  }
-
-  void force_fail_message(const char *forced_message) {
-    std::ostringstream os;
-    os << forced_message << " Completed assertions:" << _assertions;
-    _fail_message = os.str();
-    _fails++;
-  }
+  int fails();
+  const std::string &fail_message();
+  void force_fail_message(const char *forced_message);
 
   // Test output text helpers
-  const std::string &test_output_text() {_output_message = _output.str(); _output.seekp(0, std::ios::beg); return _output_message;}
+  const std::string &test_output_text();
   std::ostream &Output() {return _output;}
-  int printf(const char* fmt, ...) {
-    int count = 0;
-    va_list args;
-    va_start(args, fmt);
-    std::string s;
-    int length = 256;
-    int result = format_arg_list(s, length, fmt, args);
-    count += result;
-    va_end(args);
-    if (result >= 256) {
-      va_start(args, fmt);
-      format_arg_list(s, result + 1, fmt, args);
-      va_end(args);
-    }
-    _output << s;
-    return count;
-  }
+  int printf(const char* fmt, ...);
+
+  // Numbers the test measured, such as items processed, for the reporters.
+  // A value that is not a count, such as a latency, has no rate.
+  void record_metric(const char *name, double value, const char *unit = "", bool rate = true);
+  void record_value(const char *name, double value, const char *unit = "") { record_metric(name, value, unit, false); }
+  const std::vector<QUMetric> &metrics() { return _metrics; }
 
   Qu_Result result(bool truth, const std::string expectation) {
     Qu_Result X(truth, expectation);
@@ -344,58 +658,36 @@ public:
   }
 
   // Result matcher: truth
-  ADD_MATCHER(is_true, bool truth) {
-    MATCHER(truth, " (Expected result was not true)");
-  }
+  ADD_MATCHER(is_true, bool truth);
   // Result matcher: falsity
-  ADD_MATCHER(is_false, bool truth) {
-    MATCHER(!truth, " (Expected result was not false)");
-  }
+  ADD_MATCHER(is_false, bool truth);
   // Result matchers: Equality
   template <class T> ADD_MATCHER(equal, const T& a, const T& b) {
     MATCHER((a == b), " (Expected: " << a << ", got: " << b << ")");
   }
-  ADD_MATCHER(equal, const char *a, const char *b) {
-    MATCHER((strcmp(a,b) == 0), " (Expected: " << a << ", got: " << b << ")");
-  }
+  ADD_MATCHER(equal, const char *a, const char *b);
   // Result matchers: Inequality
   template <class T> ADD_MATCHER(not_equal, const T& a, const T& b) {
     MATCHER((a != b), " (Expected difference. Both: " << a << ")");
   }
-  ADD_MATCHER(not_equal, const char *a, const char *b) {
-    MATCHER((strcmp(a,b) != 0), " (Expected difference. Both: " << a << ")");
-  }
+  ADD_MATCHER(not_equal, const char *a, const char *b);
   // Result matcher: inclusion/exclusion
-  ADD_MATCHER(includes, const char *inclusion, const char *text) {
-    MATCHER((strstr(text, inclusion) != NULL), " (Expected to see '" << inclusion << "' in '"<< text << "')");
-  }
-  ADD_MATCHER(excludes, const char *inclusion, const char *text) {
-    MATCHER((strstr(text, inclusion) == NULL), " (Expected not to see '" << inclusion << "' in '"<< text << "')");
-  }
+  ADD_MATCHER(includes, const char *inclusion, const char *text);
+  ADD_MATCHER(excludes, const char *inclusion, const char *text);
 
-  // The core assertion handler
-  void _assert(Qu_Result result, const char *msg = NULL) {
-    _assertions++;
-    if (result.pass) {
-      _info_message.str("");
-      _passes++;
-    } else {
-      _info_message << result.msg;
-      if (msg) {
-        _fail_message = msg;
-      } else {
-        std::ostringstream os;
-        os << "assertion #" << _assertions;
-        _fail_message = os.str();
-      }
-      _fails++;
-      throw new QUTestFail();
-    }
-  }
+  // The core assertion handler: records the result, and returns true if the
+  // test must now end, by QUTestFail::Raise() once the caller's temporaries
+  // are destroyed
+  bool _record(const Qu_Result &result, const char *msg = NULL);
+  #ifdef QU_PROFILE_ASSERTIONS
+  bool _record(const Qu_Result &result, const char *msg, const QUCaller &caller);
+  #endif
+  // Records the result, and raises a failure itself
+  void _assert(Qu_Result result, const char *msg = NULL);
 
   // Assertions
   // ... true/false
-  void QU_ASSERT(bool truth, const char *msg = NULL) { _assert(is_true(truth), msg); }
+  void QU_ASSERT(bool truth, const char *msg = NULL QU_CALLER_PARAMETER) { ASSERTION(is_true(truth)); }
   ADD_ASSERTION(true, bool truth)  {ASSERTION(is_true(truth)); }
   ADD_ASSERTION(false, bool truth) {ASSERTION(is_false(truth)); }
   // ... equal
@@ -409,89 +701,130 @@ public:
   ADD_ASSERTION(exclude, const char *inclusion, const char *text) {ASSERTION(excludes(inclusion, text));}
 };
 
+/******************************************************************************/
+class QUFixture {  // A suite FIXTURE, built when a test first asks for it
+/******************************************************************************/
+private:
+  friend class QUTestSuite;
+  QUFixture *_next_built; // The suite keeps built fixtures in a chain, newest first
+  QUNameId _name_id;      // Its name, for reporters' spans
+  bool _named;
+
+public:
+  QUFixture() { _next_built = NULL; _name_id = 0; _named = false; }
+  virtual ~QUFixture() {}
+  virtual void Release() = 0;
+};
+
+/******************************************************************************/
+struct QUTestOutcome {  // What happened when a test ran
+/******************************************************************************/
+  bool failed;
+  double duration;  // ms of CPU time, as clock() counts it
+  double wall;      // ms on the clock
+  std::string fail_message;
+  std::string output;
+  std::vector<QUMetric> metrics;
+
+  QUTestOutcome() : failed(false), duration(0), wall(0) {}
+};
+
+/******************************************************************************/
+class QUTestGroup {  // Runs its tests together, e.g. ASYNC_TESTs on an event loop
+/******************************************************************************/
+public:
+  virtual ~QUTestGroup() {}
+  // Runs the suite's selected tests from this group and fills in how each
+  // went. Before() must be called as each test starts and After() as it ends.
+  virtual void RunTogether(QUTestSuite &suite, QUTest **tests, size_t count, QUTestOutcome *outcomes) = 0;
+
+protected:
+  static void Before(QUTestSuite &suite);
+  static void After(QUTestSuite &suite);
+  // For reporters' timelines: a time to start a span from, then the span
+  static double SpanStart(QUTestSuite &suite, QUTest *test, unsigned lane);
+  static void Span(QUTestSuite &suite, QUTest *test, double start, unsigned lane);
+  static void Counter(QUTestSuite &suite, const char *counter, double value);
+};
+
+template <class T> class QULazy : public QUFixture {
+  T *_object;
+public:
+  QULazy() { _object = NULL; }
+  ~QULazy() { Release(); }
+  T *get() { return _object; }
+  void set(T *object) { _object = object; }
+  void Release() { delete _object; _object = NULL; }
+};
+
 /******************************************************************************/
 class QUTestSuite {
 /******************************************************************************/
 private:
+  friend class QUTestGroup;
   std::string _suite_name;
-  std::list<QUTest *> _tests;
+  QUNameId _suite_id;
+  QUTest *_first_test;
+  QUTest *_last_test;
   QUReporter * _reporter;
+  QUReporter ** _reporters; // _reporter and its chain, listed at the first RunAll
+  size_t _reporter_count;
+  bool _spans;              // A reporter wants spans
+  bool _thread_names;       // --thread-names: the thread is named after its test
+  char _runner_name[17];    // The thread's own name, to put back
   QUTestSuite * _chain;
+  QUFixture *_built;
+
+  bool RunBody(QUTest *test); // The test itself. Returns true if it failed
+  static void RunTest(void *test) { ((QUTest *)test)->Run(); }
+  // Runs a test in this process. With reported, the reporters get
+  // StartedTest() after its setup and StoppingTest() before its teardown.
+  void RunHere(QUTest *test, QUTestOutcome &outcome, bool reported = false);
+
+  // Marks where each test starts and ends for profilers and tracers: the
+  // test__start and test__done probes, and with --thread-names the thread
+  // takes the test's name while it runs (which perf records with each
+  // sample). Tests in a lane of their own share the runner's thread, so do
+  // not rename it.
+  void MarkStart(QUTest *test, unsigned lane = 0);
+  void MarkEnd(QUTest *test, bool failed, unsigned lane = 0);
 
 protected:
   virtual void BeforeAllTests() {}
   virtual void AfterAllTests() {}
   virtual void BeforeEachTest() {}
   virtual void AfterEachTest() {}
+  virtual QUBudget Budget(void) { return QUBudget(); } // BEGIN_SUITE_WITHIN gives a suite a time budget
+
+  // Times a span for the reporters that want them: take SpanStart() as the
+  // work starts, and call Span() when it is done
+  double SpanStart(QUSpanKind kind, QUNameId name, unsigned lane = 0);
+  double SpanStart(QUSpanKind kind, const char *name);
+  void Span(QUSpanKind kind, QUNameId name, double start, unsigned lane = 0);
+  void Counter(const char *counter, double value);
+
+  // FIXTUREs register here once built, to be released in reverse order,
+  // down to (and not including) the fixture that was newest at some point
+  void Built(QUFixture *fixture);
+  void Built(QUFixture *fixture, const char *name, double started);
+  void ReleaseFixtures(QUFixture *kept = NULL);
+
+  // Runs the tests one after another in a child process forked from this
+  // one, so they start from its state and their changes are thrown away.
+  // A test that kills its process fails, and the rest run in a new child.
+  // Without fork() the tests just run here.
+  void RunForked(QUTest **tests, size_t count, QUTestOutcome *outcomes);
 
 public:
-  QUTestSuite(const char *msg) {
-    _suite_name = msg;
-    _reporter = QUTestSuiteTracker::CurrentQUReporter();
-    _chain = QUTestSuiteTracker::CurrentQUTestSuite(this);
-  }
-  void Add(QUTest *test) {
-    _tests.push_back(test);
-  }
-  int RunAll(void) {
-    unsigned total_fails = 0;
-    if (_chain) {
-      total_fails += _chain->RunAll();
-    }
-    std::list<QUReporter *> reporters;
-    QUReporter *r = _reporter;
-    while(r) {
-      reporters.push_back(r);
-      r = r->chain();
-    }
-    unsigned passes = 0;
-    unsigned fails = 0;
-    int suite_start = clock();
-
-    #define EACH_QUREPORTER(op) for (std::list<QUReporter *>::iterator qfiter = reporters.begin(); qfiter != reporters.end(); ++qfiter) {(*qfiter)->op; }
-    #define EACH_QUREPORTER_REVERSE(op) for (std::list<QUReporter *>::reverse_iterator qriter = reporters.rbegin(); qriter != reporters.rend(); ++qriter) {(*qriter)->op; }
-    EACH_QUREPORTER(StartingSuite(_suite_name))
-    BeforeAllTests();
-    EACH_QUREPORTER(StartedSuite(_suite_name))
-    for (std::list<QUTest *>::iterator iter = _tests.begin(); iter != _tests.end(); ++iter) {
-      bool failed = false;
-      std::string test_name = (*iter)->test_name();
-      EACH_QUREPORTER(StartingTest(_suite_name, test_name))
-      int test_start = clock();
-      BeforeEachTest();
-      EACH_QUREPORTER(StartedTest(_suite_name, test_name))
-      try {
-        (*iter)->Reset();
-        (*iter)->Run();
-      } catch(QUTestFail * /*err*/) {
-        // Failed assertions cause us to come here
-        failed = true;
-      } catch(...) {
-        failed = true;
-        (*iter)->force_fail_message("unexpected exception in the test");
-      }
-      EACH_QUREPORTER_REVERSE(StoppingTest(_suite_name, test_name))
-      AfterEachTest();
-      double duration = (clock() - test_start) / 1000.0;
-      if (failed || (*iter)->fails()) {
-        fails++;
-        total_fails++;
-        EACH_QUREPORTER_REVERSE(FailedTest(_suite_name, test_name, duration, (*iter)->fail_message()))
-      } else {
-        passes++;
-        EACH_QUREPORTER_REVERSE(PassedTest(_suite_name, test_name, duration))
-      }
-      std::string output = (*iter)->test_output_text();
-      if (!output.empty()) {
-        EACH_QUREPORTER_REVERSE(TestOutput(_suite_name, test_name, output))
-      }
-      EACH_QUREPORTER_REVERSE(CompletedTest(_suite_name, test_name, duration))
-    }
-    EACH_QUREPORTER_REVERSE(StoppingSuite(_suite_name, (clock() - suite_start) / 1000.0, passes, fails))
-    AfterAllTests();
-    EACH_QUREPORTER_REVERSE(CompletedSuite(_suite_name, (clock() - suite_start) / 1000.0, passes, fails))
-    return total_fails;
-  }
+  QUTestSuite(const char *msg);
+  virtual ~QUTestSuite() { delete [] _reporters; }
+  void Add(QUTest *test);
+  int RunAll(void);
+
+  // True if --filter (or QU_FILTER) selects the test. The filter is a
+  // comma separated list of texts to look for in "suite name/test name";
+  // a text starting with - deselects the tests that contain it.
+  bool Selected(const std::string &test_name);
 };
 
 /******************************************************************************/
@@ -500,12 +833,30 @@ public:
 #define EXTEND_TEST(name) class name : public quick_unit::QU_TEST_ANCESTOR { public: name(const char *msg) : quick_unit::QU_TEST_ANCESTOR(msg) {}
 #define END_EXTEND_TEST };
 
+// Records a number the test measured, for the reporters. The unit is
+// optional: RECORD_METRIC("items", count) or RECORD_METRIC("parsed", n, "bytes")
+#define RECORD_METRIC(...) record_metric(__VA_ARGS__)
+// The same for a number that is not a count, such as a ratio, so has no
+// rate per second: RECORD_VALUE("compression ratio", ratio)
+#define RECORD_VALUE(...) record_value(__VA_ARGS__)
+
 // MUST be on a single line
 #define TEST(name) namespace { class QU_UNIQ_ID(QUTest) : public QU_TEST_ANCESTOR {public: QU_UNIQ_ID(QUTest)() : QU_TEST_ANCESTOR(#name) {if (QUTestSuiteTracker::CurrentQUTestSuite()) {QUTestSuiteTracker::CurrentQUTestSuite()->Add(this);}} void Run(void); } static QU_UNIQ_ID(test);} void QU_UNIQ_ID(QUTest)::Run(void)
 
+// A TEST that is too slow if it takes longer than its budget: WALL_MS(ms)
+// on the clock or CPU_MS(ms) of CPU time, including SETUP and TEARDOWN.
+// MUST be on a single line
+#define TEST_WITHIN(name, budget) namespace { class QU_UNIQ_ID(QUTest) : public QU_TEST_ANCESTOR {public: QU_UNIQ_ID(QUTest)() : QU_TEST_ANCESTOR(#name) {if (QUTestSuiteTracker::CurrentQUTestSuite()) {QUTestSuiteTracker::CurrentQUTestSuite()->Add(this);}} void Run(void); quick_unit::QUBudget Budget(void) { return budget; } } static QU_UNIQ_ID(test);} void QU_UNIQ_ID(QUTest)::Run(void)
+
 /******************************************************************************/
 /* Macros for creating a SHOULD message */
-#define QU_SHOULD(msg) QU_STRINGIZE("line ",__LINE__) ": Should "  # msg "."
+#define QU_SHOULD_TEXT(text) QU_STRINGIZE("line ",__LINE__) ": Should " text "."
+#ifdef QU_PROFILE_ASSERTIONS
+ // MUST be on a single line
+ #define QU_SHOULD(msg) ([]() -> const char * { struct Site { static const char *file() { return __FILE__; } static int line() { return __LINE__; } static const char *text() { return QU_SHOULD_TEXT(# msg); } }; return quick_unit::QUAssertionSiteOf<Site>::site.Hit(); }())
+#else
+ #define QU_SHOULD(msg) QU_SHOULD_TEXT(# msg)
+#endif
 #define SHOULD QU_SHOULD
 
 /******************************************************************************/
@@ -513,16 +864,30 @@ public:
 #define BEGIN_SUITE(name) \
 using namespace quick_unit; namespace {\
 class QU_UNIQ_ID(QUSuite) : public QUTestSuite{ public: QU_UNIQ_ID(QUSuite)() : QUTestSuite(#name) {}
+// A suite that is too slow if it takes longer than its budget, from
+// before SETUP_SUITE to after TEARDOWN_SUITE
+#define BEGIN_SUITE_WITHIN(name, budget) BEGIN_SUITE(name) quick_unit::QUBudget Budget(void) { return budget; }
 #define END_SUITE_AS(name) } static name; }
 #define END_SUITE } static QU_UNIQ_ID(QUSuite); }
 #define DECLARE_SUITE(name) BEGIN_SUITE(name) END_SUITE
 
+// A shared value, built by the code that follows on first use, and kept
+// until the suite finishes. One FIXTURE can use another.
+#define FIXTURE(type, name) \
+quick_unit::QULazy<type> QU_TOKEN_MERGE(qu_fixture_, name);\
+type &name() { if (!QU_TOKEN_MERGE(qu_fixture_, name).get()) { double qu_started = SpanStart(QU_SPAN_FIXTURE_SETUP, #name); QU_TOKEN_MERGE(qu_fixture_, name).set(QU_TOKEN_MERGE(qu_build_, name)()); Built(&QU_TOKEN_MERGE(qu_fixture_, name), #name, qu_started); } return *QU_TOKEN_MERGE(qu_fixture_, name).get(); }\
+type *QU_TOKEN_MERGE(qu_build_, name)()
+
 #define SETUP_SUITE void BeforeAllTests()
 #define TEARDOWN_SUITE void AfterAllTests()
 #define SETUP void BeforeEachTest()
 #define TEARDOWN void AfterEachTest()
 
-#define RUN_TESTS() if (QUTestSuiteTracker::CurrentQUTestSuite()) { QUTestSuiteTracker::CurrentQUTestSuite()->RunAll(); }
+#ifdef QU_PROFILE_ASSERTIONS
+ #define RUN_TESTS() quick_unit::QUAssertionSite::Report(quick_unit::QUTestSuiteTracker::CurrentQUTestSuite() ? quick_unit::QUTestSuiteTracker::CurrentQUTestSuite()->RunAll() : 0)
+#else
+ #define RUN_TESTS() (quick_unit::QUTestSuiteTracker::CurrentQUTestSuite() ? quick_unit::QUTestSuiteTracker::CurrentQUTestSuite()->RunAll() : 0)
+#endif
 /******************************************************************************/
 /* Macros for REPORTERs */
 #define TEST_REPORTER(name) \
@@ -534,6 +899,1045 @@ using namespace quick_unit; namespace  { class QU_UNIQ_ID(QUReporter) : public n
 #define BEGIN_REPORTER(name) namespace quick_unit { class name ##Reporter : public QUReporter { public:
 #define END_REPORTER() }; }
 
+#ifdef QU_DEFINE_IMPLEMENTATION
+/******************************************************************************/
+/* Implementation */
+/******************************************************************************/
+QU_INLINE std::ostream &QUStdOutTracker::Output(std::ostream *new_stream) {
+  static std::ostream *current;
+  if (!current) {
+    current = &std::cout;
+  }
+  if (new_stream) {
+    current = new_stream;
+  }
+  return *current;
+}
+
+QU_INLINE char **QUOptionTracker::Argv(char **new_argv) {
+  static char **current;
+  if (new_argv) {
+    current = new_argv;
+  }
+  return current;
+}
+
+QU_INLINE const char *QUOptionTracker::Option(const char *name) {
+  std::string flag = std::string("--") + name;
+  char **argv = Argv();
+  for (int i = 1; argv && argv[i]; i++) {
+    if (strncmp(argv[i], flag.c_str(), flag.length()) == 0) {
+      const char *rest = argv[i] + flag.length();
+      if (*rest == '=') {
+        return rest + 1;
+      }
+      if (*rest == 0) {
+        return rest;
+      }
+    }
+  }
+  std::string env = "QU_";
+  for (const char *c = name; *c; c++) {
+    env += (*c == '-') ? '_' : (char)toupper(*c);
+  }
+  return getenv(env.c_str());
+}
+
+/******************************************************************************/
+struct QUNameTable {
+  struct Entry {
+    std::string name;
+    std::vector<std::string> forms;
+  };
+  std::deque<Entry> entries; // A deque, so names stay put as more are added
+  std::map<std::string, QUNameId> ids;
+  std::vector<std::string (*)(const std::string &)> makers;
+};
+QU_INLINE QUNameTable &QUNamesTable() {
+  static QUNameTable table;
+  return table;
+}
+
+QU_INLINE QUNameId QUNames::Intern(const std::string &name) {
+  QUAssertionLock lock; // Tests can be made on any thread
+  QUNameTable &table = QUNamesTable();
+  std::map<std::string, QUNameId>::iterator found = table.ids.find(name);
+  if (found != table.ids.end()) {
+    return found->second;
+  }
+  QUNameId id = (QUNameId)table.entries.size();
+  table.ids[name] = id;
+  table.entries.push_back(QUNameTable::Entry());
+  table.entries.back().name = name;
+  for (size_t form = 0; form < table.makers.size(); form++) {
+    table.entries.back().forms.push_back(table.makers[form](name));
+  }
+  return id;
+}
+
+QU_INLINE const std::string &QUNames::Name(QUNameId id) {
+  return QUNamesTable().entries[id].name;
+}
+
+QU_INLINE unsigned QUNames::AddForm(std::string (*make)(const std::string &name)) {
+  QUAssertionLock lock;
+  QUNameTable &table = QUNamesTable();
+  table.makers.push_back(make);
+  for (size_t id = 0; id < table.entries.size(); id++) {
+    table.entries[id].forms.push_back(make(table.entries[id].name));
+  }
+  return (unsigned)table.makers.size() - 1;
+}
+
+QU_INLINE const std::string &QUNames::Form(QUNameId id, unsigned form) {
+  return QUNamesTable().entries[id].forms[form];
+}
+
+/******************************************************************************/
+QU_INLINE const char *QUReporter::current_time(void) {
+  time_t szClock;
+  time( &szClock );
+  #ifdef _MSC_VER
+  static char timebuf[26];
+  struct tm newtime;
+  localtime_s(&newtime, &szClock);
+  asctime_s(timebuf, 26, &newtime);
+  return timebuf;
+  #else
+  return asctime(localtime(&szClock));
+  #endif
+}
+
+QU_INLINE double QUReporter::now(void) {
+  #ifdef _WIN32
+  return (double)clock() / CLOCKS_PER_SEC;
+  #else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+  #endif
+}
+
+/******************************************************************************/
+QU_INLINE std::string QUBudget::Overrun(double wall, double cpu_time) const {
+  double taken = cpu ? cpu_time : wall;
+  double scale = Scale();
+  if (milliseconds <= 0 || taken <= milliseconds * scale) {
+    return "";
+  }
+  std::ostringstream text;
+  text.setf(std::ios::fixed);
+  text.precision(1);
+  text << "took " << taken << "ms " << (cpu ? "of CPU time" : "on the clock") << ", over its budget of " << milliseconds << "ms";
+  if (scale != 1) {
+    text << " x " << scale;
+  }
+  return text.str();
+}
+
+QU_INLINE double QUBudget::Scale(void) {
+  const char *option = QUOptionTracker::Option("budget-scale");
+  double scale = option ? strtod(option, NULL) : 1;
+  return scale > 0 ? scale : 1;
+}
+
+/******************************************************************************/
+QU_INLINE void DefaultReporter::StartingSuite(const std::string &suite_name) {
+  Output() << std::endl << "====================================================" << std::endl << "Starting " << suite_name << " at " << QUReporter::current_time() << std::endl;
+}
+QU_INLINE void DefaultReporter::StoppingSuite(const std::string &suite_name, double duration, unsigned passes, unsigned fails) {
+  Output() << std::endl << "----------------------------------------------------" << std::endl << "Finished " << suite_name << " at " << QUReporter::current_time() <<
+    "Passes: " << passes << " Fails: " << fails << std::endl << "----------------------------------------------------" << std::endl;
+}
+QU_INLINE void DefaultReporter::StartingTest(const std::string &suite_name, const std::string &test_name) {
+  Output() << "Test: " << test_name << " => ";
+}
+QU_INLINE void DefaultReporter::FailedTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &fail_message) {
+  Output() << "FAILED. " << fail_message << std::endl;
+}
+QU_INLINE void DefaultReporter::PassedTest(const std::string &suite_name, const std::string &test_name, double duration) {
+  Output() << "OK." << std::endl;
+}
+QU_INLINE void DefaultReporter::TestOutput(const std::string &suite_name, const std::string &test_name, const std::string &text) {
+  Output()
+    << "-- Output --" << std::endl
+    << text
+    << "------------" << std::endl;
+}
+QU_INLINE void DefaultReporter::TestMetric(const std::string &suite_name, const std::string &test_name, const QUMetric &metric) {
+  Output() << "-- Metric: " << metric.name << " = " << metric.value;
+  if (!metric.unit.empty()) {
+    Output() << " " << metric.unit;
+  }
+  if (metric.per_second > 0) {
+    Output() << " (" << metric.per_second << (metric.unit.empty() ? "" : " ") << metric.unit << "/s)";
+  }
+  Output() << std::endl;
+}
+QU_INLINE void DefaultReporter::SlowTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &overrun) {
+  Output() << "TOO SLOW. " << overrun << std::endl;
+}
+QU_INLINE void DefaultReporter::SlowSuite(const std::string &suite_name, double duration, const std::string &overrun) {
+  Output() << "Suite too slow: " << overrun << std::endl;
+}
+
+/******************************************************************************/
+QU_INLINE QUTestSuite *QUTestSuiteTracker::CurrentQUTestSuite(QUTestSuite *cur) {
+  static QUTestSuite *current;
+  if (cur) {
+    QUTestSuite *old_cur = current;
+    current = cur;
+    return old_cur;
+  }
+  return current;
+}
+
+QU_INLINE QUReporter *QUTestSuiteTracker::CurrentQUReporter(QUReporter *cur, bool chain) {
+  static DefaultReporter defaultQUReporter;
+  static QUReporter *current;
+  if (!current) {
+    current = &defaultQUReporter;
+  }
+  if (cur) {
+    if (chain) {
+      cur->chain(current);
+    }
+    current = cur;
+  }
+  return current;
+}
+
+/******************************************************************************/
+QU_INLINE int QUTest::format_arg_list(std::string& out, int length, const char *fmt, va_list args) {
+  if (!fmt) return -1;
+  int result = 0;
+  char *buffer = NULL;
+  buffer = new char [length + 1];
+  memset(buffer, 0, length + 1);
+  #ifdef _MSC_VER
+  result = vsnprintf_s(buffer, length + 1, _TRUNCATE, fmt, args);
+  #else
+  result = vsnprintf(buffer, length, fmt, args);
+  #endif
+  out = buffer;
+  delete [] buffer;
+  return result;
+}
+
+/******************************************************************************/
+#ifdef QU_THREADS
+QU_INLINE std::recursive_mutex &QUAssertionMutex() {
+  static std::recursive_mutex mutex;
+  return mutex;
+}
+QU_INLINE int &QUAssertionDepth() {
+  static thread_local int depth = 0;
+  return depth;
+}
+QU_INLINE QUAssertionLock::QUAssertionLock() { QUAssertionMutex().lock(); QUAssertionDepth()++; }
+QU_INLINE QUAssertionLock::~QUAssertionLock() { QUAssertionDepth()--; QUAssertionMutex().unlock(); }
+QU_INLINE void QUAssertionLock::ReleaseAll() {
+  for (; QUAssertionDepth() > 0; QUAssertionDepth()--) {
+    QUAssertionMutex().unlock();
+  }
+}
+QU_INLINE bool &QUAssertionLock::ThrowsFailures() {
+  static thread_local bool throws = false;
+  return throws;
+}
+QU_INLINE std::string &QUAssertionLock::ThreadName() {
+  static thread_local std::string name;
+  return name;
+}
+#else
+QU_INLINE QUAssertionLock::QUAssertionLock() {}
+QU_INLINE QUAssertionLock::~QUAssertionLock() {}
+QU_INLINE void QUAssertionLock::ReleaseAll() {}
+QU_INLINE bool &QUAssertionLock::ThrowsFailures() {
+  static bool throws = true;
+  return throws;
+}
+QU_INLINE std::string &QUAssertionLock::ThreadName() {
+  static std::string name;
+  return name;
+}
+#endif
+
+/******************************************************************************/
+#ifdef QU_NO_EXCEPTIONS
+QU_INLINE jmp_buf *&QUTestFail::Landing(void) {
+  #ifdef QU_THREADS
+  static thread_local jmp_buf *landing = NULL;
+  #else
+  static jmp_buf *landing = NULL;
+  #endif
+  return landing;
+}
+
+QU_INLINE bool QUTestFail::Catch(void (*body)(void *), void *context) {
+  jmp_buf here;
+  jmp_buf *outer = Landing();
+  Landing() = &here;
+  if (setjmp(here)) {
+    Landing() = outer;
+    return true;
+  }
+  body(context);
+  Landing() = outer;
+  return false;
+}
+
+QU_INLINE void QUTestFail::Raise(void) {
+  QUAssertionLock::ReleaseAll();
+  if (!Landing()) {
+    fprintf(stderr, "quick_unit: a test failed outside QUTestFail::Catch()\n");
+    abort();
+  }
+  longjmp(*Landing(), 1);
+}
+#else
+QU_INLINE bool QUTestFail::Catch(void (*body)(void *), void *context) {
+  try {
+    body(context);
+  } catch(QUTestFail * /*err*/) {
+    return true;
+  }
+  return false;
+}
+
+QU_INLINE void QUTestFail::Raise(void) {
+  throw new QUTestFail();
+}
+#endif
+
+#ifdef QU_PROFILE_ASSERTIONS
+/******************************************************************************/
+QU_INLINE QUAssertionSite::QUAssertionSite(const char *site_file, int site_line, const char *site_text)
+  : file(site_file), line(site_line), text(site_text) {
+  _counts = NewCounts();
+  _next = Head();
+  Head() = this;
+  Texts()[text] = this;
+}
+
+// Counts are given out from shared pages, so a forked child adds to the
+// counts of the sites the parent has. SHOULD(...) sites are all made as the
+// program starts, but a line site is made as it is first hit, and one made
+// in a child is lost with it.
+QU_INLINE QUAssertionSite::Counts *QUAssertionSite::NewCounts(void) {
+  static Counts *page = NULL;
+  static size_t used = 0;
+  const size_t per_page = 4096 / sizeof(Counts);
+  if (!page || used == per_page) {
+    #ifdef QU_FORK_TESTS
+    void *shared = mmap(NULL, per_page * sizeof(Counts), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    page = (shared != MAP_FAILED) ? (Counts *)shared : new Counts[per_page];
+    #else
+    page = new Counts[per_page];
+    #endif
+    used = 0;
+  }
+  Counts *counts = &page[used++];
+  counts->count = 0;
+  counts->fails = 0;
+  counts->nanoseconds = 0;
+  return counts;
+}
+
+// Called with the assertion lock held
+QU_INLINE void QUAssertionSite::Recorded(const char *msg, bool pass, const QUCaller &caller) {
+  Pending &pending = ThisThread();
+  QUAssertionSite *site = pending.site;
+  pending.site = NULL;
+  // Unless the SHOULD(...) was worked out for some other assertion
+  bool should = site && msg == site->text;
+  if (!should) {
+    // An assertion made in this one's arguments took its place as pending,
+    // but its SHOULD(...) has already counted it. Otherwise it has none.
+    std::map<const char *, QUAssertionSite *>::iterator labelled = Texts().find(msg);
+    if (labelled != Texts().end()) {
+      site = labelled->second;
+    } else if (caller.file) {
+      site = At(caller);
+      site->_counts->count.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      return;
+    }
+  }
+  if (!pass) {
+    site->_counts->fails.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (should && Timing()) {
+    std::chrono::steady_clock::duration taken = std::chrono::steady_clock::now() - pending.start;
+    site->_counts->nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(taken).count(), std::memory_order_relaxed);
+  }
+}
+
+// The site of the assertions made on a line without a SHOULD(...), made
+// when the first of them is recorded
+QU_INLINE QUAssertionSite *QUAssertionSite::At(const QUCaller &caller) {
+  static std::map<std::pair<std::string, int>, QUAssertionSite *> sites;
+  static std::deque<std::string> labels; // A deque, so the texts stay put
+  QUAssertionSite *&site = sites[std::make_pair(std::string(caller.file), caller.line)];
+  if (!site) {
+    std::ostringstream label;
+    label << "line " << caller.line;
+    labels.push_back(label.str());
+    site = new QUAssertionSite(caller.file, caller.line, labels.back().c_str());
+  }
+  return site;
+}
+
+// The busiest sites (by time with --assertion-timing, else by count) and
+// those that never ran go to the output, up to --assertion-sites of each
+// (default 20). --assertion-profile=<file> writes every site as CSV.
+QU_INLINE int QUAssertionSite::Report(int fails) {
+  std::vector<QUAssertionSite *> ran, never;
+  for (QUAssertionSite *site = First(); site; site = site->next()) {
+    (site->count() ? ran : never).push_back(site);
+  }
+  bool timing = Timing();
+  std::stable_sort(ran.begin(), ran.end(), [timing](QUAssertionSite *a, QUAssertionSite *b) {
+    return timing ? a->nanoseconds() > b->nanoseconds() : a->count() > b->count();
+  });
+  std::stable_sort(never.begin(), never.end(), [](QUAssertionSite *a, QUAssertionSite *b) {
+    int order = strcmp(a->file, b->file);
+    return order < 0 || (order == 0 && a->line < b->line);
+  });
+  const char *option = QUOptionTracker::Option("assertion-sites");
+  size_t shown = (option && *option) ? strtoul(option, NULL, 10) : 20;
+
+  std::ostream &out = QUStdOutTracker::Output();
+  out << std::endl << "====================================================" << std::endl;
+  out << "Assertion sites: " << ran.size() + never.size() << " (" << never.size() << " never run)" << std::endl;
+  out << std::setw(12) << "Count" << std::setw(8) << "Fails" << (timing ? "    Time (us)" : "") << "  Site" << std::endl;
+  for (size_t i = 0; i < ran.size() && i < shown; i++) {
+    out << std::setw(12) << ran[i]->count() << std::setw(8) << ran[i]->fails();
+    if (timing) {
+      std::ostringstream micros;
+      micros << std::fixed << std::setprecision(1) << ran[i]->nanoseconds() / 1000.0;
+      out << std::setw(13) << micros.str();
+    }
+    out << "  " << ran[i]->file << " " << ran[i]->text << std::endl;
+  }
+  if (ran.size() > shown) {
+    out << "... and " << ran.size() - shown << " more" << std::endl;
+  }
+  if (!never.empty()) {
+    out << "Never run:" << std::endl;
+    for (size_t i = 0; i < never.size() && i < shown; i++) {
+      out << "  " << never[i]->file << " " << never[i]->text << std::endl;
+    }
+    if (never.size() > shown) {
+      out << "... and " << never.size() - shown << " more" << std::endl;
+    }
+  }
+  if (QUOptionTracker::Option("fork")) {
+    out << "With --fork, lines without a SHOULD(...) first reached in a child are not counted" << std::endl;
+  }
+  out << "----------------------------------------------------" << std::endl;
+
+  const char *path = QUOptionTracker::Option("assertion-profile");
+  if (path && *path) {
+    std::ofstream csv(path);
+    csv << "file,line,count,fails,nanoseconds,should" << std::endl;
+    ran.insert(ran.end(), never.begin(), never.end());
+    for (size_t i = 0; i < ran.size(); i++) {
+      std::string should = ran[i]->text;
+      for (size_t quote = should.find('"'); quote != std::string::npos; quote = should.find('"', quote + 2)) {
+        should.insert(quote, 1, '"');
+      }
+      csv << '"' << ran[i]->file << "\"," << ran[i]->line << ',' << ran[i]->count() << ',' << ran[i]->fails() << ','
+          << ran[i]->nanoseconds() << ",\"" << should << '"' << std::endl;
+    }
+  }
+  return fails;
+}
+#endif
+
+/******************************************************************************/
+QU_INLINE void QUTest::Reset() {
+  _fails = 0;
+  _passes = 0;
+  _assertions = 0;
+  _fail_message = "";
+   _info_message.str("");
+  _metrics.clear();
+}
+
+QU_INLINE int QUTest::fails() {
+  if (_passes + _fails == 0) {
+    return 1; // No asserts - not a valid test. Report as a fail
+  }
+  return _fails;
+}
+
+QU_INLINE const std::string &QUTest::fail_message() {
+  if (_passes + _fails == 0) {
+    _full_message = "No assertions were executed/completed";
+  } else {
+    _full_message = _fail_message + _info_message.str();
+  }
+  return _full_message;
+}
+
+QU_INLINE void QUTest::force_fail_message(const char *forced_message) {
+  std::ostringstream os;
+  os << forced_message << " Completed assertions:" << _assertions;
+  _fail_message = os.str();
+  _fails++;
+}
+
+QU_INLINE const std::string &QUTest::test_output_text() {_output_message = _output.str(); _output.seekp(0, std::ios::beg); return _output_message;}
+
+QU_INLINE int QUTest::printf(const char* fmt, ...) {
+  int count = 0;
+  va_list args;
+  va_start(args, fmt);
+  std::string s;
+  int length = 256;
+  int result = format_arg_list(s, length, fmt, args);
+  count += result;
+  va_end(args);
+  if (result >= 256) {
+    va_start(args, fmt);
+    format_arg_list(s, result + 1, fmt, args);
+    va_end(args);
+  }
+  QUAssertionLock lock;
+  _output << s;
+  return count;
+}
+
+QU_INLINE void QUTest::record_metric(const char *name, double value, const char *unit, bool rate) {
+  QUAssertionLock lock;
+  _metrics.push_back(QUMetric(name, value, unit ? unit : "", rate));
+}
+
+// Result matcher: truth
+QU_INLINE ADD_MATCHER(QUTest::is_true, bool truth) {
+  MATCHER(truth, " (Expected result was not true)");
+}
+// Result matcher: falsity
+QU_INLINE ADD_MATCHER(QUTest::is_false, bool truth) {
+  MATCHER(!truth, " (Expected result was not false)");
+}
+// Result matchers: Equality
+QU_INLINE ADD_MATCHER(QUTest::equal, const char *a, const char *b) {
+  MATCHER((strcmp(a,b) == 0), " (Expected: " << a << ", got: " << b << ")");
+}
+// Result matchers: Inequality
+QU_INLINE ADD_MATCHER(QUTest::not_equal, const char *a, const char *b) {
+  MATCHER((strcmp(a,b) != 0), " (Expected difference. Both: " << a << ")");
+}
+// Result matcher: inclusion/exclusion
+QU_INLINE ADD_MATCHER(QUTest::includes, const char *inclusion, const char *text) {
+  MATCHER((strstr(text, inclusion) != NULL), " (Expected to see '" << inclusion << "' in '"<< text << "')");
+}
+QU_INLINE ADD_MATCHER(QUTest::excludes, const char *inclusion, const char *text) {
+  MATCHER((strstr(text, inclusion) == NULL), " (Expected not to see '" << inclusion << "' in '"<< text << "')");
+}
+
+// The core assertion handler
+#ifdef QU_PROFILE_ASSERTIONS
+QU_INLINE bool QUTest::_record(const Qu_Result &result, const char *msg) {
+  return _record(result, msg, QUCaller());
+}
+QU_INLINE bool QUTest::_record(const Qu_Result &result, const char *msg, const QUCaller &caller) {
+#else
+QU_INLINE bool QUTest::_record(const Qu_Result &result, const char *msg) {
+#endif
+  QUAssertionLock lock;
+  _assertions++;
+  #ifdef QU_PROFILE_ASSERTIONS
+  QUAssertionSite::Recorded(msg, result.pass, caller);
+  #endif
+  if (result.pass) {
+    if (!_fails) {
+      _info_message.str("");
+    }
+    _passes++;
+  } else {
+    if (!_fails) { // Keep the first failure, if a thread has already failed
+      _info_message << result.msg;
+      if (msg) {
+        _fail_message = msg;
+      } else {
+        std::ostringstream os;
+        os << "assertion #" << _assertions;
+        _fail_message = os.str();
+      }
+      if (!QUAssertionLock::ThreadName().empty()) {
+        _info_message << " (in " << QUAssertionLock::ThreadName() << ")";
+      } else if (!QUAssertionLock::ThrowsFailures()) {
+        _info_message << " (in a thread started by the test)";
+      }
+    }
+    _fails++;
+    return QUAssertionLock::ThrowsFailures();
+  }
+  return false;
+}
+
+QU_INLINE void QUTest::_assert(Qu_Result result, const char *msg) {
+  if (_record(result, msg)) {
+    QUTestFail::Raise();
+  }
+}
+
+/******************************************************************************/
+QU_INLINE QUTestSuite::QUTestSuite(const char *msg) {
+  _suite_name = msg;
+  _suite_id = QUNames::Intern(_suite_name);
+  _first_test = NULL;
+  _last_test = NULL;
+  _reporter = QUTestSuiteTracker::CurrentQUReporter();
+  _reporters = NULL;
+  _reporter_count = 0;
+  _spans = false;
+  _thread_names = false;
+  _runner_name[0] = 0;
+  _chain = QUTestSuiteTracker::CurrentQUTestSuite(this);
+  _built = NULL;
+}
+
+QU_INLINE void QUTestSuite::Add(QUTest *test) {
+  if (_last_test) {
+    _last_test->_next_test = test;
+  } else {
+    _first_test = test;
+  }
+  _last_test = test;
+}
+
+QU_INLINE void QUTestSuite::Built(QUFixture *fixture) {
+  fixture->_next_built = _built;
+  _built = fixture;
+}
+
+QU_INLINE void QUTestSuite::Built(QUFixture *fixture, const char *name, double started) {
+  Built(fixture);
+  if (_spans) {
+    fixture->_name_id = QUNames::Intern(name);
+    fixture->_named = true;
+    Span(QU_SPAN_FIXTURE_SETUP, fixture->_name_id, started);
+  }
+}
+
+QU_INLINE void QUTestSuite::ReleaseFixtures(QUFixture *kept) {
+  // Newest first, so a fixture goes before the fixtures it was built from
+  while (_built && _built != kept) {
+    QUFixture *fixture = _built;
+    _built = fixture->_next_built;
+    fixture->_next_built = NULL;
+    double started = fixture->_named ? SpanStart(QU_SPAN_FIXTURE_TEARDOWN, fixture->_name_id) : 0;
+    fixture->Release();
+    if (fixture->_named) {
+      Span(QU_SPAN_FIXTURE_TEARDOWN, fixture->_name_id, started);
+    }
+  }
+}
+
+QU_INLINE double QUTestSuite::SpanStart(QUSpanKind kind, QUNameId name, unsigned lane) {
+  if (!_spans) {
+    return 0;
+  }
+  for (size_t index = 0; index < _reporter_count; index++) {
+    _reporters[index]->StartingSpanById(kind, _suite_id, name, lane);
+  }
+  return QUReporter::now();
+}
+
+QU_INLINE double QUTestSuite::SpanStart(QUSpanKind kind, const char *name) {
+  return _spans ? SpanStart(kind, QUNames::Intern(name)) : 0;
+}
+
+QU_INLINE void QUTestSuite::Span(QUSpanKind kind, QUNameId name, double start, unsigned lane) {
+  if (_spans) {
+    double end = QUReporter::now();
+    for (size_t index = 0; index < _reporter_count; index++) {
+      _reporters[index]->SpanById(kind, _suite_id, name, start, end, lane);
+    }
+  }
+}
+
+QU_INLINE void QUTestSuite::Counter(const char *counter, double value) {
+  if (_spans) {
+    for (size_t index = 0; index < _reporter_count; index++) {
+      _reporters[index]->CounterById(_suite_id, counter, value);
+    }
+  }
+}
+
+QU_INLINE bool QUTestSuite::Selected(const std::string &test_name) {
+  const char *filter = QUOptionTracker::Option("filter");
+  if (!filter || !*filter) {
+    return true;
+  }
+  std::string full_name = _suite_name + "/" + test_name;
+  bool included = false;
+  bool any_includes = false;
+  std::string patterns(filter);
+  size_t start = 0;
+  while (start <= patterns.size()) {
+    size_t end = patterns.find(',', start);
+    if (end == std::string::npos) {
+      end = patterns.size();
+    }
+    std::string pattern = patterns.substr(start, end - start);
+    start = end + 1;
+    bool exclude = !pattern.empty() && pattern[0] == '-';
+    if (exclude) {
+      pattern.erase(0, 1);
+    }
+    if (pattern.empty()) {
+      continue;
+    }
+    bool found = full_name.find(pattern) != std::string::npos;
+    if (exclude && found) {
+      return false;
+    }
+    if (!exclude) {
+      any_includes = true;
+      included = included || found;
+    }
+  }
+  return included || !any_includes;
+}
+
+QU_INLINE void QUTestGroup::Before(QUTestSuite &suite) {
+  suite.BeforeEachTest();
+}
+
+QU_INLINE void QUTestGroup::After(QUTestSuite &suite) {
+  suite.AfterEachTest();
+}
+
+QU_INLINE double QUTestGroup::SpanStart(QUTestSuite &suite, QUTest *test, unsigned lane) {
+  suite.MarkStart(test, lane);
+  return suite.SpanStart(QU_SPAN_TEST, test->test_id(), lane);
+}
+
+QU_INLINE void QUTestGroup::Span(QUTestSuite &suite, QUTest *test, double start, unsigned lane) {
+  suite.Span(QU_SPAN_TEST, test->test_id(), start, lane);
+  suite.MarkEnd(test, test->fails(), lane);
+}
+
+QU_INLINE void QUTestGroup::Counter(QUTestSuite &suite, const char *counter, double value) {
+  suite.Counter(counter, value);
+}
+
+QU_INLINE bool QUTestSuite::RunBody(QUTest *test) {
+  QUAssertionLock::ThrowsFailures() = true;
+  #ifdef QU_NO_EXCEPTIONS
+  test->Reset();
+  return QUTestFail::Catch(RunTest, test);
+  #else
+  try {
+    test->Reset();
+    test->Run();
+  } catch(QUTestFail * /*err*/) {
+    // Failed assertions cause us to come here
+    return true;
+  } catch(...) {
+    test->force_fail_message("unexpected exception in the test");
+    return true;
+  }
+  return false;
+  #endif
+}
+
+QU_INLINE void QUTestSuite::MarkStart(QUTest *test, unsigned lane) {
+  QU_PROBE2(test__start, _suite_name.c_str(), test->test_name().c_str());
+  #ifdef __linux__
+  if (_thread_names && !lane) {
+    prctl(PR_SET_NAME, test->test_name().c_str(), 0, 0, 0);
+  }
+  #endif
+}
+
+QU_INLINE void QUTestSuite::MarkEnd(QUTest *test, bool failed, unsigned lane) {
+  QU_PROBE3(test__done, _suite_name.c_str(), test->test_name().c_str(), failed);
+  #ifdef __linux__
+  if (_thread_names && !lane) {
+    prctl(PR_SET_NAME, _runner_name, 0, 0, 0);
+  }
+  #endif
+}
+
+QU_INLINE void QUTestSuite::RunHere(QUTest *test, QUTestOutcome &outcome, bool reported) {
+  clock_t test_start = clock();
+  double wall_start = QUReporter::now();
+  MarkStart(test);
+  double started = SpanStart(QU_SPAN_TEST, test->test_id());
+  double setup_started = SpanStart(QU_SPAN_TEST_SETUP, test->test_id());
+  BeforeEachTest();
+  Span(QU_SPAN_TEST_SETUP, test->test_id(), setup_started);
+  for (size_t index = 0; reported && index < _reporter_count; index++) {
+    _reporters[index]->StartedTestById(_suite_id, test->test_id());
+  }
+  bool failed = RunBody(test);
+  for (size_t index = _reporter_count; reported && index-- > 0; ) {
+    _reporters[index]->StoppingTestById(_suite_id, test->test_id());
+  }
+  double stopping = SpanStart(QU_SPAN_TEST_TEARDOWN, test->test_id());
+  AfterEachTest();
+  Span(QU_SPAN_TEST_TEARDOWN, test->test_id(), stopping);
+  Span(QU_SPAN_TEST, test->test_id(), started);
+  outcome.duration = (clock() - test_start) * 1000.0 / CLOCKS_PER_SEC;
+  outcome.wall = (QUReporter::now() - wall_start) * 1000.0;
+  outcome.failed = failed || test->fails();
+  MarkEnd(test, outcome.failed);
+  outcome.fail_message = outcome.failed ? test->fail_message() : "";
+  outcome.output = test->test_output_text();
+  outcome.metrics = test->metrics();
+}
+
+QU_INLINE void QUTestSuite::RunForked(QUTest **tests, size_t count, QUTestOutcome *outcomes) {
+  #ifdef QU_FORK_TESTS
+  // Each test gets a slot in memory shared with the child: this header,
+  // then its fail message, its metrics as "name\tunit\tvalue rate\n" lines, and
+  // its output text
+  struct Slot {
+    volatile int state;
+    int failed;
+    int cut;      // The text did not all fit
+    double duration;
+    double wall;
+    size_t message_length;
+    size_t metrics_length;
+    size_t output_length;
+  };
+  enum { waiting, running, finished };
+  const size_t text_space = QU_FORK_RESULT_BYTES - sizeof(Slot);
+  char *shared = (char *)mmap(NULL, count * QU_FORK_RESULT_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  size_t next = 0;
+  while (shared != MAP_FAILED && next < count) {
+    fflush(NULL); // Or the child writes out the parent's buffered text too
+    QUStdOutTracker::Output().flush();
+    pid_t child = fork();
+    if (child == 0) {
+      QUFixture *inherited = _built; // The parent releases these itself
+      for (size_t i = next; i < count; i++) {
+        Slot *slot = (Slot *)(shared + i * QU_FORK_RESULT_BYTES);
+        char *text = (char *)(slot + 1);
+        slot->state = running;
+        QUTestOutcome outcome;
+        RunHere(tests[i], outcome);
+        std::ostringstream metrics;
+        metrics.precision(17);
+        for (size_t m = 0; m < outcome.metrics.size(); m++) {
+          metrics << outcome.metrics[m].name << '\t' << outcome.metrics[m].unit << '\t' << outcome.metrics[m].value << ' ' << outcome.metrics[m].rate << '\n';
+        }
+        std::string metrics_text = metrics.str();
+        slot->failed = outcome.failed;
+        slot->duration = outcome.duration;
+        slot->wall = outcome.wall;
+        slot->message_length = outcome.fail_message.copy(text, text_space);
+        slot->metrics_length = metrics_text.copy(text + slot->message_length, text_space - slot->message_length);
+        size_t used = slot->message_length + slot->metrics_length;
+        slot->output_length = outcome.output.copy(text + used, text_space - used);
+        slot->cut = used + slot->output_length < outcome.fail_message.length() + metrics_text.length() + outcome.output.length();
+        slot->state = finished;
+      }
+      ReleaseFixtures(inherited); // Those built by the tests would be lost with the child
+      fflush(NULL);
+      QUStdOutTracker::Output().flush();
+      _exit(0);
+    }
+    int status = 0;
+    if (child < 0 || waitpid(child, &status, 0) < 0) {
+      break;
+    }
+    for (; next < count; next++) {
+      Slot *slot = (Slot *)(shared + next * QU_FORK_RESULT_BYTES);
+      const char *text = (const char *)(slot + 1);
+      if (slot->state != finished) {
+        // The child died in this test, or before it
+        std::ostringstream death;
+        if (WIFSIGNALED(status)) {
+          death << "test process was killed by signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+        } else {
+          death << "test process exited with status " << WEXITSTATUS(status);
+        }
+        outcomes[next].failed = true;
+        outcomes[next].fail_message = death.str();
+        next++;
+        break;
+      }
+      outcomes[next].failed = slot->failed != 0;
+      outcomes[next].duration = slot->duration;
+      outcomes[next].wall = slot->wall;
+      outcomes[next].fail_message.assign(text, slot->message_length);
+      std::istringstream metrics(std::string(text + slot->message_length, slot->metrics_length));
+      std::string name, unit;
+      double value;
+      bool rate;
+      while (std::getline(metrics, name, '\t') && std::getline(metrics, unit, '\t') && metrics >> value >> rate && metrics.get() == '\n') {
+        outcomes[next].metrics.push_back(QUMetric(name, value, unit, rate));
+      }
+      outcomes[next].output.assign(text + slot->message_length + slot->metrics_length, slot->output_length);
+      if (slot->cut) {
+        outcomes[next].output += "\n... (cut short at QU_FORK_RESULT_BYTES)";
+      }
+    }
+  }
+  if (shared != MAP_FAILED) {
+    munmap(shared, count * QU_FORK_RESULT_BYTES);
+  } else {
+    next = 0;
+  }
+  #else
+  size_t next = 0;
+  #endif
+  for (; next < count; next++) {
+    RunHere(tests[next], outcomes[next]);
+  }
+}
+
+QU_INLINE int QUTestSuite::RunAll(void) {
+  unsigned total_fails = 0;
+  if (_chain) {
+    total_fails += _chain->RunAll();
+  }
+  // A suite whose tests are all filtered out is not set up at all
+  std::vector<QUTest *> selected;
+  for (QUTest *test = _first_test; test; test = test->_next_test) {
+    if (Selected(test->test_name())) {
+      selected.push_back(test);
+    }
+  }
+  if (selected.empty() && _first_test) {
+    return total_fails;
+  }
+  if (!_reporters) {
+    // A reporter's chain is set when it is made, so this list stays good
+    for (QUReporter *r = _reporter; r; r = r->chain()) {
+      _reporter_count++;
+    }
+    _reporters = new QUReporter *[_reporter_count + 1];
+    _reporter_count = 0;
+    for (QUReporter *r = _reporter; r; r = r->chain()) {
+      _reporters[_reporter_count++] = r;
+      _spans = _spans || r->WantsSpans();
+    }
+  }
+  #ifdef __linux__
+  _thread_names = QUOptionTracker::Option("thread-names") != NULL;
+  if (_thread_names) {
+    prctl(PR_GET_NAME, _runner_name, 0, 0, 0);
+  }
+  #endif
+  unsigned passes = 0;
+  unsigned fails = 0;
+  clock_t suite_start = clock();
+  double suite_wall_start = QUReporter::now();
+  QU_PROBE1(suite__start, _suite_name.c_str());
+  double suite_started = SpanStart(QU_SPAN_SUITE, _suite_id);
+
+  #define EACH_QUREPORTER(op) for (size_t qfindex = 0; qfindex < _reporter_count; qfindex++) {_reporters[qfindex]->op; }
+  #define EACH_QUREPORTER_REVERSE(op) for (size_t qrindex = _reporter_count; qrindex-- > 0; ) {_reporters[qrindex]->op; }
+  EACH_QUREPORTER(StartingSuiteById(_suite_id))
+  double setup_started = SpanStart(QU_SPAN_SUITE_SETUP, _suite_id);
+  BeforeAllTests();
+  Span(QU_SPAN_SUITE_SETUP, _suite_id, setup_started);
+  EACH_QUREPORTER(StartedSuiteById(_suite_id))
+  // Tests in a group (such as ASYNC_TESTs) run together first, and are
+  // reported in their turn
+  std::vector<QUTestOutcome> outcomes(selected.size());
+  std::vector<char> ready(selected.size(), 0);
+  for (size_t index = 0; index < selected.size(); index++) {
+    QUTestGroup *group = selected[index]->Group();
+    if (group && !ready[index]) {
+      std::vector<QUTest *> members;
+      std::vector<size_t> places;
+      for (size_t other = index; other < selected.size(); other++) {
+        if (selected[other]->Group() == group) {
+          members.push_back(selected[other]);
+          places.push_back(other);
+        }
+      }
+      std::vector<QUTestOutcome> results(members.size());
+      group->RunTogether(*this, &members[0], members.size(), &results[0]);
+      for (size_t member = 0; member < members.size(); member++) {
+        outcomes[places[member]] = results[member];
+        ready[places[member]] = 1;
+      }
+    }
+  }
+  // With --fork (or --fork=<tests per child>) tests run in forked children
+  const char *fork_option = QUOptionTracker::Option("fork");
+  size_t batch = fork_option ? (*fork_option ? strtoul(fork_option, NULL, 10) : 1) : 0;
+  for (size_t index = 0; index < selected.size(); index++) {
+    QUTest *test = selected[index];
+    QUNameId test_id = test->test_id();
+    Counter("tests waiting", (double)(selected.size() - index - 1));
+    if (batch && !ready[index]) {
+      size_t count = 0;
+      while (count < batch && index + count < selected.size() && !ready[index + count]) {
+        count++;
+      }
+      RunForked(&selected[index], count, &outcomes[index]);
+      for (size_t forked = index; forked < index + count; forked++) {
+        ready[forked] = 1;
+      }
+    }
+    EACH_QUREPORTER(StartingTestById(_suite_id, test_id))
+    QUTestOutcome outcome;
+    if (ready[index]) {
+      outcome = outcomes[index];
+      EACH_QUREPORTER(StartedTestById(_suite_id, test_id))
+      EACH_QUREPORTER_REVERSE(StoppingTestById(_suite_id, test_id))
+    } else {
+      RunHere(test, outcome, true);
+    }
+    double duration = outcome.duration;
+    double reporting_started = SpanStart(QU_SPAN_REPORTING, test_id);
+    // A test that passed can still be too slow
+    std::string overrun = outcome.failed ? "" : test->Budget().Overrun(outcome.wall, duration);
+    if (outcome.failed) {
+      fails++;
+      total_fails++;
+      EACH_QUREPORTER_REVERSE(FailedTestById(_suite_id, test_id, duration, outcome.fail_message))
+    } else if (!overrun.empty()) {
+      fails++;
+      total_fails++;
+      EACH_QUREPORTER_REVERSE(SlowTestById(_suite_id, test_id, duration, overrun))
+    } else {
+      passes++;
+      EACH_QUREPORTER_REVERSE(PassedTestById(_suite_id, test_id, duration))
+    }
+    if (!outcome.output.empty()) {
+      EACH_QUREPORTER_REVERSE(TestOutputById(_suite_id, test_id, outcome.output))
+    }
+    for (size_t m = 0; m < outcome.metrics.size(); m++) {
+      QUMetric &metric = outcome.metrics[m];
+      metric.per_second = (metric.rate && outcome.wall > 0) ? metric.value * 1000.0 / outcome.wall : 0;
+      EACH_QUREPORTER_REVERSE(TestMetricById(_suite_id, test_id, metric))
+    }
+    EACH_QUREPORTER_REVERSE(CompletedTestById(_suite_id, test_id, duration))
+    Span(QU_SPAN_REPORTING, test_id, reporting_started);
+  }
+  Counter("tests waiting", 0);
+  EACH_QUREPORTER_REVERSE(StoppingSuiteById(_suite_id, (clock() - suite_start) * 1000.0 / CLOCKS_PER_SEC, passes, fails))
+  double teardown_started = SpanStart(QU_SPAN_SUITE_TEARDOWN, _suite_id);
+  AfterAllTests();
+  ReleaseFixtures();
+  Span(QU_SPAN_SUITE_TEARDOWN, _suite_id, teardown_started);
+  Span(QU_SPAN_SUITE, _suite_id, suite_started);
+  QU_PROBE3(suite__done, _suite_name.c_str(), passes, fails);
+  double suite_duration = (clock() - suite_start) * 1000.0 / CLOCKS_PER_SEC;
+  std::string overrun = Budget().Overrun((QUReporter::now() - suite_wall_start) * 1000.0, suite_duration);
+  if (!overrun.empty()) {
+    // Counts against the run, though each test kept its own result
+    total_fails++;
+    EACH_QUREPORTER_REVERSE(SlowSuiteById(_suite_id, suite_duration, overrun))
+  }
+  EACH_QUREPORTER_REVERSE(CompletedSuiteById(_suite_id, suite_duration, passes, fails))
+  return total_fails;
+}
+#endif /* QU_DEFINE_IMPLEMENTATION */
+
 } /* namespace */
 TEST_REPORTER(Default)
 
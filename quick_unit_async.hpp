@@ -0,0 +1,444 @@
+/*
+ * quick_unit_async.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit adds ASYNC_TEST, a test whose body is a C++20
+ *  coroutine. It can co_await timers, file descriptors and futures, which
+ *  are waited for on an epoll event loop run by the test runner. It needs
+ *  C++20 and Linux.
+ *
+ * ASYNC_TEST(The server answers a ping) {
+ *   int fd = connect_to_server();
+ *   co_await writable(fd);
+ *   write(fd, "ping\n", 5);
+ *   co_await readable(fd);
+ *   assert_equal("pong\n", read_text(fd).c_str(), SHOULD(answer));
+ * }
+ *
+ * ASYNC_TEST(The report is ready within a second) {
+ *   std::future<Report> report = std::async(std::launch::async, make_report);
+ *   co_await sleep_for(std::chrono::seconds(1));
+ *   Report ready = co_await when_ready(report);
+ *   assert(ready.complete(), SHOULD(be complete));
+ * }
+ *
+ * The ASYNC_TESTs of a suite all start before any of the suite's other
+ * tests, one after another, and then run on one thread: while one waits the
+ * others carry on. So hundreds of tests that each sleep for a second take a
+ * second between them. Each is still reported on its own, in its place in
+ * the suite. SETUP runs as each one starts and TEARDOWN as it finishes.
+ *
+ * A body that has nothing to wait for must still contain a co_return. Other
+ * coroutines that return QUTask<T> can be awaited from a body, to share code
+ * between tests. An ASYNC_TEST that has not finished after 60 seconds fails
+ * (set --async-timeout=<seconds>, or environment variable QU_ASYNC_TIMEOUT).
+ */
+
+#ifndef QUICK_UNIT_ASYNC_HPP
+#define	QUICK_UNIT_ASYNC_HPP
+
+#if !defined(__cpp_impl_coroutine) || !defined(__linux__)
+ #error quick_unit_async.hpp needs C++20 and Linux
+#endif
+#ifdef QU_NO_EXCEPTIONS
+ #error quick_unit_async.hpp needs exceptions, to carry failures out of coroutines
+#endif
+
+#include <coroutine>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <optional>
+#include <queue>
+#include <vector>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace quick_unit {
+
+typedef std::chrono::steady_clock QUClock;
+
+/******************************************************************************/
+class QUEventLoop {  // Resumes coroutines when what they wait for is ready
+/******************************************************************************/
+public:
+  // The loop that the test runner runs ASYNC_TESTs on
+  static QUEventLoop &Runner() {
+    static thread_local QUEventLoop loop;
+    return loop;
+  }
+
+  QUEventLoop() : _epoll(epoll_create1(EPOLL_CLOEXEC)), _sequence(0) {}
+  ~QUEventLoop() {
+    if (_epoll >= 0) {
+      close(_epoll);
+    }
+  }
+  QUEventLoop(const QUEventLoop &) = delete;
+  QUEventLoop &operator=(const QUEventLoop &) = delete;
+
+  void Soon(std::coroutine_handle<> waiter) { _ready.push_back(waiter); }
+  void At(QUClock::time_point when, std::coroutine_handle<> waiter) {
+    _timers.push(Timer{when, _sequence++, waiter});
+  }
+  // Waits for fd to be readable (or writable). One coroutine at a time can
+  // wait for each.
+  void WhenReady(int fd, bool write, std::coroutine_handle<> waiter) {
+    bool known = _watched.count(fd) != 0;
+    Watch &watch = _watched[fd];
+    (write ? watch.writer : watch.reader) = waiter;
+    if (!Rearm(fd, known)) {
+      // epoll cannot wait for this fd (a plain file, say), which is as
+      // ready as it will ever be
+      (write ? watch.writer : watch.reader) = nullptr;
+      if (!known) {
+        _watched.erase(fd);
+      }
+      Soon(waiter);
+    }
+  }
+  // Polled between waits, for things with no fd to wait on
+  void WhenTrue(std::function<bool()> ready, std::coroutine_handle<> waiter) {
+    _polls.push_back(std::make_pair(ready, waiter));
+  }
+
+  // Waits (until limit at the latest) for something to be ready, and
+  // resumes whatever is
+  void RunOnce(QUClock::time_point limit) {
+    QUClock::time_point until = limit;
+    if (!_timers.empty() && _timers.top().when < until) {
+      until = _timers.top().when;
+    }
+    if (!_polls.empty() && QUClock::now() + std::chrono::milliseconds(1) < until) {
+      until = QUClock::now() + std::chrono::milliseconds(1);
+    }
+    int timeout = 0;
+    if (_ready.empty() && until > QUClock::now()) {
+      // Round up, or the loop spins for the last millisecond
+      timeout = (int)std::chrono::ceil<std::chrono::milliseconds>(until - QUClock::now()).count();
+    }
+    epoll_event events[64];
+    int count = epoll_wait(_epoll, events, 64, timeout);
+    for (int i = 0; i < count; i++) {
+      int fd = events[i].data.fd;
+      Watch &watch = _watched[fd];
+      const uint32_t broken = EPOLLERR | EPOLLHUP;
+      if (watch.reader && (events[i].events & (EPOLLIN | broken))) {
+        Soon(watch.reader);
+        watch.reader = nullptr;
+      }
+      if (watch.writer && (events[i].events & (EPOLLOUT | broken))) {
+        Soon(watch.writer);
+        watch.writer = nullptr;
+      }
+      Rearm(fd, true);
+    }
+    QUClock::time_point now = QUClock::now();
+    while (!_timers.empty() && _timers.top().when <= now) {
+      Soon(_timers.top().waiter);
+      _timers.pop();
+    }
+    for (size_t i = 0; i < _polls.size();) {
+      if (_polls[i].first()) {
+        Soon(_polls[i].second);
+        _polls.erase(_polls.begin() + i);
+      } else {
+        i++;
+      }
+    }
+    std::vector<std::coroutine_handle<> > ready;
+    ready.swap(_ready);
+    for (size_t i = 0; i < ready.size(); i++) {
+      ready[i].resume();
+    }
+  }
+
+  // Forgets every waiting coroutine, before they are destroyed
+  void Clear(void) {
+    for (std::map<int, Watch>::iterator watch = _watched.begin(); watch != _watched.end(); ++watch) {
+      epoll_ctl(_epoll, EPOLL_CTL_DEL, watch->first, NULL);
+    }
+    _watched.clear();
+    _timers = std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer> >();
+    _polls.clear();
+    _ready.clear();
+  }
+
+private:
+  struct Timer {
+    QUClock::time_point when;
+    unsigned long sequence; // Timers due together go off in order
+    std::coroutine_handle<> waiter;
+    bool operator>(const Timer &other) const {
+      return when != other.when ? when > other.when : sequence > other.sequence;
+    }
+  };
+  struct Watch {
+    std::coroutine_handle<> reader;
+    std::coroutine_handle<> writer;
+  };
+
+  // Asks epoll for what the fd's waiters still want. Returns false if it can't.
+  bool Rearm(int fd, bool known) {
+    Watch &watch = _watched[fd];
+    epoll_event event = {};
+    event.events = (watch.reader ? (uint32_t)EPOLLIN : 0) | (watch.writer ? (uint32_t)EPOLLOUT : 0);
+    event.data.fd = fd;
+    if (!event.events) {
+      epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, NULL);
+      _watched.erase(fd);
+      return true;
+    }
+    return epoll_ctl(_epoll, known ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) == 0;
+  }
+
+  int _epoll;
+  unsigned long _sequence;
+  std::vector<std::coroutine_handle<> > _ready;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer> > _timers;
+  std::map<int, Watch> _watched;
+  std::vector<std::pair<std::function<bool()>, std::coroutine_handle<> > > _polls;
+};
+
+/******************************************************************************/
+// Coroutines: QUTask<T> is what an ASYNC_TEST body, or a coroutine it
+// awaits, returns. It starts when first awaited.
+template <class T = void> class QUTask;
+
+struct QUPromiseBase {
+  std::coroutine_handle<> continuation; // Who awaits the result
+  std::exception_ptr exception;
+
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <class P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> done) noexcept {
+      std::coroutine_handle<> next = done.promise().continuation;
+      return next ? next : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { exception = std::current_exception(); }
+  void rethrow() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+};
+
+template <class T> struct QUPromise : QUPromiseBase {
+  std::optional<T> value;
+  void return_value(T result) { value = std::move(result); }
+  T result() { rethrow(); return std::move(*value); }
+};
+
+template <> struct QUPromise<void> : QUPromiseBase {
+  void return_void() {}
+  void result() { rethrow(); }
+};
+
+template <class T> class QUTask {
+public:
+  struct promise_type : QUPromise<T> {
+    QUTask get_return_object() { return QUTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+  };
+
+  QUTask(QUTask &&other) noexcept : _handle(other._handle) { other._handle = nullptr; }
+  ~QUTask() {
+    if (_handle) {
+      _handle.destroy();
+    }
+  }
+  QUTask(const QUTask &) = delete;
+  QUTask &operator=(const QUTask &) = delete;
+
+  // Used by the runner, for a task that nothing awaits
+  void Start(void) { _handle.resume(); }
+  bool done(void) const { return _handle.done(); }
+  T result(void) { return _handle.promise().result(); }
+
+  bool await_ready() { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+    _handle.promise().continuation = awaiting;
+    return _handle;
+  }
+  T await_resume() { return result(); }
+
+private:
+  explicit QUTask(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+  std::coroutine_handle<promise_type> _handle;
+};
+
+/******************************************************************************/
+// What an ASYNC_TEST can co_await, besides another QUTask
+struct QUSleep {
+  QUClock::duration wait;
+  bool await_ready() { return wait <= QUClock::duration::zero(); }
+  void await_suspend(std::coroutine_handle<> waiter) { QUEventLoop::Runner().At(QUClock::now() + wait, waiter); }
+  void await_resume() {}
+};
+template <class Rep, class Period> QUSleep sleep_for(std::chrono::duration<Rep, Period> wait) {
+  return QUSleep{std::chrono::duration_cast<QUClock::duration>(wait)};
+}
+
+struct QUFdReady {
+  int fd;
+  bool write;
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> waiter) { QUEventLoop::Runner().WhenReady(fd, write, waiter); }
+  void await_resume() {}
+};
+inline QUFdReady readable(int fd) { return QUFdReady{fd, false}; }
+inline QUFdReady writable(int fd) { return QUFdReady{fd, true}; }
+
+template <class T> struct QUFutureReady {
+  std::future<T> &future;
+  bool ready() { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+  bool await_ready() { return ready(); }
+  void await_suspend(std::coroutine_handle<> waiter) { QUEventLoop::Runner().WhenTrue([this] { return ready(); }, waiter); }
+  T await_resume() { return future.get(); }
+};
+// Futures can't tell the loop when they are ready, so they are polled
+template <class T> QUFutureReady<T> when_ready(std::future<T> &future) {
+  return QUFutureReady<T>{future};
+}
+
+/******************************************************************************/
+class QUAsyncBody {  // What makes a test an ASYNC_TEST
+/******************************************************************************/
+public:
+  virtual ~QUAsyncBody() {}
+  virtual QUTask<> Body(void) = 0;
+};
+
+/******************************************************************************/
+class QUAsyncGroup : public QUTestGroup {  // Runs ASYNC_TESTs on the runner's loop
+/******************************************************************************/
+public:
+  static QUAsyncGroup &Instance() {
+    static QUAsyncGroup group;
+    return group;
+  }
+
+  void RunTogether(QUTestSuite &suite, QUTest **tests, size_t count, QUTestOutcome *outcomes) {
+    QUEventLoop &loop = QUEventLoop::Runner();
+    QUAssertionLock::ThrowsFailures() = true;
+    const char *option = QUOptionTracker::Option("async-timeout");
+    double timeout = (option && *option) ? strtod(option, NULL) : 60;
+    std::vector<QUTask<> > tasks;
+    std::vector<QUClock::time_point> starts;
+    std::vector<double> span_starts;
+    std::vector<unsigned> lanes;     // Timeline lanes: each running test has one
+    std::vector<char> lane_in_use;
+    std::vector<char> finished(count, 0);
+    size_t running = count;
+    tasks.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      lanes.push_back(TakeLane(lane_in_use));
+      span_starts.push_back(SpanStart(suite, tests[i], lanes[i]));
+      Before(suite);
+      tests[i]->Reset();
+      starts.push_back(QUClock::now());
+      tasks.push_back(dynamic_cast<QUAsyncBody *>(tests[i])->Body());
+      tasks[i].Start();
+      if (tasks[i].done()) { // It had nothing to wait for
+        Finish(suite, tests[i], tasks[i], starts[i], outcomes[i]);
+        Span(suite, tests[i], span_starts[i], lanes[i]);
+        lane_in_use[lanes[i] - 1] = 0;
+        finished[i] = 1;
+        running--;
+      }
+    }
+    Counter(suite, "async tests running", (double)running);
+    QUClock::time_point deadline = QUClock::now() + std::chrono::duration_cast<QUClock::duration>(std::chrono::duration<double>(timeout));
+    while (running && QUClock::now() < deadline) {
+      loop.RunOnce(deadline);
+      for (size_t i = 0; i < count; i++) {
+        if (!finished[i] && tasks[i].done()) {
+          Finish(suite, tests[i], tasks[i], starts[i], outcomes[i]);
+          Span(suite, tests[i], span_starts[i], lanes[i]);
+          lane_in_use[lanes[i] - 1] = 0;
+          finished[i] = 1;
+          running--;
+        }
+      }
+      Counter(suite, "async tests running", (double)running);
+    }
+    if (running) {
+      loop.Clear();
+      std::ostringstream late;
+      late << "async test did not finish within " << timeout << "s";
+      for (size_t i = 0; i < count; i++) {
+        if (!finished[i]) {
+          tests[i]->force_fail_message(late.str().c_str());
+          After(suite);
+          outcomes[i].wall = outcomes[i].duration = Milliseconds(starts[i]);
+          outcomes[i].failed = true;
+          outcomes[i].fail_message = tests[i]->fail_message();
+          outcomes[i].output = tests[i]->test_output_text();
+          outcomes[i].metrics = tests[i]->metrics();
+          Span(suite, tests[i], span_starts[i], lanes[i]);
+        }
+      }
+    }
+  }
+
+  // Runs one ASYNC_TEST by itself, as Run() does when it is not in a suite
+  static void RunAlone(QUAsyncBody *body) {
+    QUTask<> task = body->Body();
+    task.Start();
+    while (!task.done()) {
+      QUEventLoop::Runner().RunOnce(QUClock::now() + std::chrono::seconds(1));
+    }
+    task.result();
+  }
+
+private:
+  // The lowest lane free, from 1
+  static unsigned TakeLane(std::vector<char> &in_use) {
+    size_t lane = 0;
+    while (lane < in_use.size() && in_use[lane]) {
+      lane++;
+    }
+    if (lane == in_use.size()) {
+      in_use.push_back(0);
+    }
+    in_use[lane] = 1;
+    return (unsigned)lane + 1;
+  }
+
+  static double Milliseconds(QUClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(QUClock::now() - start).count();
+  }
+
+  void Finish(QUTestSuite &suite, QUTest *test, QUTask<> &task, QUClock::time_point start, QUTestOutcome &outcome) {
+    bool failed = false;
+    try {
+      task.result();
+    } catch(QUTestFail * /*err*/) {
+      // Failed assertions cause us to come here
+      failed = true;
+    } catch(...) {
+      test->force_fail_message("unexpected exception in the test");
+      failed = true;
+    }
+    After(suite);
+    outcome.wall = outcome.duration = Milliseconds(start);
+    outcome.failed = failed || test->fails();
+    outcome.fail_message = outcome.failed ? test->fail_message() : "";
+    outcome.output = test->test_output_text();
+    outcome.metrics = test->metrics();
+  }
+};
+
+} /* quick_unit */
+
+// MUST be on a single line
+#define ASYNC_TEST(name) namespace { class QU_UNIQ_ID(QUTest) : public QU_TEST_ANCESTOR, public quick_unit::QUAsyncBody {public: QU_UNIQ_ID(QUTest)() : QU_TEST_ANCESTOR(#name) {if (QUTestSuiteTracker::CurrentQUTestSuite()) {QUTestSuiteTracker::CurrentQUTestSuite()->Add(this);}} void Run(void) { quick_unit::QUAsyncGroup::RunAlone(this); } quick_unit::QUTestGroup *Group(void) { return &quick_unit::QUAsyncGroup::Instance(); } quick_unit::QUTask<> Body(void); } static QU_UNIQ_ID(test);} quick_unit::QUTask<> QU_UNIQ_ID(QUTest)::Body(void)
+
+#endif	/* QUICK_UNIT_ASYNC_HPP */
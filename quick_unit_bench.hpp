@@ -0,0 +1,263 @@
+/*
+ * quick_unit_bench.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This is a reporter add-in for quick_unit that steadies the timings of
+ *  benchmark tests, and says what machine they were taken on, so numbers
+ *  from different runs can be compared.
+ *
+ *   #include "quick_unit.hpp"
+ *   #include "quick_unit_bench.hpp"
+ *
+ *   ADDITIONAL_REPORTER(BenchEnvironment)
+ *   DECLARE_SUITE(Parser benchmarks)
+ *
+ * Before the first suite starts the reporter:
+ *  --bench-cpu=<n>           pins the thread running the tests to CPU n.
+ *  --bench-priority[=<nice>] raises its priority to nice (default -10),
+ *                            which needs root or CAP_SYS_NICE.
+ * Forked children (--fork) inherit both.
+ *
+ * At the start of each suite it reads the machine again and writes the CPU
+ * model, the CPU the tests run on, its frequency governor and the priority,
+ * followed by a warning for each thing that makes timings vary:
+ *
+ *   Benchmark environment: Intel(R) Core(TM) i7-8550U CPU @ 1.80GHz, CPU 2 (pinned), governor powersave, nice 0
+ *   Warning: the CPU 2 governor is powersave, so its clock speed follows the load
+ *   Warning: turbo boost is on, so the clock speed depends on load and temperature
+ *   Warning: CPU 2 shares its core with CPU 6 (SMT), so work there slows it down
+ *   Warning: the load average is 9.12 on 8 CPUs, so other work is competing for them
+ *
+ * The checks read /sys and /proc, so they only find anything on Linux.
+ * QUBenchEnvironment can also be used directly, for a benchmark to keep
+ * with its own results.
+ */
+
+#ifndef QUICK_UNIT_BENCH_HPP
+#define	QUICK_UNIT_BENCH_HPP
+
+#include <fstream>
+#include <vector>
+#ifdef __linux__
+ #include <errno.h>
+ #include <sched.h>
+ #include <sys/resource.h>
+ #include <unistd.h>
+#endif
+
+namespace quick_unit {
+
+/******************************************************************************/
+class QUBenchEnvironment {  // The machine a benchmark runs on, from /sys and /proc
+/******************************************************************************/
+public:
+  int cpu;                            // The CPU read about, or -1 if unknown
+  std::string model;                  // "" if unknown
+  std::string governor;               // "" without cpufreq
+  std::vector<std::string> warnings;
+
+  // Reads about the CPU (-1 for the one this thread is on). The root is
+  // where /sys and /proc are found, for tests.
+  QUBenchEnvironment(int on_cpu = -1, const std::string &root = "") {
+    _root = root;
+    cpu = on_cpu;
+    #ifdef __linux__
+    if (cpu < 0 && root.empty()) {
+      cpu = sched_getcpu();
+    }
+    #endif
+    model = Field(Read("/proc/cpuinfo"), "model name");
+    if (model.empty()) {
+      model = Field(Read("/proc/cpuinfo"), "Processor");
+    }
+    if (cpu >= 0) {
+      governor = Line(Read(CpuPath("cpufreq/scaling_governor")));
+      if (!governor.empty() && governor != "performance") {
+        warnings.push_back("the CPU " + Number(cpu) + " governor is " + governor + ", so its clock speed follows the load");
+      }
+      std::vector<int> siblings = CpuList(Read(CpuPath("topology/thread_siblings_list")));
+      for (size_t i = 0; i < siblings.size(); i++) {
+        if (siblings[i] != cpu) {
+          warnings.push_back("CPU " + Number(cpu) + " shares its core with CPU " + Number(siblings[i]) + " (SMT), so work there slows it down");
+        }
+      }
+    }
+    if (Line(Read("/sys/devices/system/cpu/intel_pstate/no_turbo")) == "0") {
+      warnings.push_back("turbo boost is on, so the clock speed depends on load and temperature");
+    } else if (Line(Read("/sys/devices/system/cpu/cpufreq/boost")) == "1") {
+      warnings.push_back("frequency boost is on, so the clock speed depends on load and temperature");
+    }
+    // The load average counts this run as well, so more than a CPU each
+    // means something has to wait
+    std::string load = Read("/proc/loadavg");
+    long cpus = (long)CpuList(Read("/sys/devices/system/cpu/online")).size();
+    #ifdef __linux__
+    if (!cpus && root.empty()) {
+      cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    #endif
+    cpus = cpus < 1 ? 1 : cpus;
+    if (!load.empty() && strtod(load.c_str(), NULL) > (double)cpus) {
+      warnings.push_back("the load average is " + load.substr(0, load.find(' ')) + " on " + Number(cpus) + (cpus == 1 ? " CPU" : " CPUs") + ", so other work is competing for them");
+    }
+  }
+
+  // "Intel(R) Xeon(R) Processor, CPU 3 (pinned), governor performance"
+  std::string Describe(bool pinned = false) const {
+    std::string text = model.empty() ? "unknown CPU" : model;
+    if (cpu >= 0) {
+      text += ", CPU " + Number(cpu) + (pinned ? " (pinned)" : "");
+    }
+    if (!governor.empty()) {
+      text += ", governor " + governor;
+    }
+    return text;
+  }
+
+  // Pins the calling thread to a CPU. Returns "" or why it could not.
+  static std::string Pin(int to_cpu) {
+    #ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (to_cpu < 0 || to_cpu >= CPU_SETSIZE) {
+      return "no CPU " + Number(to_cpu);
+    }
+    CPU_SET(to_cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      return strerror(errno);
+    }
+    return "";
+    #else
+    return "pinning is only supported on Linux";
+    #endif
+  }
+
+  // Sets the calling thread's nice value. Returns "" or why it could not.
+  static std::string Nice(int nice) {
+    #ifdef __linux__
+    if (setpriority(PRIO_PROCESS, 0, nice) != 0) {
+      return strerror(errno);
+    }
+    return "";
+    #else
+    return "priorities are only supported on Linux";
+    #endif
+  }
+
+  // The CPUs in a list such as "0-3,8"
+  static std::vector<int> CpuList(const std::string &text) {
+    std::vector<int> cpus;
+    const char *at = text.c_str();
+    while (*at >= '0' && *at <= '9') {
+      char *end;
+      long first = strtol(at, &end, 10);
+      long last = first;
+      if (*end == '-') {
+        last = strtol(end + 1, &end, 10);
+      }
+      for (long each = first; each <= last; each++) {
+        cpus.push_back((int)each);
+      }
+      at = *end == ',' ? end + 1 : end;
+    }
+    return cpus;
+  }
+
+private:
+  std::string _root;
+
+  std::string CpuPath(const char *file) const {
+    return "/sys/devices/system/cpu/cpu" + Number(cpu) + "/" + file;
+  }
+  std::string Read(const std::string &path) const {
+    std::ifstream in((_root + path).c_str());
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+  }
+  static std::string Line(const std::string &text) {
+    return text.substr(0, text.find('\n'));
+  }
+  // The value of the first "name<tabs>: value" line
+  static std::string Field(const std::string &text, const std::string &name) {
+    size_t at = 0;
+    while (at < text.size()) {
+      std::string line = Line(text.substr(at));
+      if (line.compare(0, name.size(), name) == 0 && line.find(':') != std::string::npos) {
+        size_t value = line.find_first_not_of(" \t", line.find(':') + 1);
+        return value == std::string::npos ? "" : line.substr(value);
+      }
+      at += line.size() + 1;
+    }
+    return "";
+  }
+  static std::string Number(long number) {
+    std::ostringstream text;
+    text << number;
+    return text.str();
+  }
+};
+
+} /* quick_unit */
+
+BEGIN_REPORTER(BenchEnvironment)
+  BenchEnvironmentReporter() : _environment(NULL), _isolated(false), _cpu(-1), _nice(0) {}
+  ~BenchEnvironmentReporter() { delete _environment; }
+
+  void StartingSuite(const std::string &suite_name) {
+    if (!_isolated) {
+      Isolate();
+    }
+  }
+  // The load and governor change as the run goes on, so are read each time
+  void StartedSuite(const std::string &suite_name) {
+    delete _environment;
+    _environment = new QUBenchEnvironment(_cpu);
+    _environment->warnings.insert(_environment->warnings.begin(), _problems.begin(), _problems.end());
+    #ifdef __linux__
+    errno = 0;
+    _nice = getpriority(PRIO_PROCESS, 0);
+    #endif
+    Output() << "Benchmark environment: " << _environment->Describe(_cpu >= 0) << ", nice " << _nice << std::endl;
+    for (size_t i = 0; i < _environment->warnings.size(); i++) {
+      Output() << "Warning: " << _environment->warnings[i] << std::endl;
+    }
+  }
+
+  // The machine as the latest suite started, or NULL before then
+  const QUBenchEnvironment *environment(void) const { return _environment; }
+
+private:
+  QUBenchEnvironment *_environment;
+  std::vector<std::string> _problems;   // Found by Isolate(), given with each suite's warnings
+  bool _isolated;
+  int _cpu;                             // Pinned to, or -1
+  int _nice;
+
+  // Applies --bench-cpu and --bench-priority, once
+  void Isolate(void) {
+    _isolated = true;
+    const char *cpu_option = QUOptionTracker::Option("bench-cpu");
+    _cpu = cpu_option ? atoi(cpu_option) : -1;
+    if (cpu_option) {
+      std::string problem = QUBenchEnvironment::Pin(_cpu);
+      if (!problem.empty()) {
+        _problems.push_back("could not pin to CPU " + std::string(cpu_option) + ": " + problem);
+        _cpu = -1;
+      }
+    }
+    const char *priority_option = QUOptionTracker::Option("bench-priority");
+    if (priority_option) {
+      int nice = *priority_option ? atoi(priority_option) : -10;
+      std::string problem = QUBenchEnvironment::Nice(nice);
+      if (!problem.empty()) {
+        std::ostringstream text;
+        text << "could not set nice " << nice << ": " << problem;
+        _problems.push_back(text.str());
+      }
+    }
+  }
+END_REPORTER()
+
+#endif	/* QUICK_UNIT_BENCH_HPP */
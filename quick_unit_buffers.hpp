@@ -0,0 +1,275 @@
+/*
+ * quick_unit_buffers.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit provides assertions for big buffers and
+ *  containers. They compare with SIMD code (AVX2 or SSE2 where the CPU has
+ *  it, plain C++ otherwise) and, on failure, report just the first
+ *  difference and a few elements either side of it.
+ *
+ * TEST(Decoder output matches) {
+ *   std::vector<unsigned char> expected = load("expected.bin");
+ *   std::vector<unsigned char> actual = decode("input.bin");
+ *   assert_equal_range(expected, actual, SHOULD(decode every byte));
+ *   assert_equal_bytes(&expected[0], &actual[0], 64, SHOULD(have the same header));
+ * }
+ *
+ * gives failure messages such as
+ *   line 4: Should decode every byte. (Differs at index 1048576 of 104857600.
+ *   Expected: ... 00 00 [41] 00 ..., got: ... 00 00 [42] 00 ...)
+ *
+ * assert_equal_range accepts std::vector, std::string, and anything else
+ * with begin()/end()/size(). Vectors of integers, and strings, are compared
+ * as bytes with the SIMD kernels. Other element types, and std::vector<bool>
+ * (whose bits are packed), are compared one by one with ==, and must be
+ * printable to a std::ostream.
+ */
+
+#ifndef QUICK_UNIT_BUFFERS_HPP
+#define	QUICK_UNIT_BUFFERS_HPP
+
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+ #include <immintrin.h>
+ #ifdef __SSE2__
+  #define QU_SIMD_SSE2 1
+ #endif
+ #define QU_SIMD_AVX2_DISPATCH // Built for AVX2 as well, used if the CPU has it
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+ #include <intrin.h>
+ #include <emmintrin.h>
+ #define QU_SIMD_SSE2 1
+#endif
+
+namespace quick_unit {
+
+/******************************************************************************/
+class QUBufferCompare {  // First-difference search kernels
+/******************************************************************************/
+public:
+  // Returns the offset of the first byte that differs, or size if none do
+  static size_t FirstMismatch(const void *a, const void *b, size_t size) {
+    const unsigned char *x = (const unsigned char *)a;
+    const unsigned char *y = (const unsigned char *)b;
+    size_t done = 0;
+    #if defined(__AVX2__)
+    done = MatchedAVX2(x, y, size);
+    #elif defined(QU_SIMD_AVX2_DISPATCH)
+    static const bool has_avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    done = has_avx2 ? MatchedAVX2(x, y, size) : MatchedSSE2(x, y, size);
+    #else
+    done = MatchedSSE2(x, y, size);
+    #endif
+    return done + MatchedScalar(x + done, y + done, size - done);
+  }
+
+  #if defined(QU_SIMD_AVX2_DISPATCH) || defined(__AVX2__)
+  #ifdef QU_SIMD_AVX2_DISPATCH
+  __attribute__((target("avx2")))
+  #endif
+  // Compares 64 bytes per pass. Returns how many bytes were found equal.
+  static size_t MatchedAVX2(const unsigned char *x, const unsigned char *y, size_t size) {
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+      __m256i lo = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(x + i)), _mm256_loadu_si256((const __m256i *)(y + i)));
+      __m256i hi = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(x + i + 32)), _mm256_loadu_si256((const __m256i *)(y + i + 32)));
+      if ((unsigned)_mm256_movemask_epi8(_mm256_and_si256(lo, hi)) != 0xffffffffU) {
+        unsigned lo_mask = ~(unsigned)_mm256_movemask_epi8(lo);
+        return lo_mask ? i + LowestSetBit(lo_mask) : i + 32 + LowestSetBit(~(unsigned)_mm256_movemask_epi8(hi));
+      }
+    }
+    return i;
+  }
+  #endif
+
+  // Compares 16 bytes per pass. Returns how many bytes were found equal.
+  static size_t MatchedSSE2(const unsigned char *x, const unsigned char *y, size_t size) {
+    size_t i = 0;
+    #ifdef QU_SIMD_SSE2
+    for (; i + 16 <= size; i += 16) {
+      __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(x + i)), _mm_loadu_si128((const __m128i *)(y + i)));
+      unsigned mask = (unsigned)_mm_movemask_epi8(eq);
+      if (mask != 0xffffU) {
+        return i + LowestSetBit(~mask);
+      }
+    }
+    #endif
+    return i;
+  }
+
+  // Plain C++: a word at a time, then byte by byte
+  static size_t MatchedScalar(const unsigned char *x, const unsigned char *y, size_t size) {
+    size_t i = 0;
+    for (; i + sizeof(size_t) <= size; i += sizeof(size_t)) {
+      size_t wx, wy;
+      memcpy(&wx, x + i, sizeof(wx));
+      memcpy(&wy, y + i, sizeof(wy));
+      if (wx != wy) {
+        break;
+      }
+    }
+    while (i < size && x[i] == y[i]) {
+      i++;
+    }
+    return i;
+  }
+
+  static unsigned LowestSetBit(unsigned mask) {
+    #ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+    #else
+    return (unsigned)__builtin_ctz(mask);
+    #endif
+  }
+};
+
+/******************************************************************************/
+// Element types that can be compared as raw bytes
+template <class T> struct QUBytewise { enum { value = 0 }; };
+template <> struct QUBytewise<char> { enum { value = 1 }; };
+template <> struct QUBytewise<signed char> { enum { value = 1 }; };
+template <> struct QUBytewise<unsigned char> { enum { value = 1 }; };
+template <> struct QUBytewise<wchar_t> { enum { value = 1 }; };
+template <> struct QUBytewise<short> { enum { value = 1 }; };
+template <> struct QUBytewise<unsigned short> { enum { value = 1 }; };
+template <> struct QUBytewise<int> { enum { value = 1 }; };
+template <> struct QUBytewise<unsigned int> { enum { value = 1 }; };
+template <> struct QUBytewise<long> { enum { value = 1 }; };
+template <> struct QUBytewise<unsigned long> { enum { value = 1 }; };
+template <> struct QUBytewise<long long> { enum { value = 1 }; };
+template <> struct QUBytewise<unsigned long long> { enum { value = 1 }; };
+
+/******************************************************************************/
+class QUTestBuffers : public quick_unit::QU_TEST_ANCESTOR {
+/******************************************************************************/
+public:
+  QUTestBuffers(const char *msg) : quick_unit::QU_TEST_ANCESTOR(msg) {}
+
+  enum { window = 4 }; // Elements shown either side of a difference
+
+  // Result matcher: byte buffers
+  ADD_MATCHER(equal_bytes, const void *expected, const void *actual, size_t size) {
+    size_t at = QUBufferCompare::FirstMismatch(expected, actual, size);
+    return difference((const unsigned char *)expected, size, (const unsigned char *)actual, size, at);
+  }
+  // Result matchers: containers
+  template <class T> ADD_MATCHER(equal_range, const std::vector<T> &expected, const std::vector<T> &actual) {
+    if (QUBytewise<T>::value) {
+      const T *x = expected.empty() ? NULL : &expected[0];
+      const T *y = actual.empty() ? NULL : &actual[0];
+      size_t common = std::min(expected.size(), actual.size());
+      size_t at = QUBufferCompare::FirstMismatch(x, y, common * sizeof(T)) / sizeof(T);
+      return difference(x, expected.size(), y, actual.size(), at);
+    }
+    return equal_elements(expected, actual);
+  }
+  ADD_MATCHER(equal_range, const std::string &expected, const std::string &actual) {
+    size_t at = QUBufferCompare::FirstMismatch(expected.data(), actual.data(), std::min(expected.size(), actual.size()));
+    return difference((const unsigned char *)expected.data(), expected.size(), (const unsigned char *)actual.data(), actual.size(), at);
+  }
+  ADD_MATCHER(equal_range, const std::vector<bool> &expected, const std::vector<bool> &actual) {
+    return equal_elements(expected, actual); // Packed bits, with no bytes to compare
+  }
+  template <class C> ADD_MATCHER(equal_range, const C &expected, const C &actual) {
+    return equal_elements(expected, actual);
+  }
+
+  // Assertions
+  ADD_ASSERTION(equal_bytes, const void *expected, const void *actual, size_t size) {ASSERTION(equal_bytes(expected, actual, size));}
+  template <class C> ADD_ASSERTION(equal_range, const C &expected, const C &actual) {ASSERTION(equal_range(expected, actual));}
+
+protected:
+  template <class C> Qu_Result equal_elements(const C &expected, const C &actual) {
+    std::vector<typename C::value_type> x, y;
+    size_t at = 0;
+    typename C::const_iterator ex = expected.begin();
+    typename C::const_iterator ac = actual.begin();
+    while (ex != expected.end() && ac != actual.end() && *ex == *ac) {
+      ++ex; ++ac; ++at;
+    }
+    if (at == expected.size() && at == actual.size()) {
+      return result(true, "");
+    }
+    // Copy out just the window around the difference for the message
+    size_t first = at > window ? at - window : 0;
+    ex = expected.begin();
+    ac = actual.begin();
+    for (size_t i = 0; i < at + window + 1; i++) {
+      if (i >= first && ex != expected.end()) x.push_back(*ex);
+      if (i >= first && ac != actual.end()) y.push_back(*ac);
+      if (ex != expected.end()) ++ex;
+      if (ac != actual.end()) ++ac;
+    }
+    _expectation_builder.str("");
+    describe_difference(at, expected.size(), actual.size());
+    _expectation_builder << " Expected: ";
+    describe_window(x.begin(), x.size(), at - first, first > 0, at + window + 1 < expected.size());
+    _expectation_builder << ", got: ";
+    describe_window(y.begin(), y.size(), at - first, first > 0, at + window + 1 < actual.size());
+    _expectation_builder << ")";
+    _expectation = _expectation_builder.str();
+    return result(false, _expectation);
+  }
+
+  // Builds the result for two buffers that match up to index at
+  template <class T> Qu_Result difference(const T *expected, size_t expected_size, const T *actual, size_t actual_size, size_t at) {
+    if (at == expected_size && at == actual_size) {
+      return result(true, "");
+    }
+    size_t first = at > window ? at - window : 0;
+    _expectation_builder.str("");
+    describe_difference(at, expected_size, actual_size);
+    _expectation_builder << " Expected: ";
+    describe_window(expected + first, std::min(expected_size, at + window + 1) - std::min(expected_size, first), at - first, first > 0, at + window + 1 < expected_size);
+    _expectation_builder << ", got: ";
+    describe_window(actual + first, std::min(actual_size, at + window + 1) - std::min(actual_size, first), at - first, first > 0, at + window + 1 < actual_size);
+    _expectation_builder << ")";
+    _expectation = _expectation_builder.str();
+    return result(false, _expectation);
+  }
+
+  void describe_difference(size_t at, size_t expected_size, size_t actual_size) {
+    if (expected_size != actual_size) {
+      _expectation_builder << " (Expected " << expected_size << " elements, got " << actual_size << ".";
+      if (at < expected_size && at < actual_size) {
+        _expectation_builder << " First difference at index " << at << ".";
+      }
+    } else {
+      _expectation_builder << " (Differs at index " << at << " of " << expected_size << ".";
+    }
+  }
+
+  // Prints size elements from data (a pointer or random access iterator),
+  // marking the one at index mark with [ ]
+  template <class It> void describe_window(It data, size_t size, size_t mark, bool more_before, bool more_after) {
+    if (more_before) _expectation_builder << "... ";
+    for (size_t i = 0; i < size; i++) {
+      if (i) _expectation_builder << " ";
+      if (i == mark) _expectation_builder << "[";
+      describe_element(typename std::iterator_traits<It>::value_type(data[i])); // Not a vector<bool> proxy
+      if (i == mark) _expectation_builder << "]";
+    }
+    if (mark >= size) _expectation_builder << (size ? " " : "") << "[end]";
+    if (more_after) _expectation_builder << " ...";
+  }
+  template <class T> void describe_element(const T &element) { _expectation_builder << element; }
+  void describe_element(unsigned char element) {
+    _expectation_builder << std::hex << std::setw(2) << std::setfill('0') << (unsigned)element << std::dec << std::setfill(' ');
+  }
+  void describe_element(char element) { describe_element((unsigned char)element); }
+  void describe_element(signed char element) { describe_element((unsigned char)element); }
+  void describe_element(bool element) { _expectation_builder << (element ? "true" : "false"); }
+};
+#undef QU_TEST_ANCESTOR
+#define QU_TEST_ANCESTOR QUTestBuffers
+
+} /* quick_unit */
+
+#endif	/* QUICK_UNIT_BUFFERS_HPP */
@@ -0,0 +1,374 @@
+/*
+ * quick_unit_diff.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit makes assert_equal on long strings report a
+ *  line diff of the differences, instead of printing both strings in full.
+ *
+ * TEST(The report is generated) {
+ *   std::string expected = load("expected_report.txt");
+ *   assert_equal(expected, generate_report(), SHOULD(match the saved report));
+ * }
+ *
+ * gives failure messages such as
+ *   line 3: Should match the saved report. (Strings differ at byte 5012
+ *   (line 120, column 9). Expected 88001 bytes, got 88003 bytes)
+ *   @@ -117,7 +117,7 @@
+ *    total: 14
+ *    ...
+ *   -name: alpha
+ *   +name: alpha2
+ *    ...
+ *
+ * It applies to assert_equal with std::strings or const char * strings.
+ * Short single line strings keep the usual (Expected: ..., got: ...) form.
+ * The diff is only worked out when the strings are not equal.
+ *
+ * The common start and end of the strings are skipped first, so a small
+ * change in a huge text is cheap. The lines in between are compared with
+ * Myers' linear space diff. If that needs more than QU_DIFF_BUDGET steps
+ * the rest is shown as replaced lines, and at most QU_DIFF_MAX_COMPARED
+ * lines of each string are compared, so the time and memory stay bounded
+ * even for 100MB of unrelated text. At most QU_DIFF_MAX_LINES lines of
+ * diff are shown, and long lines are cut down around the first change.
+ */
+
+#ifndef QUICK_UNIT_DIFF_HPP
+#define	QUICK_UNIT_DIFF_HPP
+
+#include <vector>
+#include <algorithm>
+
+#ifndef QU_DIFF_BUDGET
+ #define QU_DIFF_BUDGET 20000000
+#endif
+#ifndef QU_DIFF_MAX_COMPARED
+ #define QU_DIFF_MAX_COMPARED 1000000
+#endif
+#ifndef QU_DIFF_MAX_LINES
+ #define QU_DIFF_MAX_LINES 100
+#endif
+
+namespace quick_unit {
+
+/******************************************************************************/
+class QUDiff {  // Line diff of two texts
+/******************************************************************************/
+public:
+  // Describes where expected and actual first differ, followed by the
+  // changed lines with 'context' unchanged lines around them
+  static std::string Text(const char *expected, size_t expected_size, const char *actual, size_t actual_size, size_t context = 3) {
+    QUDiff diff(expected, expected_size, actual, actual_size, context);
+    return diff.Render();
+  }
+  static std::string Text(const std::string &expected, const std::string &actual, size_t context = 3) {
+    return Text(expected.data(), expected.size(), actual.data(), actual.size(), context);
+  }
+
+private:
+  struct Line {
+    const char *text;
+    size_t size;
+    unsigned long long hash;
+  };
+  struct Edit {   // Lines [a_begin, a_end) of expected became [b_begin, b_end) of actual
+    size_t a_begin, a_end, b_begin, b_end;
+  };
+
+  const char *_a, *_b;
+  size_t _a_size, _b_size;
+  size_t _context;
+  size_t _first_difference;       // Byte offset
+  size_t _first_line, _first_column;
+  size_t _region_line;            // Line number of _a_lines[0] and _b_lines[0]
+  bool _cut_short;                // Hit QU_DIFF_MAX_COMPARED
+  std::vector<Line> _a_lines, _b_lines;
+  std::vector<Edit> _edits;
+  std::vector<long> _forward, _backward;
+  long _budget;                   // Steps left for MiddleSnake
+  long _max_d;                    // It cannot get further than this within the budget
+
+  QUDiff(const char *a, size_t a_size, const char *b, size_t b_size, size_t context)
+    : _a(a), _b(b), _a_size(a_size), _b_size(b_size), _context(context), _cut_short(false), _budget(QU_DIFF_BUDGET), _max_d(1) {
+    while (_max_d * _max_d < _budget) {
+      _max_d++;
+    }
+    size_t shorter = a_size < b_size ? a_size : b_size;
+    size_t prefix = CommonPrefix(a, b, shorter);
+    size_t suffix = CommonSuffix(a + a_size, b + b_size, shorter - prefix);
+    _first_difference = prefix;
+
+    // Widen the differing bytes out to whole lines, plus the context lines
+    size_t begin = prefix;
+    for (size_t lines = 0; begin > 0; begin--) {
+      if (a[begin - 1] == '\n' && ++lines > context) {
+        break;
+      }
+    }
+    size_t a_end = LinesAfter(a, a_size, a_size - suffix, context + 1);
+    size_t b_end = LinesAfter(b, b_size, b_size - suffix, context + 1);
+
+    _region_line = 1 + CountLines(a, begin);
+    _first_line = _region_line + CountLines(a + begin, prefix - begin);
+    const char *line_start = a + prefix;
+    while (line_start > a && line_start[-1] != '\n') {
+      line_start--;
+    }
+    _first_column = 1 + (a + prefix - line_start);
+
+    _cut_short = !Split(a + begin, a_end - begin, _a_lines) | !Split(b + begin, b_end - begin, _b_lines);
+    Compare(0, _a_lines.size(), 0, _b_lines.size());
+  }
+
+  static size_t CommonPrefix(const char *a, const char *b, size_t size) {
+    size_t i = 0;
+    while (i + 4096 <= size && memcmp(a + i, b + i, 4096) == 0) {
+      i += 4096;
+    }
+    while (i < size && a[i] == b[i]) {
+      i++;
+    }
+    return i;
+  }
+  // a_end and b_end point just past the texts
+  static size_t CommonSuffix(const char *a_end, const char *b_end, size_t size) {
+    size_t i = 0;
+    while (i + 4096 <= size && memcmp(a_end - i - 4096, b_end - i - 4096, 4096) == 0) {
+      i += 4096;
+    }
+    while (i < size && a_end[-1 - (long)i] == b_end[-1 - (long)i]) {
+      i++;
+    }
+    return i;
+  }
+  // The offset just past 'lines' more newlines from 'from', or the end
+  static size_t LinesAfter(const char *text, size_t size, size_t from, size_t lines) {
+    while (lines-- > 0 && from < size) {
+      const char *newline = (const char *)memchr(text + from, '\n', size - from);
+      from = newline ? (size_t)(newline - text) + 1 : size;
+    }
+    return from;
+  }
+  static size_t CountLines(const char *text, size_t size) {
+    size_t count = 0;
+    for (const char *end = text + size; (text = (const char *)memchr(text, '\n', end - text)) != NULL; text++) {
+      count++;
+    }
+    return count;
+  }
+  // Lines are compared by hash and length; a 64 bit collision would only
+  // make the diff display less tidy, as the strings are already known to differ.
+  // Returns false if there were too many lines to take them all.
+  static bool Split(const char *text, size_t size, std::vector<Line> &lines) {
+    const char *end = text + size;
+    while (text < end) {
+      if (lines.size() == QU_DIFF_MAX_COMPARED) {
+        return false;
+      }
+      Line line = {text, 0, 14695981039346656037ULL};
+      while (text < end && *text != '\n') {
+        line.hash = (line.hash ^ (unsigned char)*text++) * 1099511628211ULL;
+      }
+      line.size = text - line.text;
+      lines.push_back(line);
+      text++;
+    }
+    return true;
+  }
+  bool Same(size_t a, size_t b) const {
+    return _a_lines[a].hash == _b_lines[b].hash && _a_lines[a].size == _b_lines[b].size;
+  }
+
+  // Records the edits turning lines [a0, a1) into [b0, b1), in order
+  void Compare(size_t a0, size_t a1, size_t b0, size_t b1) {
+    while (a0 < a1 && b0 < b1 && Same(a0, b0)) {
+      a0++, b0++;
+    }
+    while (a0 < a1 && b0 < b1 && Same(a1 - 1, b1 - 1)) {
+      a1--, b1--;
+    }
+    if (a0 == a1 && b0 == b1) {
+      return;
+    }
+    size_t a_split, b_split;
+    if (a0 == a1 || b0 == b1 || !MiddleSnake(a0, a1, b0, b1, a_split, b_split)) {
+      AddEdit(a0, a1, b0, b1);
+      return;
+    }
+    Compare(a0, a_split, b0, b_split);
+    Compare(a_split, a1, b_split, b1);
+  }
+  void AddEdit(size_t a0, size_t a1, size_t b0, size_t b1) {
+    if (!_edits.empty() && _edits.back().a_end == a0 && _edits.back().b_end == b0) {
+      _edits.back().a_end = a1;
+      _edits.back().b_end = b1;
+    } else {
+      Edit edit = {a0, a1, b0, b1};
+      _edits.push_back(edit);
+    }
+  }
+
+  // Myers' middle snake: finds a point on an optimal edit path half way
+  // through it, searching forwards and backwards at once. Returns false
+  // once the step budget runs out.
+  bool MiddleSnake(size_t a0, size_t a1, size_t b0, size_t b1, size_t &a_split, size_t &b_split) {
+    const long n = (long)(a1 - a0), m = (long)(b1 - b0);
+    const long delta = n - m;
+    const bool odd = (delta & 1) != 0;
+    const long max_d = std::min((n + m + 1) / 2, _max_d);
+    const long offset = max_d + 1;
+    _forward.assign(2 * offset + 1, -1);
+    _backward.assign(2 * offset + 1, -1);
+    _forward[offset + 1] = 0;
+    _backward[offset + 1] = 0;
+    for (long d = 0; d <= max_d; d++) {
+      if ((_budget -= 2 * d + 1) < 0) {
+        return false;
+      }
+      for (long k = -d; k <= d; k += 2) {
+        long x = (k == -d || (k != d && _forward[offset + k - 1] < _forward[offset + k + 1])) ? _forward[offset + k + 1] : _forward[offset + k - 1] + 1;
+        long y = x - k;
+        long start = x;
+        while (x < n && y < m && Same(a0 + x, b0 + y)) {
+          x++, y++;
+        }
+        _budget -= x - start;
+        _forward[offset + k] = x;
+        long c = delta - k;
+        if (odd && c >= -(d - 1) && c <= d - 1 && _backward[offset + c] >= 0 && x + _backward[offset + c] >= n) {
+          a_split = a0 + x;
+          b_split = b0 + y;
+          return true;
+        }
+      }
+      for (long c = -d; c <= d; c += 2) {
+        long x = (c == -d || (c != d && _backward[offset + c - 1] < _backward[offset + c + 1])) ? _backward[offset + c + 1] : _backward[offset + c - 1] + 1;
+        long y = x - c;
+        long start = x;
+        while (x < n && y < m && Same(a1 - x - 1, b1 - y - 1)) {
+          x++, y++;
+        }
+        _budget -= x - start;
+        _backward[offset + c] = x;
+        long k = delta - c;
+        if (!odd && k >= -d && k <= d && _forward[offset + k] >= 0 && _forward[offset + k] + x >= n) {
+          a_split = a1 - x;
+          b_split = b1 - y;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  std::string Render() {
+    std::ostringstream os;
+    os << " (Strings differ at byte " << _first_difference << " (line " << _first_line << ", column " << _first_column << "). Expected " << _a_size << " bytes, got " << _b_size << " bytes)";
+    if (_edits.empty()) {
+      os << "\n(Only the final newline differs)";
+    }
+    if (_cut_short) {
+      // Edits running into the cut off end only reflect where it was cut
+      while (_edits.size() > 1 && (_edits.back().a_end == _a_lines.size() || _edits.back().b_end == _b_lines.size())) {
+        _edits.pop_back();
+      }
+    }
+    size_t shown = 0;
+    for (size_t e = 0; e < _edits.size(); ) {
+      // A hunk takes in every edit within 2 * context lines of the last
+      size_t last = e;
+      while (last + 1 < _edits.size() && _edits[last + 1].a_begin - _edits[last].a_end <= 2 * _context) {
+        last++;
+      }
+      size_t a_begin = _edits[e].a_begin > _context ? _edits[e].a_begin - _context : 0;
+      size_t b_begin = _edits[e].b_begin - (_edits[e].a_begin - a_begin);
+      size_t a_end = std::min(_edits[last].a_end + _context, _a_lines.size());
+      size_t b_end = _edits[last].b_end + (a_end - _edits[last].a_end);
+      os << "\n@@ -" << _region_line + a_begin << "," << a_end - a_begin << " +" << _region_line + b_begin << "," << b_end - b_begin << " @@";
+      size_t a = a_begin;
+      for (size_t i = e; i <= last; i++) {
+        for (; a < _edits[i].a_begin; a++) {
+          if (!Show(os, ' ', _a_lines[a], shown)) return os.str();
+        }
+        for (; a < _edits[i].a_end; a++) {
+          if (!Show(os, '-', _a_lines[a], shown)) return os.str();
+        }
+        for (size_t b = _edits[i].b_begin; b < _edits[i].b_end; b++) {
+          if (!Show(os, '+', _b_lines[b], shown)) return os.str();
+        }
+      }
+      for (; a < a_end; a++) {
+        if (!Show(os, ' ', _a_lines[a], shown)) return os.str();
+      }
+      e = last + 1;
+    }
+    if (_cut_short) {
+      os << "\n... (only " << QU_DIFF_MAX_COMPARED << " lines were compared)";
+    }
+    return os.str();
+  }
+  bool Show(std::ostringstream &os, char mark, const Line &line, size_t &shown) {
+    if (shown++ == QU_DIFF_MAX_LINES) {
+      os << "\n... (diff cut short)";
+      return false;
+    }
+    os << "\n" << mark;
+    const size_t width = 160;
+    if (line.size <= width) {
+      os.write(line.text, line.size);
+      return true;
+    }
+    // Show long lines around the first change, if it is on them
+    size_t from = 0;
+    const char *text = mark == '+' ? _b : _a;
+    size_t at = line.text - text;
+    if (_first_difference >= at && _first_difference < at + line.size) {
+      from = std::min(_first_difference - at > width / 4 ? _first_difference - at - width / 4 : 0, line.size - width);
+    }
+    if (from) {
+      os << "...";
+    }
+    os.write(line.text + from, width);
+    os << "... (" << line.size << " bytes)";
+    return true;
+  }
+};
+
+/******************************************************************************/
+class QUTestDiff : public quick_unit::QU_TEST_ANCESTOR {
+/******************************************************************************/
+public:
+  QUTestDiff(const char *msg) : quick_unit::QU_TEST_ANCESTOR(msg) {}
+
+  // Result matchers: Equality, with a diff for long strings
+  using quick_unit::QU_TEST_ANCESTOR::equal;
+  ADD_MATCHER(equal, const std::string &a, const std::string &b) {
+    return equal_text(a.data(), a.size(), b.data(), b.size());
+  }
+  ADD_MATCHER(equal, const char *a, const char *b) {
+    return equal_text(a, strlen(a), b, strlen(b));
+  }
+
+  // Assertions
+  using quick_unit::QU_TEST_ANCESTOR::QU_TOKEN_MERGE(QU_ASSERT,_equal);
+  ADD_ASSERTION(equal, const std::string &a, const std::string &b) {ASSERTION(equal(a, b));}
+  ADD_ASSERTION(equal, const char *a, const char *b) {ASSERTION(equal(a, b));}
+
+protected:
+  Qu_Result equal_text(const char *a, size_t a_size, const char *b, size_t b_size) {
+    if (a_size == b_size && memcmp(a, b, a_size) == 0) {
+      return result(true, "");
+    }
+    if (a_size + b_size <= 160 && !memchr(a, '\n', a_size) && !memchr(b, '\n', b_size)) {
+      return result(false, " (Expected: " + std::string(a, a_size) + ", got: " + std::string(b, b_size) + ")");
+    }
+    return result(false, QUDiff::Text(a, a_size, b, b_size));
+  }
+};
+#undef QU_TEST_ANCESTOR
+#define QU_TEST_ANCESTOR QUTestDiff
+
+} /* quick_unit */
+
+#endif	/* QUICK_UNIT_DIFF_HPP */
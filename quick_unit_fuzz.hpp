@@ -0,0 +1,389 @@
+/*
+ * quick_unit_fuzz.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit provides fuzz tests. A fuzz test receives
+ *  arbitrary bytes and must not fail, whatever they contain.
+ *
+ * FUZZ_TEST(ToIntDef copes with any text)(const uint8_t *data, size_t size) {
+ *   AnsiString text(std::string((const char *)data, size).c_str());
+ *   int a = text.ToIntDef(1);
+ *   int b = text.ToIntDef(2);
+ *   assert(a == b || (a == 1 && b == 2), SHOULD(parse or use the default));
+ * }
+ *
+ * Each fuzz test owns a corpus directory, corpus/<test name> by default
+ * (change the root with --fuzz-corpus=<dir>). Every file in it is one input.
+ * In an ordinary RUN_TESTS() the empty input and the whole corpus are
+ * replayed, so the corpus acts as a set of regression tests.
+ *
+ * The built-in mutation engine needs no extra tooling. It mutates corpus
+ * inputs at random and runs them, for as long as requested:
+ *   --fuzz[=<seconds>]   fuzz for a time (10s when no value is given)
+ *   --fuzz-runs=<n>      fuzz for a number of executions
+ *   --fuzz-seed=<n>      repeat an earlier session
+ *   --fuzz-max-len=<n>   longest input to generate (default 4096)
+ * Inputs that fail are saved into the corpus as crash-<hash> files, so they
+ * keep failing in every later run until the code is fixed.
+ * Executions per second are reported in the test output.
+ *
+ * For coverage guided fuzzing, build the same test file with clang:
+ *   clang++ -DQU_LIBFUZZER_MAIN -fsanitize=fuzzer,address ...
+ * and point libFuzzer at the corpus directory. QU_LIBFUZZER_MAIN defines
+ * libFuzzer's entry point, so when the tests are spread over several files
+ * define it in exactly one of them and QU_LIBFUZZER in the rest.
+ * libFuzzer supplies main(), so guard your own with #ifndef QU_LIBFUZZER
+ * (which QU_LIBFUZZER_MAIN defines too). Use --fuzz-target=<text> (or
+ * QU_FUZZ_TARGET) to pick the test when the binary holds more than one.
+ *
+ * The built-in engine catches failed assertions and exceptions but not
+ * crashes; those are what the libFuzzer build is for.
+ */
+
+#ifndef QUICK_UNIT_FUZZ_HPP
+#define	QUICK_UNIT_FUZZ_HPP
+
+#if defined(QU_LIBFUZZER_MAIN) && !defined(QU_LIBFUZZER)
+ #define QU_LIBFUZZER
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <time.h>
+#include <iostream>
+#include <fstream>
+#include <list>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace quick_unit {
+
+typedef std::vector<uint8_t> QUFuzzInput;
+
+/******************************************************************************/
+class QUFuzzCorpus {  // A directory holding one input per file
+/******************************************************************************/
+protected:
+  std::string _dir;
+
+public:
+  QUFuzzCorpus(const std::string &dir) : _dir(dir) {}
+  const std::string &dir() { return _dir; }
+
+  // The paths of the inputs in the corpus. Empty if there is no directory.
+  std::list<std::string> Files() {
+    std::list<std::string> files;
+    #ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((_dir + "\\*").c_str(), &entry);
+    if (find != INVALID_HANDLE_VALUE) {
+      do {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+          files.push_back(_dir + "/" + entry.cFileName);
+        }
+      } while (FindNextFileA(find, &entry));
+      FindClose(find);
+    }
+    #else
+    DIR *dir = opendir(_dir.c_str());
+    if (dir) {
+      while (struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+          files.push_back(_dir + "/" + entry->d_name);
+        }
+      }
+      closedir(dir);
+    }
+    #endif
+    files.sort(); // Replay in a repeatable order
+    return files;
+  }
+
+  static bool Read(const std::string &path, QUFuzzInput &input) {
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+      return false;
+    }
+    input.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  // Writes an input into the corpus, creating the directory if needed.
+  // Returns the path of the new file.
+  std::string Save(const QUFuzzInput &input, const char *prefix) {
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a
+    for (size_t i = 0; i < input.size(); i++) {
+      hash = (hash ^ input[i]) * 1099511628211ULL;
+    }
+    char name[40];
+    sprintf(name, "%s%08x%08x", prefix, (unsigned)(hash >> 32), (unsigned)hash);
+    MakeDirs(_dir);
+    std::string path = _dir + "/" + name;
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+    if (!input.empty()) {
+      file.write((const char *)&input[0], input.size());
+    }
+    return path;
+  }
+
+private:
+  static void MakeDirs(const std::string &path) {
+    for (size_t pos = 0; pos != std::string::npos; ) {
+      pos = path.find('/', pos + 1);
+      std::string part = path.substr(0, pos);
+      #ifdef _WIN32
+      _mkdir(part.c_str());
+      #else
+      mkdir(part.c_str(), 0777);
+      #endif
+    }
+  }
+};
+
+/******************************************************************************/
+class QUFuzzMutator {  // The built-in mutation engine
+/******************************************************************************/
+protected:
+  uint32_t _state;
+
+public:
+  QUFuzzMutator(uint32_t seed) : _state(seed ? seed : 0x9e3779b9U) {}
+
+  uint32_t Next() { // xorshift32
+    _state ^= _state << 13;
+    _state ^= _state >> 17;
+    _state ^= _state << 5;
+    return _state;
+  }
+  size_t Below(size_t n) { return n ? Next() % n : 0; }
+
+  // Applies a short stack of random edits to input. pool supplies material
+  // for splicing.
+  void Mutate(QUFuzzInput &input, const std::vector<QUFuzzInput> &pool, size_t max_len) {
+    static const uint8_t interesting[] = {0, 1, 0x7f, 0x80, 0xff, ' ', '\n', '+', '-', '0', '9', 'e', '.'};
+    unsigned edits = 1 + (unsigned)Below(4);
+    for (unsigned i = 0; i < edits; i++) {
+      size_t size = input.size();
+      switch (size ? Below(7) : 2) {
+        case 0: // flip a bit
+          input[Below(size)] ^= (uint8_t)(1U << Below(8));
+          break;
+        case 1: // random byte
+          input[Below(size)] = (uint8_t)Next();
+          break;
+        case 2: // insert an interesting byte
+          input.insert(input.begin() + Below(size + 1), interesting[Below(sizeof(interesting))]);
+          break;
+        case 3: { // erase a range
+          size_t at = Below(size);
+          input.erase(input.begin() + at, input.begin() + at + 1 + Below(size - at));
+          break;
+        }
+        case 4: { // duplicate a range
+          size_t at = Below(size);
+          QUFuzzInput chunk(input.begin() + at, input.begin() + at + 1 + Below(size - at));
+          input.insert(input.begin() + Below(size + 1), chunk.begin(), chunk.end());
+          break;
+        }
+        case 5: { // splice in part of another input
+          const QUFuzzInput &other = pool[Below(pool.size())];
+          if (!other.empty()) {
+            size_t at = Below(other.size());
+            input.insert(input.begin() + Below(size + 1), other.begin() + at, other.begin() + at + 1 + Below(other.size() - at));
+          }
+          break;
+        }
+        default: // truncate
+          input.resize(Below(size));
+          break;
+      }
+    }
+    if (input.size() > max_len) {
+      input.resize(max_len);
+    }
+  }
+};
+
+/******************************************************************************/
+class QUFuzzTest : public quick_unit::QU_TEST_ANCESTOR {  // Base for FUZZ_TEST
+/******************************************************************************/
+public:
+  QUFuzzTest(const char *msg) : quick_unit::QU_TEST_ANCESTOR(msg) {
+    Registry().push_back(this);
+  }
+  virtual void Fuzz(const uint8_t *data, size_t size) = 0; // Must be subclassed
+
+  static std::list<QUFuzzTest *> &Registry() {
+    static std::list<QUFuzzTest *> tests;
+    return tests;
+  }
+
+  // The test that a libFuzzer build should run
+  static QUFuzzTest *Target() {
+    const char *wanted = QUOptionTracker::Option("fuzz-target");
+    for (std::list<QUFuzzTest *>::iterator iter = Registry().begin(); iter != Registry().end(); ++iter) {
+      if (!wanted || (*iter)->test_name().find(wanted) != std::string::npos) {
+        return *iter;
+      }
+    }
+    return NULL;
+  }
+
+  std::string corpus_dir() {
+    const char *root = QUOptionTracker::Option("fuzz-corpus");
+    std::string dir = (root && *root) ? root : "corpus";
+    dir += "/";
+    for (std::string::const_iterator c = test_name().begin(); c != test_name().end(); ++c) {
+      dir += isalnum((unsigned char)*c) ? *c : '_';
+    }
+    return dir;
+  }
+
+  // Replays the corpus, then fuzzes if asked to
+  void Run(void) {
+    if (Replay()) {
+      QUTestFail::Raise(); // Once Replay()'s inputs are freed
+    }
+  }
+
+  // Entry point for a libFuzzer build
+  int FuzzOne(const uint8_t *data, size_t size) {
+    QUAssertionLock::ThrowsFailures() = true;
+    Reset();
+    FuzzCall call = {this, data, size};
+    if (QUTestFail::Catch(FuzzCall::Run, &call)) {
+      std::cerr << test_name() << ": FAILED. " << fail_message() << std::endl;
+      abort();
+    }
+    return 0;
+  }
+
+protected:
+  // Returns true at the first input that fails
+  bool Replay(void) {
+    QUFuzzCorpus corpus(corpus_dir());
+    std::vector<QUFuzzInput> pool(1, QUFuzzInput()); // Always try the empty input
+    std::vector<std::string> origins(1, "<empty>");
+    std::list<std::string> files = corpus.Files();
+    for (std::list<std::string>::iterator iter = files.begin(); iter != files.end(); ++iter) {
+      pool.push_back(QUFuzzInput());
+      origins.push_back(*iter);
+      if (!QUFuzzCorpus::Read(*iter, pool.back())) {
+        pool.pop_back();
+        origins.pop_back();
+      }
+    }
+
+    clock_t start = clock();
+    for (size_t i = 0; i < pool.size(); i++) {
+      if (Execute(pool[i], origins[i], NULL)) {
+        return true;
+      }
+    }
+    ReportRate("Replayed", pool.size(), start);
+
+    const char *seconds = QUOptionTracker::Option("fuzz");
+    const char *runs = QUOptionTracker::Option("fuzz-runs");
+    if (!seconds && !runs) {
+      return false;
+    }
+    double budget = seconds ? (*seconds ? atof(seconds) : 10.0) : 0.0;
+    unsigned long max_runs = runs ? strtoul(runs, NULL, 10) : 0;
+    if (budget <= 0 && !max_runs) {
+      return false;
+    }
+    const char *max_len_option = QUOptionTracker::Option("fuzz-max-len");
+    size_t max_len = max_len_option ? (size_t)strtoul(max_len_option, NULL, 10) : 4096;
+    const char *seed_option = QUOptionTracker::Option("fuzz-seed");
+    uint32_t seed = seed_option ? (uint32_t)strtoul(seed_option, NULL, 10) : (uint32_t)time(NULL);
+    Output() << "Fuzzing with --fuzz-seed=" << seed << std::endl;
+
+    QUFuzzMutator mutator(seed);
+    unsigned long executed = 0;
+    start = clock();
+    while ((!max_runs || executed < max_runs) &&
+           (budget <= 0 || (executed & 255) || (double)(clock() - start) / CLOCKS_PER_SEC < budget)) {
+      QUFuzzInput input = pool[mutator.Below(pool.size())];
+      mutator.Mutate(input, pool, max_len);
+      if (Execute(input, "<mutation>", &corpus)) {
+        return true;
+      }
+      executed++;
+    }
+    ReportRate("Fuzzed", executed, start);
+    return false;
+  }
+
+  struct FuzzCall { // Fuzz() with its input, for QUTestFail::Catch()
+    QUFuzzTest *test;
+    const uint8_t *data;
+    size_t size;
+    static void Run(void *call) {
+      FuzzCall *fuzz = (FuzzCall *)call;
+      fuzz->test->Fuzz(fuzz->data, fuzz->size);
+    }
+  };
+
+  // Runs one input, and returns true if it failed. A failing input is saved
+  // into the corpus (if given) and named in the failure message.
+  bool Execute(const QUFuzzInput &input, const std::string &origin, QUFuzzCorpus *corpus) {
+    static const uint8_t nothing = 0;
+    FuzzCall call = {this, input.empty() ? &nothing : &input[0], input.size()};
+    bool failed = false;
+    bool unexpected = false;
+    #ifdef QU_NO_EXCEPTIONS
+    failed = QUTestFail::Catch(FuzzCall::Run, &call);
+    #else
+    try {
+      failed = QUTestFail::Catch(FuzzCall::Run, &call);
+    } catch(...) {
+      unexpected = true;
+    }
+    #endif
+    if (failed) {
+      _info_message << " [input: " << (corpus ? corpus->Save(input, "crash-") : origin) << "]";
+      return true;
+    }
+    if (unexpected) {
+      std::ostringstream os;
+      os << "unexpected exception for input " << (corpus ? corpus->Save(input, "crash-") : origin) << ".";
+      force_fail_message(os.str().c_str());
+      return true;
+    }
+    _assert(Qu_Result(true));
+    return false;
+  }
+
+  void ReportRate(const char *what, size_t count, clock_t start) {
+    double duration = (double)(clock() - start) / CLOCKS_PER_SEC;
+    Output() << what << " " << count << " inputs in " << duration << "s";
+    if (duration > 0) {
+      Output() << " (" << (unsigned long)(count / duration) << " exec/s)";
+    }
+    Output() << std::endl;
+  }
+};
+
+} /* quick_unit */
+
+/******************************************************************************/
+/* Macro for creating a FUZZ_TEST. MUST be on a single line */
+#define FUZZ_TEST(name) namespace { class QU_UNIQ_ID(QUFuzzTest) : public quick_unit::QUFuzzTest {public: QU_UNIQ_ID(QUFuzzTest)() : quick_unit::QUFuzzTest(#name) {if (QUTestSuiteTracker::CurrentQUTestSuite()) {QUTestSuiteTracker::CurrentQUTestSuite()->Add(this);}} void Fuzz(const uint8_t *, size_t); } static QU_UNIQ_ID(test);} void QU_UNIQ_ID(QUFuzzTest)::Fuzz
+
+// Only in the one file that defines QU_LIBFUZZER_MAIN
+#ifdef QU_LIBFUZZER_MAIN
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static quick_unit::QUFuzzTest *target = quick_unit::QUFuzzTest::Target();
+  return target ? target->FuzzOne(data, size) : 0;
+}
+#endif
+
+#endif	/* QUICK_UNIT_FUZZ_HPP */
@@ -0,0 +1,306 @@
+/*
+ * quick_unit_golden.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit compares generated output with a saved
+ *  reference ("golden") file.
+ *
+ * TEST(The report matches the golden copy) {
+ *   std::string report = generate_report();
+ *   assert_matches_golden("golden/report.txt", report, SHOULD(not change));
+ *   assert_matches_golden("golden/image.bin", pixels, pixel_bytes, SHOULD(draw the same image));
+ * }
+ *
+ * gives failure messages such as
+ *   line 3: Should not change. (Differs from golden/report.txt at byte 5012
+ *   (line 120, column 10). Expected: ..."total: 14\nname: alp[h]a\nname: beta\n"...,
+ *   got: ..."total: 14\nname: alp[x]a\nname: beta\n"...)
+ *
+ * Binary data is shown in hex, as in quick_unit_buffers.hpp.
+ *
+ * Golden files are memory mapped rather than read, and each file is only
+ * mapped once per process however many tests use it. The comparison uses
+ * the SIMD kernel from quick_unit_buffers.hpp, a chunk at a time.
+ *
+ * Run the tests with --update-golden (or set QU_UPDATE_GOLDEN) to write
+ * the actual data over any golden file that is missing or different. Each
+ * file is written to a temporary file first and then renamed over the old
+ * one, so a golden file is never left half written.
+ */
+
+#ifndef QUICK_UNIT_GOLDEN_HPP
+#define	QUICK_UNIT_GOLDEN_HPP
+
+#include "quick_unit_buffers.hpp"
+#include <map>
+#ifdef QU_THREADS
+ #include <mutex>
+#endif
+#ifdef _WIN32
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+ #include <process.h>
+ #define getpid _getpid
+#else
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+
+namespace quick_unit {
+
+/******************************************************************************/
+class QUGoldenFile {  // A read-only mapping of a golden file
+/******************************************************************************/
+public:
+  const unsigned char *data;
+  size_t size;
+  bool exists;
+
+  // Returns the mapping for path, mapping it on first use. It stays valid,
+  // even once Update() replaces the file, so it can be read without a lock.
+  static QUGoldenFile &Mapped(const std::string &path) {
+    #ifdef QU_THREADS
+    std::lock_guard<std::mutex> hold(Lock());
+    #endif
+    Cache &files = Files();
+    Cache::iterator found = files.find(path);
+    if (found == files.end()) {
+      found = files.insert(std::make_pair(path, new QUGoldenFile(path))).first;
+    }
+    return *found->second;
+  }
+
+  // Replaces the file with new contents, via a temporary file and a rename
+  static bool Update(const std::string &path, const void *contents, size_t length) {
+    #ifdef QU_THREADS
+    std::lock_guard<std::mutex> hold(Lock()); // Threads share the temporary file's name
+    #endif
+    Forget(path);
+    std::ostringstream temporary;
+    temporary << path << ".tmp" << getpid();
+    FILE *file = fopen(temporary.str().c_str(), "wb");
+    if (!file) {
+      return false;
+    }
+    bool written = (length == 0 || fwrite(contents, 1, length, file) == length) && fflush(file) == 0;
+    #ifndef _WIN32
+    written = written && fsync(fileno(file)) == 0;
+    #endif
+    written = (fclose(file) == 0) && written;
+    #ifdef _WIN32
+    written = written && MoveFileExA(temporary.str().c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+    #else
+    written = written && rename(temporary.str().c_str(), path.c_str()) == 0;
+    #endif
+    if (!written) {
+      remove(temporary.str().c_str());
+    }
+    return written;
+  }
+
+  // Offset of the first byte that differs from actual, in chunks so that
+  // the file is paged in as it goes. Returns the shorter size if none do.
+  size_t FirstMismatch(const void *actual, size_t length) const {
+    const size_t chunk = 1 << 20;
+    size_t common = std::min(size, length);
+    for (size_t done = 0; done < common; done += chunk) {
+      size_t part = std::min(chunk, common - done);
+      size_t at = QUBufferCompare::FirstMismatch(data + done, (const unsigned char *)actual + done, part);
+      if (at < part) {
+        return done + at;
+      }
+    }
+    return common;
+  }
+
+private:
+  #ifdef _WIN32
+  HANDLE _file, _mapping;
+  #endif
+
+  struct Cache : public std::map<std::string, QUGoldenFile *> {
+    std::vector<QUGoldenFile *> forgotten; // Mappings other threads may still be reading
+    ~Cache() {
+      for (iterator i = begin(); i != end(); ++i) {
+        delete i->second;
+      }
+      for (size_t i = 0; i < forgotten.size(); i++) {
+        delete forgotten[i];
+      }
+    }
+  };
+  static Cache &Files() {
+    static Cache files;
+    return files;
+  }
+  #ifdef QU_THREADS
+  static std::mutex &Lock() {
+    static std::mutex lock;
+    return lock;
+  }
+  #endif
+  // Drops the mapping so the next use sees the file as it is now. Called
+  // with the lock held.
+  static void Forget(const std::string &path) {
+    Cache &files = Files();
+    Cache::iterator found = files.find(path);
+    if (found != files.end()) {
+      files.forgotten.push_back(found->second);
+      files.erase(found);
+    }
+  }
+
+  QUGoldenFile(const std::string &path) : data(NULL), size(0), exists(false) {
+    #ifdef _WIN32
+    _mapping = NULL;
+    _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (_file == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    exists = true;
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(_file, &file_size);
+    size = (size_t)file_size.QuadPart;
+    if (size) {
+      _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+      data = _mapping ? (const unsigned char *)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+      exists = data != NULL;
+    }
+    #else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+      return;
+    }
+    struct stat info;
+    exists = fstat(file, &info) == 0;
+    size = exists ? (size_t)info.st_size : 0;
+    if (size) {
+      void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+      exists = mapped != MAP_FAILED;
+      if (exists) {
+        data = (const unsigned char *)mapped;
+        madvise(mapped, size, MADV_SEQUENTIAL);
+      }
+    }
+    close(file); // The mapping keeps the contents
+    #endif
+    if (!exists) {
+      size = 0;
+    }
+  }
+  ~QUGoldenFile() {
+    #ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (_mapping) CloseHandle(_mapping);
+    if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+    #else
+    if (data) munmap((void *)data, size);
+    #endif
+  }
+};
+
+/******************************************************************************/
+class QUTestGolden : public quick_unit::QU_TEST_ANCESTOR {
+/******************************************************************************/
+public:
+  QUTestGolden(const char *msg) : quick_unit::QU_TEST_ANCESTOR(msg) {}
+
+  enum { text_window = 20 }; // Characters shown either side of a difference
+
+  // Result matchers: golden files
+  ADD_MATCHER(matches_golden, const char *path, const void *actual, size_t size) {
+    QUGoldenFile &golden = QUGoldenFile::Mapped(path);
+    size_t at = golden.FirstMismatch(actual, size);
+    if (golden.exists && at == golden.size && at == size) {
+      return result(true, "");
+    }
+    _expectation_builder.str("");
+    if (QUOptionTracker::Option("update-golden")) {
+      if (QUGoldenFile::Update(path, actual, size)) {
+        printf("Updated golden file %s\n", path);
+        return result(true, "");
+      }
+      _expectation_builder << " (Could not update golden file " << path << ")";
+    } else if (!golden.exists) {
+      _expectation_builder << " (Golden file " << path << " is missing. Run with --update-golden to create it)";
+    } else {
+      describe_golden_difference(path, golden.data, golden.size, (const unsigned char *)actual, size, at);
+    }
+    _expectation = _expectation_builder.str();
+    return result(false, _expectation);
+  }
+  ADD_MATCHER(matches_golden, const char *path, const std::string &actual) {
+    return matches_golden(path, actual.data(), actual.size());
+  }
+
+  // Assertions
+  ADD_ASSERTION(matches_golden, const char *path, const void *actual, size_t size) {ASSERTION(matches_golden(path, actual, size));}
+  ADD_ASSERTION(matches_golden, const char *path, const std::string &actual) {ASSERTION(matches_golden(path, actual));}
+
+protected:
+  void describe_golden_difference(const char *path, const unsigned char *expected, size_t expected_size, const unsigned char *actual, size_t actual_size, size_t at) {
+    size_t line = 1;
+    const unsigned char *line_start = expected;
+    for (const unsigned char *c = expected; (c = (const unsigned char *)memchr(c, '\n', expected + at - c)) != NULL; line_start = ++c) {
+      line++;
+    }
+    _expectation_builder << " (Differs from " << path << " at byte " << at << " (line " << line << ", column " << 1 + (expected + at - line_start) << ").";
+    if (expected_size != actual_size) {
+      _expectation_builder << " Expected " << expected_size << " bytes, got " << actual_size << ".";
+    }
+    size_t first = at > text_window ? at - text_window : 0;
+    size_t expected_end = std::min(expected_size, at + text_window + 1);
+    size_t actual_end = std::min(actual_size, at + text_window + 1);
+    if (is_text(expected + first, expected_end - first) && is_text(actual + first, actual_end - first)) {
+      _expectation_builder << " Expected: ";
+      describe_text(expected, first, at, expected_end, expected_size);
+      _expectation_builder << ", got: ";
+      describe_text(actual, first, at, actual_end, actual_size);
+    } else {
+      first = at > window ? at - window : 0;
+      _expectation_builder << " Expected: ";
+      describe_window(expected + first, std::min(expected_size, at + window + 1) - std::min(expected_size, first), at - first, first > 0, at + window + 1 < expected_size);
+      _expectation_builder << ", got: ";
+      describe_window(actual + first, std::min(actual_size, at + window + 1) - std::min(actual_size, first), at - first, first > 0, at + window + 1 < actual_size);
+    }
+    _expectation_builder << ")";
+  }
+
+  static bool is_text(const unsigned char *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      if (data[i] < 0x20 && data[i] != '\n' && data[i] != '\r' && data[i] != '\t') {
+        return false;
+      }
+    }
+    return true;
+  }
+  // Quotes data[first, end), escaping newlines and tabs and marking the byte at 'mark'
+  void describe_text(const unsigned char *data, size_t first, size_t mark, size_t end, size_t size) {
+    if (first > 0) _expectation_builder << "...";
+    _expectation_builder << "\"";
+    for (size_t i = first; i < end; i++) {
+      if (i == mark) _expectation_builder << "[";
+      switch (data[i]) {
+        case '\n': _expectation_builder << "\\n"; break;
+        case '\r': _expectation_builder << "\\r"; break;
+        case '\t': _expectation_builder << "\\t"; break;
+        default: _expectation_builder << (char)data[i];
+      }
+      if (i == mark) _expectation_builder << "]";
+    }
+    if (mark >= end) _expectation_builder << "[end]";
+    _expectation_builder << "\"";
+    if (end < size) _expectation_builder << "...";
+  }
+};
+#undef QU_TEST_ANCESTOR
+#define QU_TEST_ANCESTOR QUTestGolden
+
+} /* quick_unit */
+
+#endif	/* QUICK_UNIT_GOLDEN_HPP */
@@ -0,0 +1,419 @@
+/*
+ * quick_unit_interleave.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit explores the ways that threads can interleave,
+ *  to find races that only show up one run in thousands. It needs C++11.
+ *
+ * TEST(Concurrent deposits are not lost) {
+ *   Account account;
+ *   explore_interleavings(2,
+ *     [&] { account.balance = 0; },                   // Before each schedule
+ *     [&](unsigned thread) { account.Deposit(10); },  // On every thread
+ *     [&] { assert_equal(20, account.balance, SHOULD(keep both deposits)); });
+ * }
+ *
+ * The threads run one at a time, and only change over where the code says
+ * they may: at QU_YIELD(), and when a QUMutex is locked or unlocked. Put
+ * QU_YIELD() between the steps of the code under test that could race:
+ *
+ *   void Account::Deposit(int amount) {
+ *     int seen = balance;
+ *     QU_YIELD();
+ *     balance = seen + amount;
+ *   }
+ *
+ * Outside explore_interleavings() QU_YIELD() does nothing and a QUMutex is
+ * an ordinary mutex, so the code under test can keep them. Define QU_YIELD()
+ * as nothing in builds that do not include this file.
+ *
+ * Each schedule is a different choice of which thread runs after each
+ * yield. By default 1000 random schedules are tried (--interleave-schedules
+ * changes the number). A failure gives the seed of the schedule that failed,
+ * e.g. [schedule --interleave-seed=3735928559], and running with that seed
+ * replays it exactly. --interleave=all searches the schedules in order
+ * instead, and says when it has tried them all; its failures replay with
+ * --interleave-choices=<list>.
+ *
+ * A schedule fails if an assertion fails on any thread or in the final
+ * check, or if every thread is left waiting for a QUMutex (a deadlock).
+ * The number of schedules explored per second is given in the test output.
+ * Threads must not block on anything else, such as a std::mutex, as the
+ * scheduler cannot see it.
+ */
+
+#ifndef QUICK_UNIT_INTERLEAVE_HPP
+#define	QUICK_UNIT_INTERLEAVE_HPP
+
+#ifndef QU_THREADS
+ #error quick_unit_interleave.hpp needs C++11
+#endif
+#ifdef QU_NO_EXCEPTIONS
+ #error quick_unit_interleave.hpp needs exceptions, to stop threads in a deadlock
+#endif
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define QU_YIELD() quick_unit::QUScheduler::Yield()
+
+namespace quick_unit {
+
+class QUMutex;
+
+/******************************************************************************/
+class QUScheduler {  // Runs threads one at a time, in a chosen order
+/******************************************************************************/
+public:
+  enum { runnable, blocked, finished };
+
+  // Thrown into the threads of a schedule that has to be abandoned
+  struct Abandoned {};
+
+  // A place where another thread may run. Does nothing outside a schedule.
+  static void Yield() {
+    QUScheduler *scheduler = Current();
+    if (scheduler) {
+      std::unique_lock<std::mutex> hold(scheduler->_lock);
+      scheduler->Switch(hold);
+    }
+  }
+
+  // The scheduler running this thread, if any
+  static QUScheduler *&Current() {
+    static thread_local QUScheduler *current = NULL;
+    return current;
+  }
+
+  // choices: the start of the schedule to follow. After that, decisions
+  // are random if random is set, otherwise the running thread carries on.
+  QUScheduler(unsigned threads, const std::vector<unsigned> &choices, bool random, uint32_t seed) :
+      _turns(threads), _state(threads, runnable), _waiting_for(threads, (QUMutex *)NULL), _prefix(choices),
+      _random(random), _rng(Scramble(seed)), _running((unsigned)-1), _done(0), _deadlocked(false), _abandoned(false) {}
+
+  // Runs body on each thread under this schedule
+  void Run(const std::function<void(unsigned)> &body) {
+    std::vector<std::thread> workers;
+    for (unsigned thread = 0; thread < _state.size(); thread++) {
+      workers.push_back(std::thread(&QUScheduler::Work, this, thread, std::cref(body)));
+    }
+    {
+      std::unique_lock<std::mutex> hold(_lock);
+      _running = Choose(0);
+      _turns[_running].notify_one();
+      _finished.wait(hold, [this] { return _done == _state.size(); });
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+      workers[i].join();
+    }
+  }
+
+  // The decisions made, and how many threads there were to choose from
+  const std::vector<unsigned> &choices() const { return _choices; }
+  const std::vector<unsigned> &options() const { return _options; }
+  bool deadlocked() const { return _deadlocked; }
+  // Set if an exception other than a failed assertion ended a thread
+  const std::string &unexpected() const { return _unexpected; }
+
+  // Called by QUMutex
+  void Lock(QUMutex *mutex);
+  void Unlock(QUMutex *mutex);
+
+private:
+  std::mutex _lock;
+  std::vector<std::condition_variable> _turns; // One per thread, to wake just the next one
+  std::condition_variable _finished;
+  std::vector<int> _state;
+  std::vector<QUMutex *> _waiting_for;
+  std::vector<unsigned> _prefix, _choices, _options;
+  bool _random;
+  uint32_t _rng;
+  unsigned _running;
+  unsigned _done;
+  bool _deadlocked, _abandoned;
+  std::string _unexpected;
+  enum { max_decisions = 100000 }; // After this, threads take turns: nothing is spinning forever
+
+  // Seeds next to each other give unrelated schedules
+  static uint32_t Scramble(uint32_t seed) {
+    seed = (seed ^ (seed >> 16)) * 0x45d9f3bU;
+    seed = (seed ^ (seed >> 16)) * 0x45d9f3bU;
+    seed ^= seed >> 16;
+    return seed ? seed : 0x9e3779b9U;
+  }
+
+  static unsigned &Thread() {
+    static thread_local unsigned thread = 0;
+    return thread;
+  }
+
+  void Work(unsigned thread, const std::function<void(unsigned)> &body) {
+    Current() = this;
+    Thread() = thread;
+    std::ostringstream name;
+    name << "thread " << thread;
+    QUAssertionLock::ThreadName() = name.str();
+    QUAssertionLock::ThrowsFailures() = true;
+    try {
+      {
+        std::unique_lock<std::mutex> hold(_lock);
+        WaitForTurn(hold);
+      }
+      body(thread);
+    } catch(QUTestFail * /*err*/) {
+      // Recorded by the assertion
+    } catch(Abandoned &) {
+    } catch(...) {
+      std::unique_lock<std::mutex> hold(_lock);
+      _unexpected = name.str() + ": unexpected exception in the test.";
+    }
+    std::unique_lock<std::mutex> hold(_lock);
+    _state[thread] = finished;
+    _done++;
+    Current() = NULL;
+    if (_done == _state.size()) {
+      _finished.notify_one();
+    } else if (!_abandoned) {
+      PassOn(hold);
+    }
+  }
+
+  // The next thread to run, from those that can. The current thread, if it
+  // can carry on, is option 0.
+  unsigned Choose(unsigned current) {
+    std::vector<unsigned> ready;
+    if (_state[current] == runnable) {
+      ready.push_back(current);
+    }
+    for (unsigned thread = 0; thread < _state.size(); thread++) {
+      if (thread != current && _state[thread] == runnable) {
+        ready.push_back(thread);
+      }
+    }
+    if (ready.empty()) {
+      return (unsigned)-1;
+    }
+    if (ready.size() == 1) {
+      return ready[0];
+    }
+    if (_choices.size() >= max_decisions) {
+      return ready[1]; // Someone else, unrecorded
+    }
+    unsigned choice = 0;
+    if (_choices.size() < _prefix.size()) {
+      choice = _prefix[_choices.size()] % ready.size();
+    } else if (_random) {
+      _rng ^= _rng << 13; // xorshift32
+      _rng ^= _rng >> 17;
+      _rng ^= _rng << 5;
+      choice = _rng % ready.size();
+    }
+    _choices.push_back(choice);
+    _options.push_back((unsigned)ready.size());
+    return ready[choice];
+  }
+
+  // Lets the chosen thread run, and waits for this one's next turn
+  void Switch(std::unique_lock<std::mutex> &hold) {
+    if (_abandoned) {
+      throw Abandoned();
+    }
+    PassOn(hold);
+    WaitForTurn(hold);
+  }
+
+  void PassOn(std::unique_lock<std::mutex> &hold) {
+    unsigned next = Choose(Thread());
+    if (next == (unsigned)-1) {
+      // Nobody can run, but not everybody has finished
+      _deadlocked = true;
+      _abandoned = true;
+      for (size_t thread = 0; thread < _turns.size(); thread++) {
+        _turns[thread].notify_one();
+      }
+    } else if (next != Thread()) {
+      _running = next;
+      _turns[next].notify_one();
+    }
+  }
+
+  void WaitForTurn(std::unique_lock<std::mutex> &hold) {
+    unsigned me = Thread();
+    _turns[me].wait(hold, [this, me] { return _abandoned || (_running == me && _state[me] == runnable); });
+    if (_abandoned) {
+      throw Abandoned();
+    }
+  }
+};
+
+/******************************************************************************/
+class QUMutex {  // A mutex that the scheduler can see
+/******************************************************************************/
+public:
+  QUMutex() : _owner(-1) {}
+
+  void lock() {
+    QUScheduler *scheduler = QUScheduler::Current();
+    if (scheduler) {
+      scheduler->Lock(this);
+    } else {
+      _real.lock();
+    }
+  }
+  void unlock() {
+    QUScheduler *scheduler = QUScheduler::Current();
+    if (scheduler) {
+      scheduler->Unlock(this);
+    } else {
+      _real.unlock();
+    }
+  }
+
+private:
+  friend class QUScheduler;
+  std::mutex _real;
+  int _owner;  // The thread holding it, in a schedule
+
+  QUMutex(const QUMutex &);
+  QUMutex &operator=(const QUMutex &);
+};
+
+inline void QUScheduler::Lock(QUMutex *mutex) {
+  std::unique_lock<std::mutex> hold(_lock);
+  Switch(hold); // Others may get there first
+  while (mutex->_owner >= 0) {
+    _state[Thread()] = blocked;
+    _waiting_for[Thread()] = mutex;
+    Switch(hold);
+  }
+  mutex->_owner = (int)Thread();
+}
+
+inline void QUScheduler::Unlock(QUMutex *mutex) {
+  std::unique_lock<std::mutex> hold(_lock);
+  mutex->_owner = -1;
+  for (size_t thread = 0; thread < _state.size(); thread++) {
+    if (_state[thread] == blocked && _waiting_for[thread] == mutex) {
+      _state[thread] = runnable;
+      _waiting_for[thread] = NULL;
+    }
+  }
+  if (!_abandoned) { // Or this may be a lock_guard unwinding from Abandoned
+    Switch(hold);
+  }
+}
+
+/******************************************************************************/
+class QUTestInterleave : public quick_unit::QU_TEST_ANCESTOR {
+/******************************************************************************/
+public:
+  QUTestInterleave(const char *msg) : quick_unit::QU_TEST_ANCESTOR(msg) {}
+
+  // Runs setup, then body on each of the threads, then check, for each
+  // schedule explored
+  void explore_interleavings(unsigned threads, std::function<void()> setup, std::function<void(unsigned)> body, std::function<void()> check) {
+    const char *mode = QUOptionTracker::Option("interleave");
+    const char *count_option = QUOptionTracker::Option("interleave-schedules");
+    const char *seed_option = QUOptionTracker::Option("interleave-seed");
+    const char *choices_option = QUOptionTracker::Option("interleave-choices");
+    bool random = seed_option || (!(mode && strcmp(mode, "all") == 0) && !choices_option);
+    unsigned long schedules = (seed_option || choices_option) ? 1 : (count_option ? strtoul(count_option, NULL, 10) : 1000);
+    uint32_t seed = seed_option ? (uint32_t)strtoul(seed_option, NULL, 10) : (uint32_t)time(NULL);
+
+    std::vector<unsigned> prefix;
+    for (const char *c = choices_option; c && *c; c += (*c == ',')) {
+      prefix.push_back((unsigned)strtoul(c, (char **)&c, 10));
+    }
+    unsigned long explored = 0;
+    bool exhausted = false;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (explored < schedules && !exhausted) {
+      uint32_t schedule_seed = seed + (uint32_t)explored;
+      QUScheduler scheduler(threads, prefix, random, schedule_seed);
+      setup();
+      scheduler.Run(body);
+      explored++;
+      std::string replay = random ? "--interleave-seed=" + Number(schedule_seed) : "--interleave-choices=" + Choices(scheduler.choices());
+      if (!scheduler.unexpected().empty()) {
+        force_fail_message(scheduler.unexpected().c_str());
+        Failed(replay, explored, start);
+      }
+      if (scheduler.deadlocked()) {
+        force_fail_message("Deadlock: every thread that had not finished was waiting for a QUMutex.");
+        Failed(replay, explored, start);
+      }
+      if (_fails) {
+        Failed(replay, explored, start);
+      }
+      try {
+        check();
+      } catch(QUTestFail * /*err*/) {
+        Failed(replay, explored, start);
+      }
+      if (!random) {
+        exhausted = !Next(scheduler, prefix);
+      }
+    }
+    Report(explored, start, exhausted);
+  }
+
+protected:
+  // Adds the schedule to the failure message, and ends the test
+  void Failed(const std::string &replay, unsigned long explored, std::chrono::steady_clock::time_point start) {
+    _info_message << " [schedule " << replay << "]";
+    Report(explored, start, false);
+    throw new QUTestFail();
+  }
+
+  void Report(unsigned long explored, std::chrono::steady_clock::time_point start, bool exhausted) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Output() << "Explored " << explored << (exhausted ? " (all)" : "") << " schedules in " << seconds << "s";
+    if (seconds > 0) {
+      Output() << " (" << (unsigned long)(explored / seconds) << " schedules/s)";
+    }
+    Output() << std::endl;
+  }
+
+  // Moves prefix on to the next schedule, depth first. False when there
+  // are none left.
+  static bool Next(const QUScheduler &scheduler, std::vector<unsigned> &prefix) {
+    std::vector<unsigned> choices = scheduler.choices();
+    const std::vector<unsigned> &options = scheduler.options();
+    while (!choices.empty() && choices.back() + 1 >= options[choices.size() - 1]) {
+      choices.pop_back();
+    }
+    if (choices.empty()) {
+      return false;
+    }
+    choices.back()++;
+    prefix = choices;
+    return true;
+  }
+
+  static std::string Number(unsigned long n) {
+    std::ostringstream os;
+    os << n;
+    return os.str();
+  }
+  static std::string Choices(const std::vector<unsigned> &choices) {
+    std::ostringstream os;
+    for (size_t i = 0; i < choices.size(); i++) {
+      os << (i ? "," : "") << choices[i];
+    }
+    return os.str();
+  }
+};
+#undef QU_TEST_ANCESTOR
+#define QU_TEST_ANCESTOR QUTestInterleave
+
+} /* quick_unit */
+
+#endif	/* QUICK_UNIT_INTERLEAVE_HPP */
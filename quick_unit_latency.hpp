@@ -0,0 +1,254 @@
+/*
+ * quick_unit_latency.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit checks how long code takes, call by call, for
+ *  code where one slow call in a hundred matters as much as the average.
+ *  It needs C++11.
+ *
+ * TEST(Lookups stay quick) {
+ *   Cache cache = warm_cache();
+ *   assert_latency([&] { cache.find("key"); }, 10000,
+ *                  p50 < std::chrono::microseconds(2), p99 < std::chrono::microseconds(20),
+ *                  SHOULD(find keys quickly));
+ * }
+ *
+ * assert_latency(fn, iterations, bounds...) calls fn iterations times,
+ * timing each call, and passes if every bound holds. A bound is one of p50,
+ * p90, p99, p999 (99.9%) or pmax, then < and a std::chrono duration. Up to
+ * four bounds can be given. A failure lists the percentiles:
+ *
+ *   line 4: Should find keys quickly. (p99 was not under 20.00us. 10000 calls:
+ *     p50           1.20us
+ *     p90           1.85us
+ *     p99          31.74us  (over 20.00us)
+ *     p99.9        88.06us
+ *     max         140.29us)
+ *
+ * The times go into a QUHistogram: HDR-style buckets, 128 to each power of
+ * two, so each time is kept to within 1% in a fixed 58KB and recording one
+ * is a shift and an add. last_latency() gives the histogram from the last
+ * assert_latency. Its p50, p90, p99, p99.9 and max also go to the reporters
+ * as RECORD_VALUEs ("latency p99" in ns), so they can be followed from run
+ * to run.
+ */
+
+#ifndef QUICK_UNIT_LATENCY_HPP
+#define	QUICK_UNIT_LATENCY_HPP
+
+#ifndef QU_THREADS
+ #error quick_unit_latency.hpp needs C++11
+#endif
+
+#include <chrono>
+#include <vector>
+#include <stdint.h>
+
+namespace quick_unit {
+
+/******************************************************************************/
+class QUHistogram {  // Times in nanoseconds, in log-linear buckets
+/******************************************************************************/
+public:
+  enum { sub_bits = 7, sub_buckets = 1 << sub_bits, buckets = (64 - sub_bits) * sub_buckets + sub_buckets };
+
+  QUHistogram() : _counts(buckets, 0), _count(0), _min(UINT64_MAX), _max(0), _total(0) {}
+
+  void Record(uint64_t ns) {
+    _counts[Bucket(ns)]++;
+    _count++;
+    _total += (double)ns;
+    if (ns < _min) _min = ns;
+    if (ns > _max) _max = ns;
+  }
+  void Clear(void) {
+    std::fill(_counts.begin(), _counts.end(), 0);
+    _count = 0;
+    _min = UINT64_MAX;
+    _max = 0;
+    _total = 0;
+  }
+
+  uint64_t count(void) const { return _count; }
+  uint64_t min(void) const { return _count ? _min : 0; }
+  uint64_t max(void) const { return _max; }
+  double mean(void) const { return _count ? _total / (double)_count : 0; }
+
+  // The time that percentile of the calls took at most: the top of its
+  // bucket, so never less than the true value
+  uint64_t Percentile(double percentile) const {
+    if (!_count) {
+      return 0;
+    }
+    uint64_t wanted = (uint64_t)(percentile / 100.0 * (double)_count + 0.5);
+    wanted = wanted < 1 ? 1 : (wanted > _count ? _count : wanted);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < _counts.size(); bucket++) {
+      seen += _counts[bucket];
+      if (seen >= wanted) {
+        uint64_t top = Top(bucket);
+        return top < _max ? top : _max;
+      }
+    }
+    return _max;
+  }
+
+  // Bucket b holds (b % 128 + 128) << shift up to the next one, where the
+  // first 256 buckets hold one time each
+  static size_t Bucket(uint64_t ns) {
+    unsigned shift = Log2(ns | (sub_buckets - 1)) - (sub_bits - 1);
+    shift = shift ? shift - 1 : 0;
+    return (size_t)shift * sub_buckets + (size_t)(ns >> shift);
+  }
+  static uint64_t Top(size_t bucket) {
+    if (bucket < 2 * sub_buckets) {
+      return bucket;
+    }
+    unsigned shift = (unsigned)(bucket / sub_buckets) - 1;
+    uint64_t first = (uint64_t)(bucket - shift * sub_buckets);
+    return ((first + 1) << shift) - 1;
+  }
+
+  // "850ns", "12.30us", "4.56ms" or "1.23s"
+  static std::string Describe(uint64_t ns) {
+    char text[32];
+    if (ns < 1000) {
+      snprintf(text, sizeof(text), "%lluns", (unsigned long long)ns);
+    } else if (ns < 1000000) {
+      snprintf(text, sizeof(text), "%.2fus", ns / 1e3);
+    } else if (ns < 1000000000) {
+      snprintf(text, sizeof(text), "%.2fms", ns / 1e6);
+    } else {
+      snprintf(text, sizeof(text), "%.2fs", ns / 1e9);
+    }
+    return text;
+  }
+
+private:
+  std::vector<uint64_t> _counts;
+  uint64_t _count;
+  uint64_t _min;
+  uint64_t _max;
+  double _total;
+
+  static unsigned Log2(uint64_t value) {
+    #if defined(__GNUC__) || defined(__clang__)
+    return 63 - (unsigned)__builtin_clzll(value);
+    #else
+    unsigned log = 0;
+    while (value >>= 1) {
+      log++;
+    }
+    return log;
+    #endif
+  }
+};
+
+/******************************************************************************/
+struct QULatencyBound {  // p99 < 20us
+/******************************************************************************/
+  double percentile;
+  const char *name;
+  uint64_t limit;     // ns
+};
+
+/******************************************************************************/
+struct QUPercentile {  // p50, p90, p99, p999 and pmax, to make bounds with
+/******************************************************************************/
+  double percentile;
+  const char *name;
+
+  template <class Rep, class Period> QULatencyBound operator<(std::chrono::duration<Rep, Period> limit) const {
+    QULatencyBound bound = {percentile, name, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(limit).count()};
+    return bound;
+  }
+};
+
+/******************************************************************************/
+class QUTestLatency : public quick_unit::QU_TEST_ANCESTOR {
+/******************************************************************************/
+public:
+  QUTestLatency(const char *msg) : quick_unit::QU_TEST_ANCESTOR(msg) {}
+
+  const QUPercentile p50 = {50, "p50"};
+  const QUPercentile p90 = {90, "p90"};
+  const QUPercentile p99 = {99, "p99"};
+  const QUPercentile p999 = {99.9, "p99.9"};
+  const QUPercentile pmax = {100, "max"};
+
+  const QUHistogram &last_latency(void) const { return _latency; }
+
+  // Result matchers: latency
+  // Matchers run without the assertion lock, so the calls are timed into a
+  // histogram of this call's own, which is kept once they are done
+  template <class Fn> ADD_MATCHER(latency_within, Fn &&fn, unsigned long iterations, const QULatencyBound *bounds, size_t bound_count) {
+    QUHistogram latency;
+    for (unsigned long i = 0; i < iterations; i++) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      fn();
+      std::chrono::steady_clock::duration taken = std::chrono::steady_clock::now() - start;
+      latency.Record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(taken).count());
+    }
+    {
+      QUAssertionLock lock;
+      _latency = latency;
+    }
+    static const QUPercentile shown[] = {{50, "p50"}, {90, "p90"}, {99, "p99"}, {99.9, "p99.9"}, {100, "max"}};
+    for (size_t i = 0; i < sizeof(shown) / sizeof(shown[0]); i++) {
+      std::string metric = std::string("latency ") + shown[i].name;
+      record_value(metric.c_str(), (double)latency.Percentile(shown[i].percentile), "ns");
+    }
+    const QULatencyBound *broken = NULL;
+    for (size_t i = 0; i < bound_count && !broken; i++) {
+      if (latency.Percentile(bounds[i].percentile) >= bounds[i].limit) {
+        broken = &bounds[i];
+      }
+    }
+    if (!broken) {
+      return result(true, "");
+    }
+    _expectation_builder.str("");
+    _expectation_builder << " (" << broken->name << " was not under " << QUHistogram::Describe(broken->limit) << ". " << latency.count() << " calls:";
+    for (size_t i = 0; i < sizeof(shown) / sizeof(shown[0]); i++) {
+      std::string time = QUHistogram::Describe(latency.Percentile(shown[i].percentile));
+      _expectation_builder << "\n  " << shown[i].name << std::string(10 - strlen(shown[i].name) + 10 - std::min<size_t>(10, time.length()), ' ') << time;
+      for (size_t b = 0; b < bound_count; b++) {
+        if (bounds[b].percentile == shown[i].percentile && latency.Percentile(bounds[b].percentile) >= bounds[b].limit) {
+          _expectation_builder << "  (over " << QUHistogram::Describe(bounds[b].limit) << ")";
+          break;
+        }
+      }
+    }
+    _expectation_builder << ")";
+    _expectation = _expectation_builder.str();
+    return result(false, _expectation);
+  }
+
+  // Assertions
+  template <class Fn> ADD_ASSERTION(latency, Fn &&fn, unsigned long iterations, QULatencyBound a) {
+    QULatencyBound bounds[] = {a};
+    ASSERTION(latency_within(fn, iterations, bounds, 1));
+  }
+  template <class Fn> ADD_ASSERTION(latency, Fn &&fn, unsigned long iterations, QULatencyBound a, QULatencyBound b) {
+    QULatencyBound bounds[] = {a, b};
+    ASSERTION(latency_within(fn, iterations, bounds, 2));
+  }
+  template <class Fn> ADD_ASSERTION(latency, Fn &&fn, unsigned long iterations, QULatencyBound a, QULatencyBound b, QULatencyBound c) {
+    QULatencyBound bounds[] = {a, b, c};
+    ASSERTION(latency_within(fn, iterations, bounds, 3));
+  }
+  template <class Fn> ADD_ASSERTION(latency, Fn &&fn, unsigned long iterations, QULatencyBound a, QULatencyBound b, QULatencyBound c, QULatencyBound d) {
+    QULatencyBound bounds[] = {a, b, c, d};
+    ASSERTION(latency_within(fn, iterations, bounds, 4));
+  }
+
+private:
+  QUHistogram _latency;
+};
+#undef QU_TEST_ANCESTOR
+#define QU_TEST_ANCESTOR QUTestLatency
+
+} /* quick_unit */
+
+#endif	/* QUICK_UNIT_LATENCY_HPP */
@@ -22,33 +22,38 @@
 #ifndef QUICK_UNIT_NETBEANS_HPP
 #define	QUICK_UNIT_NETBEANS_HPP
 
+#include <algorithm>
+
 BEGIN_REPORTER(Netbeans)
-//  void StartingSuite(const std::string &suite_name) {
-//  }
-  void StartedSuite(const std::string &suite_name)  {
-    Output() << "%SUITE_STARTING% " << suite_name << std::endl;
+  void StartedSuiteById(QUNameId suite)  {
+    Output() << "%SUITE_STARTING% " << QUNames::Name(suite) << std::endl;
     Output() << "%SUITE_STARTED%" << std::endl;
   }
-  void StoppingSuite(const std::string &suite_name, double duration, unsigned passes, unsigned fails) {
+  void StoppingSuiteById(QUNameId suite, double duration, unsigned passes, unsigned fails) {
     Output() << std::endl << "%SUITE_FINISHED% time=" << std::fixed << duration << std::endl << std::endl;
   }
-  void StartingTest(const std::string &suite_name, const std::string &test_name) {
-    Output() << "%TEST_STARTED% " << without_whitespace(test_name) << " (" << suite_name << ")" << std::endl;
+  void StartingTestById(QUNameId suite, QUNameId test) {
+    Output() << "%TEST_STARTED% " << QUNames::Form(test, Sanitized()) << " (" << QUNames::Name(suite) << ")" << std::endl;
   }
-  void FailedTest(const std::string &suite_name, const std::string &test_name, double duration, const std::string &fail_message) {
-    Output() << "%TEST_FAILED% time=" << std::fixed << duration << " testname=" << without_whitespace(test_name) << " (" << suite_name << ") message=" << fail_message << std::endl;
+  void FailedTestById(QUNameId suite, QUNameId test, double duration, const std::string &fail_message) {
+    Output() << "%TEST_FAILED% time=" << std::fixed << duration << " testname=" << QUNames::Form(test, Sanitized()) << " (" << QUNames::Name(suite) << ") message=" << fail_message << std::endl;
   }
-  void CompletedTest(const std::string &suite_name, const std::string &test_name, double duration) {
-    Output() << "%TEST_FINISHED% time=" << std::fixed << duration << " " << without_whitespace(test_name) << " (" << suite_name << ")" << std::endl;
+  void CompletedTestById(QUNameId suite, QUNameId test, double duration) {
+    Output() << "%TEST_FINISHED% time=" << std::fixed << duration << " " << QUNames::Form(test, Sanitized()) << " (" << QUNames::Name(suite) << ")" << std::endl;
   }
 
 private:
-  // Netbeans doesn't like spaces in status lines
-  std::string without_whitespace(const std::string &str) {
+  // Netbeans doesn't like spaces in status lines, so each test name gets a
+  // form without them, made once
+  static std::string without_whitespace(const std::string &str) {
     std::string rep(str);
     std::replace( rep.begin(), rep.end(), ' ', '_' );
     return rep;
   }
+  static unsigned Sanitized() {
+    static unsigned form = QUNames::AddForm(without_whitespace);
+    return form;
+  }
 END_REPORTER()
 
 ADDITIONAL_REPORTER(Netbeans)
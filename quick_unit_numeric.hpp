@@ -0,0 +1,323 @@
+/*
+ * quick_unit_numeric.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit provides approximate comparisons for floating
+ *  point results, where assert_equal's == is too strict.
+ *
+ * TEST(The filter keeps its gain) {
+ *   assert_near(1.0, gain(), 1e-9, SHOULD(have unit gain));
+ *
+ *   std::vector<double> expected = reference_output();
+ *   std::vector<double> actual = filter(input);
+ *   assert_all_close(expected, actual, 1e-6, 1e-12, SHOULD(match the reference));
+ *   assert_all_close_ulps(&expected[0], &actual[0], 16, 4, SHOULD(match the first 16 closely));
+ * }
+ *
+ * assert_near(expected, actual, tolerance) passes if |actual - expected| <= tolerance.
+ *
+ * assert_all_close(expected, actual, rtol, atol) checks every element of two
+ * std::vectors, or of two arrays given as pointers and a count, and passes if
+ * each |actual - expected| <= atol + rtol * |expected|.
+ *
+ * assert_all_close_ulps(expected, actual, max_ulps) passes if each actual
+ * value is at most max_ulps representable values away from its expected one.
+ *
+ * NaN is never close to anything. Arrays of float and double are checked in
+ * a single SIMD pass (using AVX2 when the CPU has it) which counts the
+ * values out of tolerance and finds the largest error:
+ *
+ *   line 6: Should match the reference. (3 of 4096 values out of tolerance.
+ *   Largest error 0.25 at index 17: expected 1, got 1.25. rtol 1e-06, atol 1e-12)
+ *
+ * Only float and double arrays are supported.
+ */
+
+#ifndef QUICK_UNIT_NUMERIC_HPP
+#define	QUICK_UNIT_NUMERIC_HPP
+
+#include <vector>
+#include <limits>
+#include <math.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+ #define QU_VECTOR_EXTENSIONS // GCC/Clang portable SIMD types
+ #if defined(__x86_64__) || defined(__i386__)
+  #define QU_NUMERIC_AVX2_DISPATCH // Built for AVX2 as well, used if the CPU has it
+ #endif
+#endif
+
+namespace quick_unit {
+
+/******************************************************************************/
+struct QUCloseness {  // The outcome of comparing two arrays
+/******************************************************************************/
+  size_t violations;  // Values out of tolerance
+  size_t worst;       // Index of the largest error
+  double max_error;   // The largest error: absolute, or in ULPs
+
+  QUCloseness() : violations(0), worst(0), max_error(0) {}
+
+  void Add(size_t index, double error, bool violation) {
+    if (violation) {
+      violations++;
+    }
+    if (error > max_error) {
+      max_error = error;
+      worst = index;
+    }
+  }
+};
+
+#ifdef QU_VECTOR_EXTENSIONS
+// SIMD lane types: one 256 bit vector of values, and the same bits as integers
+template <class T> struct QUNumericLanes {};
+template <> struct QUNumericLanes<double> {
+  typedef double Values __attribute__((vector_size(32)));
+  typedef long long Masks __attribute__((vector_size(32)));
+  typedef unsigned long long Bits __attribute__((vector_size(32)));
+  typedef unsigned long long Word;
+  enum { width = 4 };
+};
+template <> struct QUNumericLanes<float> {
+  typedef float Values __attribute__((vector_size(32)));
+  typedef int Masks __attribute__((vector_size(32)));
+  typedef unsigned int Bits __attribute__((vector_size(32)));
+  typedef unsigned int Word;
+  enum { width = 8 };
+};
+#endif
+
+/******************************************************************************/
+template <class T> class QUCloseCompare {  // Array closeness kernels
+/******************************************************************************/
+public:
+  // |actual - expected| <= atol + rtol * |expected| for every element
+  static QUCloseness Tolerance(const T *expected, const T *actual, size_t count, double rtol, double atol) {
+    QUCloseness closeness;
+    size_t done = 0;
+    #if defined(QU_NUMERIC_AVX2_DISPATCH)
+    done = HasAVX2() ? ToleranceAVX2(expected, actual, count, (T)rtol, (T)atol, closeness)
+                     : ToleranceLanes(expected, actual, count, (T)rtol, (T)atol, closeness);
+    #elif defined(QU_VECTOR_EXTENSIONS)
+    done = ToleranceLanes(expected, actual, count, (T)rtol, (T)atol, closeness);
+    #endif
+    for (size_t i = done; i < count; i++) {
+      T diff = actual[i] - expected[i];
+      T error = diff < 0 ? -diff : diff;
+      T magnitude = expected[i] < 0 ? -expected[i] : expected[i];
+      bool close = error <= (T)atol + (T)rtol * magnitude;
+      closeness.Add(i, error == error ? (double)error : std::numeric_limits<double>::infinity(), !close);
+    }
+    return closeness;
+  }
+
+  // At most max_ulps representable values apart, for every element
+  static QUCloseness Ulps(const T *expected, const T *actual, size_t count, unsigned long max_ulps) {
+    QUCloseness closeness;
+    size_t done = 0;
+    #if defined(QU_NUMERIC_AVX2_DISPATCH)
+    done = HasAVX2() ? UlpsAVX2(expected, actual, count, max_ulps, closeness)
+                     : UlpsLanes(expected, actual, count, max_ulps, closeness);
+    #elif defined(QU_VECTOR_EXTENSIONS)
+    done = UlpsLanes(expected, actual, count, max_ulps, closeness);
+    #endif
+    for (size_t i = done; i < count; i++) {
+      double distance = UlpDistance(expected[i], actual[i]);
+      closeness.Add(i, distance, distance > (double)max_ulps);
+    }
+    return closeness;
+  }
+
+  // Number of representable values between a and b. Infinite for NaN.
+  static double UlpDistance(T a, T b) {
+    if (a != a || b != b) {
+      return std::numeric_limits<double>::infinity();
+    }
+    return (double)(Ordered(a) > Ordered(b) ? Ordered(a) - Ordered(b) : Ordered(b) - Ordered(a));
+  }
+
+private:
+  // Maps the bits of a value onto an unsigned scale that sorts like the values
+  static unsigned long long Ordered(T value) {
+    if (sizeof(T) == sizeof(unsigned)) {
+      unsigned bits;
+      memcpy(&bits, &value, sizeof(bits));
+      return (bits & 0x80000000U) ? 0x80000000ULL - (bits & 0x7fffffffU) : 0x80000000ULL + bits;
+    }
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const unsigned long long sign = 0x8000000000000000ULL;
+    return (bits & sign) ? sign - (bits & ~sign) : sign + bits;
+  }
+
+  #ifdef QU_VECTOR_EXTENSIONS
+  typedef typename QUNumericLanes<T>::Values Values;
+  typedef typename QUNumericLanes<T>::Masks Masks;
+  typedef typename QUNumericLanes<T>::Bits Bits;
+  typedef typename QUNumericLanes<T>::Word Word;
+  enum { width = QUNumericLanes<T>::width };
+
+  #ifdef QU_NUMERIC_AVX2_DISPATCH
+  static bool HasAVX2() {
+    static const bool has_avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return has_avx2;
+  }
+  __attribute__((target("avx2")))
+  static size_t ToleranceAVX2(const T *expected, const T *actual, size_t count, T rtol, T atol, QUCloseness &closeness) {
+    return ToleranceLanes(expected, actual, count, rtol, atol, closeness);
+  }
+  __attribute__((target("avx2")))
+  static size_t UlpsAVX2(const T *expected, const T *actual, size_t count, unsigned long max_ulps, QUCloseness &closeness) {
+    return UlpsLanes(expected, actual, count, max_ulps, closeness);
+  }
+  #endif
+
+  // Both kernels keep a running violation count, largest error and its
+  // index in every lane, then merge the lanes at the end. They return how
+  // many elements they covered; the caller does the remainder.
+  __attribute__((always_inline))
+  static inline size_t ToleranceLanes(const T *expected, const T *actual, size_t count, T rtol, T atol, QUCloseness &closeness) {
+    const T infinity = std::numeric_limits<T>::infinity();
+    Values max_error = {0};
+    Masks violations = {0};
+    Masks worst = {0};
+    Masks index, step;
+    for (int lane = 0; lane < width; lane++) {
+      index[lane] = lane;
+      step[lane] = width;
+    }
+    size_t i = 0;
+    for (; i + width <= count; i += width) {
+      Values e, a;
+      memcpy(&e, expected + i, sizeof(e));
+      memcpy(&a, actual + i, sizeof(a));
+      Values diff = a - e;
+      Values error = diff < 0 ? -diff : diff;
+      Values magnitude = e < 0 ? -e : e;
+      violations += ~(error <= atol + rtol * magnitude); // -1 per violation, including NaN
+      error = error == error ? error : infinity;
+      Masks larger = error > max_error;
+      max_error = larger ? error : max_error;
+      worst = larger ? index : worst;
+      index += step;
+    }
+    double errors[width];
+    for (int lane = 0; lane < width; lane++) {
+      errors[lane] = max_error[lane];
+    }
+    MergeLanes(errors, violations, worst, closeness);
+    return i;
+  }
+
+  __attribute__((always_inline))
+  static inline size_t UlpsLanes(const T *expected, const T *actual, size_t count, unsigned long max_ulps, QUCloseness &closeness) {
+    const Word all_ones = ~(Word)0;
+    const Word sign = ~(all_ones >> 1);
+    const Word limit = max_ulps < all_ones ? (Word)max_ulps : all_ones;
+    Bits max_distance = {0};
+    Masks violations = {0};
+    Masks worst = {0};
+    Masks index, step;
+    for (int lane = 0; lane < width; lane++) {
+      index[lane] = lane;
+      step[lane] = width;
+    }
+    size_t i = 0;
+    for (; i + width <= count; i += width) {
+      Values e, a;
+      memcpy(&e, expected + i, sizeof(e));
+      memcpy(&a, actual + i, sizeof(a));
+      Bits e_bits = (Bits)e;
+      Bits a_bits = (Bits)a;
+      Bits e_ordered = (e_bits & sign) != 0 ? sign - (e_bits & ~sign) : sign + e_bits;
+      Bits a_ordered = (a_bits & sign) != 0 ? sign - (a_bits & ~sign) : sign + a_bits;
+      Bits distance = a_ordered > e_ordered ? a_ordered - e_ordered : e_ordered - a_ordered;
+      distance = ((a == a) & (e == e)) != 0 ? distance : all_ones;
+      violations += distance > limit;
+      Masks larger = distance > max_distance;
+      max_distance = larger ? distance : max_distance;
+      worst = larger ? index : worst;
+      index += step;
+    }
+    double max_error[width];
+    for (int lane = 0; lane < width; lane++) {
+      max_error[lane] = max_distance[lane] == all_ones ? std::numeric_limits<double>::infinity() : (double)max_distance[lane];
+    }
+    MergeLanes(max_error, violations, worst, closeness);
+    return i;
+  }
+
+  static void MergeLanes(const double *max_error, const Masks &violations, const Masks &worst, QUCloseness &closeness) {
+    for (int lane = 0; lane < width; lane++) {
+      closeness.violations += (size_t)-violations[lane];
+      bool earlier = max_error[lane] == closeness.max_error && (size_t)worst[lane] < closeness.worst;
+      if (max_error[lane] > closeness.max_error || (earlier && max_error[lane] > 0)) {
+        closeness.max_error = max_error[lane];
+        closeness.worst = (size_t)worst[lane];
+      }
+    }
+  }
+  #endif
+};
+
+/******************************************************************************/
+class QUTestNumeric : public quick_unit::QU_TEST_ANCESTOR {
+/******************************************************************************/
+public:
+  QUTestNumeric(const char *msg) : quick_unit::QU_TEST_ANCESTOR(msg) {}
+
+  // Result matcher: nearness
+  ADD_MATCHER(near, double expected, double actual, double tolerance) {
+    MATCHER((fabs(actual - expected) <= tolerance), " (Expected: " << expected << " +/- " << tolerance << ", got: " << actual << ", error: " << fabs(actual - expected) << ")");
+  }
+  // Result matchers: closeness of arrays
+  template <class T> ADD_MATCHER(all_close, const T *expected, const T *actual, size_t count, double rtol, double atol) {
+    QUCloseness closeness = QUCloseCompare<T>::Tolerance(expected, actual, count, rtol, atol);
+    std::ostringstream limits;
+    limits << "rtol " << rtol << ", atol " << atol;
+    return closeness_result(closeness, count, expected, actual, "", limits.str());
+  }
+  template <class T> ADD_MATCHER(all_close, const std::vector<T> &expected, const std::vector<T> &actual, double rtol, double atol) {
+    if (expected.size() != actual.size()) {
+      return size_mismatch(expected.size(), actual.size());
+    }
+    return all_close(expected.empty() ? NULL : &expected[0], actual.empty() ? NULL : &actual[0], expected.size(), rtol, atol);
+  }
+  template <class T> ADD_MATCHER(all_close_ulps, const T *expected, const T *actual, size_t count, unsigned long max_ulps) {
+    QUCloseness closeness = QUCloseCompare<T>::Ulps(expected, actual, count, max_ulps);
+    std::ostringstream limits;
+    limits << "max ulps " << max_ulps;
+    return closeness_result(closeness, count, expected, actual, " ulps", limits.str());
+  }
+  template <class T> ADD_MATCHER(all_close_ulps, const std::vector<T> &expected, const std::vector<T> &actual, unsigned long max_ulps) {
+    if (expected.size() != actual.size()) {
+      return size_mismatch(expected.size(), actual.size());
+    }
+    return all_close_ulps(expected.empty() ? NULL : &expected[0], actual.empty() ? NULL : &actual[0], expected.size(), max_ulps);
+  }
+
+  // Assertions
+  ADD_ASSERTION(near, double expected, double actual, double tolerance) {ASSERTION(near(expected, actual, tolerance));}
+  template <class T> ADD_ASSERTION(all_close, const T *expected, const T *actual, size_t count, double rtol, double atol) {ASSERTION(all_close(expected, actual, count, rtol, atol));}
+  template <class T> ADD_ASSERTION(all_close, const std::vector<T> &expected, const std::vector<T> &actual, double rtol, double atol) {ASSERTION(all_close(expected, actual, rtol, atol));}
+  template <class T> ADD_ASSERTION(all_close_ulps, const T *expected, const T *actual, size_t count, unsigned long max_ulps) {ASSERTION(all_close_ulps(expected, actual, count, max_ulps));}
+  template <class T> ADD_ASSERTION(all_close_ulps, const std::vector<T> &expected, const std::vector<T> &actual, unsigned long max_ulps) {ASSERTION(all_close_ulps(expected, actual, max_ulps));}
+
+protected:
+  template <class T> Qu_Result closeness_result(const QUCloseness &closeness, size_t count, const T *expected, const T *actual, const char *units, const std::string &limits) {
+    MATCHER((closeness.violations == 0),
+      " (" << closeness.violations << " of " << count << " values out of tolerance. Largest error " << closeness.max_error << units <<
+      " at index " << closeness.worst << ": expected " << expected[closeness.worst] << ", got " << actual[closeness.worst] << ". " << limits << ")");
+  }
+  Qu_Result size_mismatch(size_t expected, size_t actual) {
+    MATCHER(false, " (Expected " << expected << " values, got " << actual << ")");
+  }
+};
+#undef QU_TEST_ANCESTOR
+#define QU_TEST_ANCESTOR QUTestNumeric
+
+} /* quick_unit */
+
+#endif	/* QUICK_UNIT_NUMERIC_HPP */
@@ -0,0 +1,287 @@
+/*
+ * quick_unit_pool.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit provides pooled fixtures: objects that are
+ *  expensive to build are built once and handed from test to test, with a
+ *  cheap Reset() between tests instead of a rebuild.
+ *
+ * struct Dictionary {
+ *   Dictionary() { load("words.txt"); }   // Slow
+ *   void Reset() { lookups = 0; }          // Fast: undo what a test may change
+ *   ...
+ * };
+ *
+ * QUPool<Dictionary> dictionaries("Dictionary");  // Name used in the statistics
+ *
+ * DECLARE_SUITE(Spelling)
+ *
+ * TEST(Known words are found) {
+ *   QUPool<Dictionary>::Lease dictionary(dictionaries);
+ *   assert(dictionary->contains("apple"), SHOULD(know apples));
+ * }
+ *
+ * A Lease has the object to itself until the Lease goes out of scope, when
+ * the object gets Reset() and goes back in the pool. Reset() must not throw.
+ * A pool builds at most 'capacity' objects (1 by default), when they are
+ * first needed. If they are all leased out, a thread waits for one to come
+ * back, unless it already holds one, in which case (and always before
+ * C++11) a spare object is built for that lease and thrown away after it.
+ * If building one throws, the Lease passes the exception on and the pool
+ * tries again for the next lease.
+ *
+ * The pool is per process, so each worker of a forked run builds its own.
+ * From C++11 a pool can also be a suite variable:
+ *   QUPool<Dictionary> dictionaries{"Dictionary", 4};
+ *
+ * The PoolStats reporter, added by including this file, prints a line per
+ * pool used by a suite when the suite finishes:
+ *   Pool Dictionary: 1 built, 24 reused, 0 spare, 0 waits (96% hits)
+ */
+
+#ifndef QUICK_UNIT_POOL_HPP
+#define	QUICK_UNIT_POOL_HPP
+
+#include <vector>
+#include <list>
+#include <map>
+#if __cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)
+ #include <mutex>
+ #include <condition_variable>
+ #include <thread>
+ #define QU_POOL_THREADS
+#endif
+
+namespace quick_unit {
+
+/******************************************************************************/
+struct QUPoolCounts {  // Statistics kept by every pool
+/******************************************************************************/
+  unsigned long builds;   // Misses: objects built for the pool
+  unsigned long reuses;   // Hits: leases of an object that was already built
+  unsigned long spares;   // Misses: objects built for one lease and thrown away
+  unsigned long waits;    // Leases that had to wait for another thread
+
+  QUPoolCounts() : builds(0), reuses(0), spares(0), waits(0) {}
+};
+
+/******************************************************************************/
+class QUPoolStats : public QUPoolCounts {  // The list of all pools
+/******************************************************************************/
+public:
+  std::string name;
+
+  QUPoolStats(const char *pool_name) : name(pool_name) {
+    All().push_back(this);
+  }
+  virtual ~QUPoolStats() {
+    All().remove(this);
+  }
+  static std::list<QUPoolStats *> &All() {
+    static std::list<QUPoolStats *> pools;
+    return pools;
+  }
+
+private:
+  QUPoolStats(const QUPoolStats &);
+  QUPoolStats &operator=(const QUPoolStats &);
+};
+
+/******************************************************************************/
+template <class T> class QUPool : public QUPoolStats {  // Fixtures built once and leased out
+/******************************************************************************/
+public:
+  explicit QUPool(const char *pool_name, size_t capacity = 1) : QUPoolStats(pool_name), _capacity(capacity ? capacity : 1) {}
+  ~QUPool() {
+    for (size_t i = 0; i < _slots.size(); i++) {
+      delete _slots[i].object;
+    }
+  }
+
+  class Lease {
+  public:
+    explicit Lease(QUPool &pool) : _pool(pool), _slot(0) {
+      _object = pool.Acquire(_slot);
+    }
+    ~Lease() {
+      _pool.Release(_object, _slot);
+    }
+    T &operator*() const { return *_object; }
+    T *operator->() const { return _object; }
+    T *get() const { return _object; }
+  private:
+    Lease(const Lease &);
+    Lease &operator=(const Lease &);
+    QUPool &_pool;
+    size_t _slot;
+    T *_object;
+  };
+
+private:
+  struct Slot {
+    T *object;    // NULL while being built, or if building it threw
+    bool leased;
+    #ifdef QU_POOL_THREADS
+    std::thread::id holder;
+    #endif
+  };
+  enum { spare = -1 }; // The slot of a lease that has its own object
+  std::vector<Slot> _slots;
+  size_t _capacity;
+  #ifdef QU_POOL_THREADS
+  std::mutex _lock;
+  std::condition_variable _returned;
+  #endif
+
+  T *Acquire(size_t &slot) {
+    #ifdef QU_POOL_THREADS
+    std::unique_lock<std::mutex> hold(_lock);
+    #endif
+    for (;;) {
+      for (slot = 0; slot < _slots.size(); slot++) {
+        if (!_slots[slot].leased && _slots[slot].object) {
+          reuses++;
+          return Take(slot);
+        }
+      }
+      for (slot = 0; slot < _slots.size() && (_slots[slot].leased || _slots[slot].object); slot++) {}
+      if (slot < _slots.size() || _slots.size() < _capacity) {
+        if (slot == _slots.size()) {
+          _slots.push_back(Slot());
+        }
+        _slots[slot].leased = true;
+        builds++;
+        #ifdef QU_POOL_THREADS
+        hold.unlock(); // Others can use the pool while this is built
+        #endif
+        T *object = Build(slot);
+        #ifdef QU_POOL_THREADS
+        hold.lock();
+        #endif
+        _slots[slot].object = object;
+        return Take(slot);
+      }
+      #ifdef QU_POOL_THREADS
+      if (!Holding()) {
+        waits++;
+        _returned.wait(hold);
+        continue;
+      }
+      #endif
+      spares++;
+      slot = (size_t)spare;
+      #ifdef QU_POOL_THREADS
+      hold.unlock();
+      #endif
+      return Build(slot);
+    }
+  }
+
+  // Called without the lock. If T() throws, the slot is left empty for
+  // the next lease to build into, and a waiting thread is woken to do so.
+  T *Build(size_t slot) {
+    #ifndef QU_NO_EXCEPTIONS
+    try {
+      return new T();
+    } catch (...) {
+      #ifdef QU_POOL_THREADS
+      std::lock_guard<std::mutex> hold(_lock);
+      #endif
+      if (slot == (size_t)spare) {
+        spares--;
+      } else {
+        _slots[slot].leased = false;
+        builds--;
+      }
+      #ifdef QU_POOL_THREADS
+      _returned.notify_one();
+      #endif
+      throw;
+    }
+    #else
+    return new T();
+    #endif
+  }
+
+  T *Take(size_t slot) {
+    _slots[slot].leased = true;
+    #ifdef QU_POOL_THREADS
+    _slots[slot].holder = std::this_thread::get_id();
+    #endif
+    return _slots[slot].object;
+  }
+
+  #ifdef QU_POOL_THREADS
+  bool Holding() const {
+    for (size_t i = 0; i < _slots.size(); i++) {
+      if (_slots[i].leased && _slots[i].holder == std::this_thread::get_id()) {
+        return true;
+      }
+    }
+    return false;
+  }
+  #endif
+
+  void Release(T *object, size_t slot) {
+    object->Reset();
+    if (slot == (size_t)spare) {
+      delete object;
+      return;
+    }
+    #ifdef QU_POOL_THREADS
+    std::lock_guard<std::mutex> hold(_lock);
+    _slots[slot].holder = std::thread::id();
+    #endif
+    _slots[slot].leased = false;
+    #ifdef QU_POOL_THREADS
+    _returned.notify_one();
+    #endif
+  }
+};
+
+} /* quick_unit */
+
+BEGIN_REPORTER(PoolStats)
+  void StartingSuite(const std::string &suite_name) {
+    _before.clear();
+    for (std::list<QUPoolStats *>::iterator pool = QUPoolStats::All().begin(); pool != QUPoolStats::All().end(); ++pool) {
+      _before[*pool] = **pool;
+    }
+  }
+  void StoppingSuite(const std::string &suite_name, double duration, unsigned passes, unsigned fails) {
+    if (FirstInChain()) {
+      for (std::list<QUPoolStats *>::iterator pool = QUPoolStats::All().begin(); pool != QUPoolStats::All().end(); ++pool) {
+        Describe(**pool, _before[*pool]);
+      }
+    }
+  }
+
+private:
+  std::map<QUPoolStats *, QUPoolCounts> _before;
+
+  // Reports the counts since the suite started, if the pool was used
+  void Describe(const QUPoolStats &now, const QUPoolCounts &before) {
+    unsigned long builds = now.builds - before.builds;
+    unsigned long reuses = now.reuses - before.reuses;
+    unsigned long spares = now.spares - before.spares;
+    unsigned long leases = builds + reuses + spares;
+    if (leases) {
+      Output() << "Pool " << now.name << ": " << builds << " built, " << reuses << " reused, " << spares << " spare, " <<
+        now.waits - before.waits << " waits (" << (100 * reuses / leases) << "% hits)" << std::endl;
+    }
+  }
+  // Each file including this header adds a PoolStats reporter. Only the
+  // earliest one in a suite's chain reports, so the lines are not repeated.
+  bool FirstInChain() {
+    for (QUReporter *r = chain(); r; r = r->chain()) {
+      if (dynamic_cast<PoolStatsReporter *>(r)) {
+        return false;
+      }
+    }
+    return true;
+  }
+END_REPORTER()
+
+ADDITIONAL_REPORTER(PoolStats)
+#endif	/* QUICK_UNIT_POOL_HPP */
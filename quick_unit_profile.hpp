@@ -0,0 +1,416 @@
+/*
+ * quick_unit_profile.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This is a reporter add-in for quick_unit that profiles each test as it
+ *  runs, by sampling its stack on a CPU timer, and writes what it finds in
+ *  the collapsed-stack format used by flamegraph.pl, speedscope and others.
+ *  It needs C++11 and Linux.
+ *
+ *   #include "quick_unit.hpp"
+ *   #include "quick_unit_profile.hpp"
+ *
+ *   ADDITIONAL_REPORTER(Profile)
+ *   DECLARE_SUITE(My First Tests)
+ *
+ * and run the tests with --profile=<directory> (or set QU_PROFILE). Each
+ * test's profile goes to <directory>/<suite>.<test>.folded, e.g.
+ *
+ *   flamegraph.pl profiles/My_First_Tests.slow_test.folded > slow.svg
+ *
+ * Other options:
+ *   --profile-threshold=<ms> keeps only the profiles of tests that took
+ *     longer than that, so a whole run can be left profiling.
+ *   --profile-hz=<samples per second of CPU time> (default 1000). The
+ *     kernel's CPU timers may not tick that often (see CONFIG_HZ).
+ *
+ * The sampler is only running while a test runs (from before SETUP to after
+ * TEARDOWN), in the process that runs it, so forked tests are profiled too.
+ * ASYNC_TESTs, which run alongside each other, are not.
+ *
+ * Stacks are walked by their frame pointers, with nothing but reads of the
+ * test thread's own stack, so build with -fno-omit-frame-pointer (gcc and
+ * clang leave them out from -O1) or stacks will be cut short. A sample that
+ * lands on another thread, e.g. one started by QUStress, only gives the
+ * function it was in. Names come from the program's own symbol table, so
+ * static functions are named too, and from dladdr() for shared libraries.
+ */
+
+#ifndef QUICK_UNIT_PROFILE_HPP
+#define	QUICK_UNIT_PROFILE_HPP
+
+#ifndef QU_THREADS
+ #error quick_unit_profile.hpp needs C++11
+#endif
+#ifndef __linux__
+ #error quick_unit_profile.hpp needs Linux
+#endif
+
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <signal.h>
+#include <ucontext.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <elf.h>
+#include <cxxabi.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+namespace quick_unit {
+
+/******************************************************************************/
+class QUSymbols {  // Names for the code addresses in this process
+/******************************************************************************/
+  struct Symbol {
+    uintptr_t start;
+    uintptr_t end;
+    const char *name; // In the mapped file
+    bool operator<(const Symbol &other) const { return start < other.start; }
+  };
+  std::vector<Symbol> _symbols; // The program's functions, by address
+  std::map<uintptr_t, std::string> _names;
+
+  static int FindBias(struct dl_phdr_info *info, size_t size, void *bias) {
+    *(uintptr_t *)bias = info->dlpi_addr; // The program comes first
+    return 1;
+  }
+
+  // Reads the functions from the program's symbol table, which, unlike the
+  // dynamic one, has its static functions too
+  void Load(void) {
+    int fd = open("/proc/self/exe", O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ElfW(Ehdr))) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      return;
+    }
+    // Kept mapped for the names
+    const char *file = (const char *)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+      return;
+    }
+    const ElfW(Ehdr) *header = (const ElfW(Ehdr) *)file;
+    if (memcmp(header->e_ident, ELFMAG, SELFMAG) != 0 || header->e_shoff + header->e_shnum * sizeof(ElfW(Shdr)) > (size_t)info.st_size) {
+      return;
+    }
+    uintptr_t bias = 0;
+    dl_iterate_phdr(FindBias, &bias);
+    const ElfW(Shdr) *sections = (const ElfW(Shdr) *)(file + header->e_shoff);
+    for (int pass = 0; pass < 2 && _symbols.empty(); pass++) {
+      for (size_t s = 0; s < header->e_shnum; s++) {
+        if (sections[s].sh_type != (pass == 0 ? SHT_SYMTAB : SHT_DYNSYM) || sections[s].sh_link >= header->e_shnum) {
+          continue;
+        }
+        const ElfW(Sym) *symbols = (const ElfW(Sym) *)(file + sections[s].sh_offset);
+        const char *strings = file + sections[sections[s].sh_link].sh_offset;
+        size_t count = sections[s].sh_size / sizeof(ElfW(Sym));
+        for (size_t i = 0; i < count; i++) {
+          if (ELF64_ST_TYPE(symbols[i].st_info) == STT_FUNC && symbols[i].st_value) {
+            Symbol symbol = {bias + symbols[i].st_value, bias + symbols[i].st_value + symbols[i].st_size, strings + symbols[i].st_name};
+            _symbols.push_back(symbol);
+          }
+        }
+      }
+    }
+    std::sort(_symbols.begin(), _symbols.end());
+  }
+
+  static std::string Demangled(const char *name) {
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+    std::string result(status == 0 && demangled ? demangled : name);
+    free(demangled);
+    std::replace(result.begin(), result.end(), ';', ':'); // ; separates frames
+    return result;
+  }
+
+  std::string Lookup(uintptr_t address) {
+    Symbol key = {address, 0, NULL};
+    std::vector<Symbol>::iterator after = std::upper_bound(_symbols.begin(), _symbols.end(), key);
+    if (after != _symbols.begin()) {
+      const Symbol &symbol = *(after - 1);
+      if (address < symbol.end) {
+        return Demangled(symbol.name);
+      }
+    }
+    Dl_info info;
+    if (dladdr((void *)address, &info)) {
+      if (info.dli_sname) {
+        return Demangled(info.dli_sname);
+      }
+      if (info.dli_fname) {
+        const char *base = strrchr(info.dli_fname, '/');
+        char offset[32];
+        sprintf(offset, "+0x%lx", (unsigned long)(address - (uintptr_t)info.dli_fbase));
+        return std::string("[") + (base ? base + 1 : info.dli_fname) + offset + "]";
+      }
+    }
+    return "[unknown]";
+  }
+
+public:
+  static QUSymbols &Process() {
+    static QUSymbols symbols;
+    return symbols;
+  }
+  QUSymbols() { Load(); }
+
+  const std::string &Name(uintptr_t address) {
+    std::map<uintptr_t, std::string>::iterator found = _names.find(address);
+    if (found == _names.end()) {
+      found = _names.insert(std::make_pair(address, Lookup(address))).first;
+    }
+    return found->second;
+  }
+};
+
+/******************************************************************************/
+class QUSampler {  // Samples the stack of the thread running a test, on SIGPROF
+/******************************************************************************/
+public:
+  enum { max_samples = 16384, max_depth = 64 };
+
+  QUSampler() : _count(0), _dropped(0) {
+    _thread = 0;
+    _stack_low = _stack_high = 0;
+    _running = false;
+  }
+
+  // Starts sampling, hz times per second of CPU time used by the process
+  void Start(unsigned hz) {
+    if (_running || Current().load()) {
+      return;
+    }
+    if (_frames.empty()) { // Only a sampler that is used takes the space
+      _frames.resize(max_samples * max_depth);
+      _depths.resize(max_samples);
+    }
+    _count = 0;
+    _dropped = 0;
+    _thread = (pid_t)syscall(SYS_gettid);
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(pthread_self(), &attributes) == 0) {
+      void *low;
+      size_t size;
+      pthread_attr_getstack(&attributes, &low, &size);
+      _stack_low = (uintptr_t)low;
+      _stack_high = (uintptr_t)low + size;
+      pthread_attr_destroy(&attributes);
+    }
+    Current() = this;
+    // Installed once and left there: a SIGPROF still pending after Stop()
+    // would otherwise end the process, and Sample() ignores it anyway
+    static bool installed = false;
+    if (!installed) {
+      struct sigaction action;
+      memset(&action, 0, sizeof(action));
+      action.sa_sigaction = Sample;
+      action.sa_flags = SA_SIGINFO | SA_RESTART;
+      sigemptyset(&action.sa_mask);
+      sigaction(SIGPROF, &action, NULL);
+      installed = true;
+    }
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = hz > 1 ? (suseconds_t)(1000000 / hz) : 999999;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, NULL);
+    _running = true;
+  }
+
+  void Stop(void) {
+    if (!_running) {
+      return;
+    }
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    Current() = NULL;
+    _running = false;
+  }
+
+  size_t samples(void) { return std::min((size_t)_count.load(), (size_t)max_samples); }
+  size_t dropped(void) { return _dropped.load(); }
+
+  // The samples as collapsed stacks: "outer;inner;innermost count" lines
+  std::string Collapsed(void) {
+    std::map<std::string, unsigned> stacks;
+    QUSymbols &symbols = QUSymbols::Process();
+    for (size_t sample = 0; sample < samples(); sample++) {
+      const uintptr_t *frames = &_frames[sample * max_depth];
+      std::string stack;
+      for (size_t frame = _depths[sample]; frame-- > 0; ) {
+        if (frames[frame] == 0) { // Another thread: just where it was
+          stack += "[other thread]";
+        } else {
+          // Return addresses are looked up as the call before them
+          stack += symbols.Name(frame ? frames[frame] - 1 : frames[frame]);
+        }
+        stack += frame ? ";" : "";
+      }
+      stacks[stack]++;
+    }
+    std::ostringstream collapsed;
+    for (std::map<std::string, unsigned>::iterator it = stacks.begin(); it != stacks.end(); ++it) {
+      collapsed << it->first << " " << it->second << "\n";
+    }
+    return collapsed.str();
+  }
+
+private:
+  std::vector<uintptr_t> _frames; // max_depth per sample, innermost first
+  std::vector<unsigned char> _depths;
+  std::atomic<size_t> _count;
+  std::atomic<size_t> _dropped;
+  pid_t _thread;                  // The test's thread, whose stack is known
+  uintptr_t _stack_low, _stack_high;
+  bool _running;
+
+  static std::atomic<QUSampler *> &Current() {
+    static std::atomic<QUSampler *> current(NULL);
+    return current;
+  }
+
+  // The signal handler: it only reads registers and the test's stack
+  static void Sample(int signal, siginfo_t *info, void *context) {
+    QUSampler *sampler = Current().load();
+    if (!sampler) {
+      return;
+    }
+    size_t index = sampler->_count.fetch_add(1);
+    if (index >= max_samples) {
+      sampler->_dropped++;
+      return;
+    }
+    uintptr_t *frames = &sampler->_frames[index * max_depth];
+    const mcontext_t &registers = ((ucontext_t *)context)->uc_mcontext;
+    #if defined(__x86_64__)
+    uintptr_t pc = registers.gregs[REG_RIP], fp = registers.gregs[REG_RBP], sp = registers.gregs[REG_RSP];
+    #elif defined(__aarch64__)
+    uintptr_t pc = registers.pc, fp = registers.regs[29], sp = registers.sp;
+    #elif defined(__i386__)
+    uintptr_t pc = registers.gregs[REG_EIP], fp = registers.gregs[REG_EBP], sp = registers.gregs[REG_ESP];
+    #else
+    uintptr_t pc = 0, fp = 0, sp = 0;
+    #endif
+    size_t depth = 0;
+    frames[depth++] = pc;
+    if ((pid_t)syscall(SYS_gettid) != sampler->_thread) {
+      frames[depth++] = 0;
+    } else {
+      // Each frame holds the caller's frame pointer, then the return address
+      while (depth < max_depth && fp >= sp && fp >= sampler->_stack_low && fp + 2 * sizeof(uintptr_t) <= sampler->_stack_high && fp % sizeof(uintptr_t) == 0) {
+        const uintptr_t *frame = (const uintptr_t *)fp;
+        if (!frame[1]) {
+          break;
+        }
+        frames[depth++] = frame[1];
+        if (frame[0] <= fp) {
+          break;
+        }
+        fp = frame[0];
+      }
+    }
+    sampler->_depths[index] = (unsigned char)depth;
+  }
+};
+
+} /* quick_unit */
+
+BEGIN_REPORTER(Profile)
+  // Writes to directory, or if that is NULL to the one named by --profile
+  ProfileReporter(const char *directory = NULL) {
+    _directory = directory ? directory : "";
+    _tried = false;
+    _enabled = false;
+    _threshold = 0;
+    _hz = 1000;
+  }
+
+  bool WantsSpans(void) { return Enabled(); }
+
+  void StartingSpanById(QUSpanKind kind, QUNameId suite, QUNameId name, unsigned lane) {
+    if (kind == QU_SPAN_TEST && !lane && Enabled()) {
+      _last_profile.clear();
+      _sampler.Start(_hz);
+    }
+  }
+
+  void SpanById(QUSpanKind kind, QUNameId suite, QUNameId name, double start, double end, unsigned lane) {
+    if (kind == QU_SPAN_TEST && !lane && Enabled()) {
+      _sampler.Stop();
+      if ((end - start) * 1000 >= _threshold && _sampler.samples()) {
+        Write(QUNames::Form(suite, Filename()) + "." + QUNames::Form(name, Filename()) + ".folded");
+      }
+    }
+  }
+
+  // The file the last test's profile went to, or "" if it was not kept
+  const std::string &last_profile(void) { return _last_profile; }
+
+  static std::string file_named(const std::string &name) {
+    std::string file(name);
+    for (size_t i = 0; i < file.length(); i++) {
+      if (!isalnum((unsigned char)file[i]) && file[i] != '-') {
+        file[i] = '_';
+      }
+    }
+    return file;
+  }
+
+private:
+  std::string _directory;
+  bool _tried;
+  bool _enabled;
+  double _threshold; // ms
+  unsigned _hz;
+  std::string _last_profile;
+  quick_unit::QUSampler _sampler;
+
+  static unsigned Filename() { static unsigned form = QUNames::AddForm(file_named); return form; }
+
+  bool Enabled(void) {
+    if (!_tried) {
+      _tried = true;
+      if (_directory.empty()) {
+        const char *option = QUOptionTracker::Option("profile");
+        _directory = option ? option : "";
+      }
+      const char *threshold = QUOptionTracker::Option("profile-threshold");
+      _threshold = threshold ? strtod(threshold, NULL) : 0;
+      const char *hz = QUOptionTracker::Option("profile-hz");
+      _hz = hz && atoi(hz) > 0 ? (unsigned)atoi(hz) : 1000;
+      _enabled = !_directory.empty();
+      if (_enabled) {
+        mkdir(_directory.c_str(), 0777);
+        QUSymbols::Process(); // Loaded now rather than in the first test
+      }
+    }
+    return _enabled;
+  }
+
+  void Write(const std::string &file) {
+    std::string path = _directory + "/" + file;
+    FILE *out = fopen(path.c_str(), "w");
+    if (out) {
+      std::string collapsed = _sampler.Collapsed();
+      fwrite(collapsed.data(), 1, collapsed.size(), out);
+      fclose(out);
+      _last_profile = path;
+    }
+  }
+END_REPORTER()
+
+#endif	/* QUICK_UNIT_PROFILE_HPP */
@@ -0,0 +1,188 @@
+/*
+ * quick_unit_reporters.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit declares a fixed set of reporters at compile
+ *  time, instead of chaining them at run time. It needs C++11.
+ *
+ *   #include "quick_unit.hpp"
+ *   #include "quick_unit_netbeans.hpp"
+ *   #include "quick_unit_reporters.hpp"
+ *
+ *   REPORTERS(Default, Netbeans)
+ *   DECLARE_SUITE(My First Tests)
+ *
+ * Like TEST_REPORTER, REPORTERS replaces the reporters for the suites that
+ * follow it. The runner makes one virtual call per event into the set, and
+ * the set calls each of its reporters directly, so the compiler can inline
+ * them. Events that a reporter does not handle are left out altogether.
+ * Events go to the reporters in the order given as a test starts, and in
+ * the reverse order as it finishes, as they do along a chain.
+ *
+ * TEST_REPORTER and ADDITIONAL_REPORTER still work, for reporters that are
+ * only chosen at run time; ADDITIONAL_REPORTER can add to a set.
+ */
+
+#ifndef QUICK_UNIT_REPORTERS_HPP
+#define	QUICK_UNIT_REPORTERS_HPP
+
+#ifndef QU_THREADS
+ #error quick_unit_reporters.hpp needs C++11
+#endif
+
+#include <type_traits>
+
+namespace quick_unit {
+
+template <class... Reporters> class QUReporterSet;
+
+/******************************************************************************/
+template <> class QUReporterSet<> : public QUReporter {  // The end of a set
+/******************************************************************************/
+public:
+  void StartingSuiteById(QUNameId suite) {}
+  void StartedSuiteById(QUNameId suite) {}
+  void StoppingSuiteById(QUNameId suite, double duration, unsigned passes, unsigned fails) {}
+  void CompletedSuiteById(QUNameId suite, double duration, unsigned passes, unsigned fails) {}
+  void StartingTestById(QUNameId suite, QUNameId test) {}
+  void StartedTestById(QUNameId suite, QUNameId test) {}
+  void StoppingTestById(QUNameId suite, QUNameId test) {}
+  void FailedTestById(QUNameId suite, QUNameId test, double duration, const std::string &fail_message) {}
+  void PassedTestById(QUNameId suite, QUNameId test, double duration) {}
+  void TestOutputById(QUNameId suite, QUNameId test, const std::string &text) {}
+  void TestMetricById(QUNameId suite, QUNameId test, const QUMetric &metric) {}
+  void CompletedTestById(QUNameId suite, QUNameId test, double duration) {}
+  void SlowTestById(QUNameId suite, QUNameId test, double duration, const std::string &overrun) {}
+  void SlowSuiteById(QUNameId suite, double duration, const std::string &overrun) {}
+  bool WantsSpans(void) { return false; }
+  void StartingSpanById(QUSpanKind kind, QUNameId suite, QUNameId name, unsigned lane) {}
+  void SpanById(QUSpanKind kind, QUNameId suite, QUNameId name, double start, double end, unsigned lane) {}
+  void CounterById(QUNameId suite, const char *counter, double value) {}
+};
+
+// Calls First's own handler for an event: the one taking IDs, else the one
+// taking names. The test is on types, so the compiler drops the other calls.
+#define QU_SET_EVENT(by_id, by_name, id_args, name_args) \
+  if (!std::is_same<decltype(&First::by_id), decltype(&QUReporter::by_id)>::value) {\
+    _first.First::by_id id_args;\
+  } else if (!std::is_same<decltype(&First::by_name), decltype(&QUReporter::by_name)>::value) {\
+    _first.First::by_name name_args;\
+  }
+
+/******************************************************************************/
+template <class First, class... Rest> class QUReporterSet<First, Rest...> : public QUReporterSet<Rest...> {
+/******************************************************************************/
+  typedef QUReporterSet<Rest...> Others;
+  First _first;
+
+public:
+  First &first() { return _first; }
+
+  // Starting events go to First, then the others
+  void StartingSuiteById(QUNameId suite) {
+    QU_SET_EVENT(StartingSuiteById, StartingSuite, (suite), (QUNames::Name(suite)))
+    Others::StartingSuiteById(suite);
+  }
+  void StartedSuiteById(QUNameId suite) {
+    QU_SET_EVENT(StartedSuiteById, StartedSuite, (suite), (QUNames::Name(suite)))
+    Others::StartedSuiteById(suite);
+  }
+  void StartingTestById(QUNameId suite, QUNameId test) {
+    QU_SET_EVENT(StartingTestById, StartingTest, (suite, test), (QUNames::Name(suite), QUNames::Name(test)))
+    Others::StartingTestById(suite, test);
+  }
+  void StartedTestById(QUNameId suite, QUNameId test) {
+    QU_SET_EVENT(StartedTestById, StartedTest, (suite, test), (QUNames::Name(suite), QUNames::Name(test)))
+    Others::StartedTestById(suite, test);
+  }
+
+  // Finishing events go to the others, then First
+  void StoppingTestById(QUNameId suite, QUNameId test) {
+    Others::StoppingTestById(suite, test);
+    QU_SET_EVENT(StoppingTestById, StoppingTest, (suite, test), (QUNames::Name(suite), QUNames::Name(test)))
+  }
+  void FailedTestById(QUNameId suite, QUNameId test, double duration, const std::string &fail_message) {
+    Others::FailedTestById(suite, test, duration, fail_message);
+    QU_SET_EVENT(FailedTestById, FailedTest, (suite, test, duration, fail_message), (QUNames::Name(suite), QUNames::Name(test), duration, fail_message))
+  }
+  void PassedTestById(QUNameId suite, QUNameId test, double duration) {
+    Others::PassedTestById(suite, test, duration);
+    QU_SET_EVENT(PassedTestById, PassedTest, (suite, test, duration), (QUNames::Name(suite), QUNames::Name(test), duration))
+  }
+  void TestOutputById(QUNameId suite, QUNameId test, const std::string &text) {
+    Others::TestOutputById(suite, test, text);
+    QU_SET_EVENT(TestOutputById, TestOutput, (suite, test, text), (QUNames::Name(suite), QUNames::Name(test), text))
+  }
+  void TestMetricById(QUNameId suite, QUNameId test, const QUMetric &metric) {
+    Others::TestMetricById(suite, test, metric);
+    QU_SET_EVENT(TestMetricById, TestMetric, (suite, test, metric), (QUNames::Name(suite), QUNames::Name(test), metric))
+  }
+  void CompletedTestById(QUNameId suite, QUNameId test, double duration) {
+    Others::CompletedTestById(suite, test, duration);
+    QU_SET_EVENT(CompletedTestById, CompletedTest, (suite, test, duration), (QUNames::Name(suite), QUNames::Name(test), duration))
+  }
+  // A reporter that does not handle slow tests takes them as failed, as it would in a chain
+  void SlowTestById(QUNameId suite, QUNameId test, double duration, const std::string &overrun) {
+    Others::SlowTestById(suite, test, duration, overrun);
+    if (!std::is_same<decltype(&First::SlowTestById), decltype(&QUReporter::SlowTestById)>::value ||
+        !std::is_same<decltype(&First::SlowTest), decltype(&QUReporter::SlowTest)>::value) {
+      QU_SET_EVENT(SlowTestById, SlowTest, (suite, test, duration, overrun), (QUNames::Name(suite), QUNames::Name(test), duration, overrun))
+    } else {
+      QU_SET_EVENT(FailedTestById, FailedTest, (suite, test, duration, "Too slow: " + overrun), (QUNames::Name(suite), QUNames::Name(test), duration, "Too slow: " + overrun))
+    }
+  }
+  void SlowSuiteById(QUNameId suite, double duration, const std::string &overrun) {
+    Others::SlowSuiteById(suite, duration, overrun);
+    QU_SET_EVENT(SlowSuiteById, SlowSuite, (suite, duration, overrun), (QUNames::Name(suite), duration, overrun))
+  }
+  void StoppingSuiteById(QUNameId suite, double duration, unsigned passes, unsigned fails) {
+    Others::StoppingSuiteById(suite, duration, passes, fails);
+    QU_SET_EVENT(StoppingSuiteById, StoppingSuite, (suite, duration, passes, fails), (QUNames::Name(suite), duration, passes, fails))
+  }
+  void CompletedSuiteById(QUNameId suite, double duration, unsigned passes, unsigned fails) {
+    Others::CompletedSuiteById(suite, duration, passes, fails);
+    QU_SET_EVENT(CompletedSuiteById, CompletedSuite, (suite, duration, passes, fails), (QUNames::Name(suite), duration, passes, fails))
+  }
+
+  // Timeline events have no named forms
+  bool WantsSpans(void) {
+    return _first.First::WantsSpans() || Others::WantsSpans();
+  }
+  void StartingSpanById(QUSpanKind kind, QUNameId suite, QUNameId name, unsigned lane) {
+    _first.First::StartingSpanById(kind, suite, name, lane);
+    Others::StartingSpanById(kind, suite, name, lane);
+  }
+  void SpanById(QUSpanKind kind, QUNameId suite, QUNameId name, double start, double end, unsigned lane) {
+    _first.First::SpanById(kind, suite, name, start, end, lane);
+    Others::SpanById(kind, suite, name, start, end, lane);
+  }
+  void CounterById(QUNameId suite, const char *counter, double value) {
+    _first.First::CounterById(suite, counter, value);
+    Others::CounterById(suite, counter, value);
+  }
+};
+
+#undef QU_SET_EVENT
+
+} /* quick_unit */
+
+/******************************************************************************/
+/* REPORTERS(Default, Netbeans) names up to eight reporters */
+#define QU_EXPAND(x) x
+#define QU_ARG_COUNT(...) QU_EXPAND(QU_ARG_COUNT_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0))
+#define QU_ARG_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, count, ...) count
+#define QU_REPORTERS_1(a) a ##Reporter
+#define QU_REPORTERS_2(a, ...) a ##Reporter, QU_EXPAND(QU_REPORTERS_1(__VA_ARGS__))
+#define QU_REPORTERS_3(a, ...) a ##Reporter, QU_EXPAND(QU_REPORTERS_2(__VA_ARGS__))
+#define QU_REPORTERS_4(a, ...) a ##Reporter, QU_EXPAND(QU_REPORTERS_3(__VA_ARGS__))
+#define QU_REPORTERS_5(a, ...) a ##Reporter, QU_EXPAND(QU_REPORTERS_4(__VA_ARGS__))
+#define QU_REPORTERS_6(a, ...) a ##Reporter, QU_EXPAND(QU_REPORTERS_5(__VA_ARGS__))
+#define QU_REPORTERS_7(a, ...) a ##Reporter, QU_EXPAND(QU_REPORTERS_6(__VA_ARGS__))
+#define QU_REPORTERS_8(a, ...) a ##Reporter, QU_EXPAND(QU_REPORTERS_7(__VA_ARGS__))
+#define QU_REPORTER_TYPES(...) QU_EXPAND(QU_TOKEN_MERGE(QU_REPORTERS_, QU_ARG_COUNT(__VA_ARGS__))(__VA_ARGS__))
+
+#define REPORTERS(...) \
+using namespace quick_unit; namespace  { class QU_UNIQ_ID(QUReporter) : public quick_unit::QUReporterSet<QU_REPORTER_TYPES(__VA_ARGS__)> { public: QU_UNIQ_ID(QUReporter)() { QUTestSuiteTracker::CurrentQUReporter(this);} } static QU_UNIQ_ID(Reporter); }
+
+#endif	/* QUICK_UNIT_REPORTERS_HPP */
@@ -65,14 +65,16 @@ public:
   }
 
   Requirer& test_truth(bool truth) {
-		Qu_Result result(truth);
-    _test->_assert(result, truth ? "" : fail_message());
+    if (_test->_record(Qu_Result(truth), truth ? "" : fail_message())) {
+      QUTestFail::Raise();
+    }
     return *this;
   }
 
   Requirer& test_truth(bool truth, const std::string &msg) {
-		Qu_Result result(truth);
-    _test->_assert(result, truth ? "" : fail_message(msg));
+    if (_test->_record(Qu_Result(truth), truth ? "" : fail_message(msg))) {
+      QUTestFail::Raise();
+    }
     return *this;
   }
 
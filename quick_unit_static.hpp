@@ -0,0 +1,74 @@
+/*
+ * quick_unit_static.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit provides tests that are checked entirely by
+ *  the compiler. Needs C++11 (C++14 for multi-statement constexpr helpers).
+ *
+ * constexpr int count_bits(unsigned x) { return x ? (x & 1) + count_bits(x >> 1) : 0; }
+ *
+ * STATIC_TEST(Bit counting works at compile time) {
+ *   STATIC_ASSERT(count_bits(0) == 0,     SHOULD(find no bits in zero));
+ *   STATIC_ASSERT_EQUAL(3, count_bits(7), SHOULD(count three bits));
+ * }
+ *
+ * The checks are static_asserts, so a failure stops the build with the
+ * SHOULD text in the diagnostic:
+ *
+ *   error: static assertion failed: line 13: Should count three bits.
+ *
+ * A STATIC_TEST that compiles has passed. It is still reported alongside
+ * the other tests of its suite, but its body never runs.
+ *
+ * STATIC_ASSERT and STATIC_ASSERT_EQUAL are only defined if nothing else has
+ * taken those names; QU_STATIC_ASSERT and QU_STATIC_ASSERT_EQUAL always are.
+ */
+
+#ifndef QUICK_UNIT_STATIC_HPP
+#define	QUICK_UNIT_STATIC_HPP
+
+#if __cplusplus < 201103L && !(defined(_MSC_VER) && _MSC_VER >= 1600)
+#error "quick_unit_static.hpp needs a C++11 compiler"
+#endif
+
+namespace quick_unit {
+
+/******************************************************************************/
+class QUStaticTest : public quick_unit::QU_TEST_ANCESTOR {  // Base for STATIC_TEST
+/******************************************************************************/
+public:
+  QUStaticTest(const char *msg) : quick_unit::QU_TEST_ANCESTOR(msg) {}
+
+  // The compiler has already checked everything
+  void Run(void) {
+    _assert(Qu_Result(true));
+  }
+};
+
+} /* quick_unit */
+
+/******************************************************************************/
+/* Macro for creating a STATIC_TEST. MUST be on a single line. Checks() is
+   only referred to, not called, so that it is not an unused function */
+#define STATIC_TEST(name) namespace { class QU_UNIQ_ID(QUStaticTest) : public quick_unit::QUStaticTest {public: QU_UNIQ_ID(QUStaticTest)() : quick_unit::QUStaticTest(#name) {(void)&Checks; if (QUTestSuiteTracker::CurrentQUTestSuite()) {QUTestSuiteTracker::CurrentQUTestSuite()->Add(this);}} static void Checks(void); } static QU_UNIQ_ID(test);} void QU_UNIQ_ID(QUStaticTest)::Checks(void)
+
+/******************************************************************************/
+/* Compile-time assertions. msg must be a string literal, such as SHOULD(...) */
+#ifdef QU_PROFILE_ASSERTIONS
+ // SHOULD(...) is then a site record, so the message is the text as written
+ #define QU_STATIC_ASSERT(truth, msg) static_assert((truth), #msg)
+ #define QU_STATIC_ASSERT_EQUAL(expected, actual, msg) static_assert((expected) == (actual), #msg)
+#else
+ #define QU_STATIC_ASSERT(truth, msg) static_assert((truth), msg)
+ #define QU_STATIC_ASSERT_EQUAL(expected, actual, msg) static_assert((expected) == (actual), msg)
+#endif
+
+#ifndef STATIC_ASSERT
+ #define STATIC_ASSERT QU_STATIC_ASSERT
+#endif
+#ifndef STATIC_ASSERT_EQUAL
+ #define STATIC_ASSERT_EQUAL QU_STATIC_ASSERT_EQUAL
+#endif
+
+#endif	/* QUICK_UNIT_STATIC_HPP */
@@ -0,0 +1,288 @@
+/*
+ * quick_unit_text.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit provides assertions that look for many
+ *  patterns in one big text, and regular expression assertions.
+ *
+ * TEST(The log shows a clean start up) {
+ *   std::string log = read_log();
+ *   const char *steps[] = {"config loaded", "listening on", "ready"};
+ *   const char *problems[] = {"ERROR", "WARN", "retrying"};
+ *   assert_include_all(steps, log,     SHOULD(log every start up step));
+ *   assert_exclude_any(problems, log,  SHOULD(log no problems));
+ *   assert_matches("listening on port [0-9]+", log, SHOULD(give the port));
+ * }
+ *
+ * assert_include_all and assert_exclude_any take a C array of strings or a
+ * std::vector<std::string>, and a std::string or C string to search. All
+ * the patterns are found in a single pass over the text with an
+ * Aho-Corasick automaton, rather than one strstr() per pattern. Each
+ * distinct set of patterns is only turned into an automaton once.
+ *
+ * assert_matches(regex, text) passes if the ECMAScript regular expression
+ * matches somewhere in text. Each call site compiles its regex once. It
+ * needs C++11 (for std::regex); the pattern set assertions do not.
+ */
+
+#ifndef QUICK_UNIT_TEXT_HPP
+#define	QUICK_UNIT_TEXT_HPP
+
+#include <vector>
+#include <map>
+#if __cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)
+ #include <regex>
+ #define QU_HAS_REGEX
+#endif
+
+namespace quick_unit {
+
+/******************************************************************************/
+class QUPatternSet {  // Aho-Corasick automaton for a set of patterns
+/******************************************************************************/
+public:
+  std::vector<std::string> patterns;
+
+  // Returns the automaton for these patterns, building it on first use
+  static const QUPatternSet &Cached(const std::vector<std::string> &patterns) {
+    std::string key;
+    for (size_t i = 0; i < patterns.size(); i++) {
+      key.append(patterns[i]).append(1, '\0');
+    }
+    QUAssertionLock lock; // Matchers can run on many threads at once
+    static std::map<std::string, QUPatternSet> sets;
+    std::map<std::string, QUPatternSet>::iterator found = sets.find(key);
+    if (found == sets.end()) {
+      found = sets.insert(std::make_pair(key, QUPatternSet(patterns))).first;
+    }
+    return found->second;
+  }
+
+  explicit QUPatternSet(const std::vector<std::string> &pattern_list) : patterns(pattern_list) {
+    Build();
+  }
+
+  // Sets first[i] to the offset where patterns[i] first occurs in text, or
+  // to std::string::npos. Stops early once 'enough' patterns have been
+  // found (0 for all). Returns how many were found.
+  size_t Search(const char *text, size_t size, std::vector<size_t> &first, size_t enough = 0) const {
+    first.assign(patterns.size(), std::string::npos);
+    if (enough == 0 || enough > patterns.size()) {
+      enough = patterns.size();
+    }
+    size_t found = 0;
+    found = Record(0, 0, first, found); // Empty patterns
+    const unsigned char *c = (const unsigned char *)text;
+    const unsigned char *end = c + size;
+    int state = 0;
+    while (c < end && found < enough) {
+      if (state == 0 && _single_start >= 0) {
+        // Only one byte can leave the start state; memchr skips to it
+        c = (const unsigned char *)memchr(c, _single_start, end - c);
+        if (!c) {
+          break;
+        }
+      }
+      state = _next[state * 256 + *c++];
+      if (_output_start[state] != _output_start[state + 1]) {
+        found = Record(state, c - (const unsigned char *)text, first, found);
+      }
+    }
+    return found;
+  }
+
+private:
+  std::vector<int> _next;          // 256 transitions per state
+  std::vector<int> _output_start;  // Patterns ending at state s are _outputs[_output_start[s] .. _output_start[s + 1])
+  std::vector<int> _outputs;
+  int _single_start;               // The only byte that leaves state 0, or -1
+
+  size_t Record(int state, size_t offset, std::vector<size_t> &first, size_t found) const {
+    for (int i = _output_start[state]; i < _output_start[state + 1]; i++) {
+      size_t &at = first[_outputs[i]];
+      if (at == std::string::npos) {
+        at = offset - patterns[_outputs[i]].size();
+        found++;
+      }
+    }
+    return found;
+  }
+
+  void Build() {
+    // The trie of patterns
+    std::vector<std::vector<int> > ending(1);
+    _next.assign(256, -1);
+    for (size_t p = 0; p < patterns.size(); p++) {
+      int state = 0;
+      for (size_t i = 0; i < patterns[p].size(); i++) {
+        int &next = _next[state * 256 + (unsigned char)patterns[p][i]];
+        if (next < 0) {
+          next = (int)ending.size();
+          ending.push_back(std::vector<int>());
+          _next.resize(_next.size() + 256, -1);
+        }
+        state = _next[state * 256 + (unsigned char)patterns[p][i]];
+      }
+      ending[state].push_back((int)p);
+    }
+    // Breadth first, fill in the missing transitions from the failure links
+    // and collect the patterns that end at each state
+    std::vector<int> fail(ending.size(), 0);
+    std::vector<int> queue;
+    queue.push_back(0);
+    for (size_t q = 0; q < queue.size(); q++) {
+      int state = queue[q];
+      for (int c = 0; c < 256; c++) {
+        int &next = _next[state * 256 + c];
+        int fallback = state ? _next[fail[state] * 256 + c] : 0;
+        if (next < 0) {
+          next = fallback;
+        } else {
+          fail[next] = fallback;
+          ending[next].insert(ending[next].end(), ending[fallback].begin(), ending[fallback].end());
+          queue.push_back(next);
+        }
+      }
+    }
+    _output_start.push_back(0);
+    for (size_t s = 0; s < ending.size(); s++) {
+      _outputs.insert(_outputs.end(), ending[s].begin(), ending[s].end());
+      _output_start.push_back((int)_outputs.size());
+    }
+    _single_start = -1;
+    for (int c = 0; c < 256; c++) {
+      if (_next[c] != 0) {
+        _single_start = (_single_start == -1) ? c : -2;
+      }
+    }
+    if (_single_start < 0 || !ending[0].empty()) {
+      _single_start = -1;
+    }
+  }
+};
+
+#ifdef QU_HAS_REGEX
+/******************************************************************************/
+class QURegexCache {  // Compiled regexes, one per pattern
+/******************************************************************************/
+public:
+  // Keyed by the text, so a pattern built at run time is compiled once too.
+  // An entry is never replaced, so the regex stays good once the lock is
+  // released, for as long as the program runs.
+  static const std::regex &Compiled(const char *pattern) {
+    std::string key(pattern);
+    QUAssertionLock lock; // Matchers can run on many threads at once
+    static std::map<std::string, std::regex> compiled;
+    std::map<std::string, std::regex>::iterator found = compiled.find(key);
+    if (found == compiled.end()) {
+      found = compiled.insert(std::make_pair(key, std::regex(pattern))).first;
+    }
+    return found->second;
+  }
+};
+#endif
+
+/******************************************************************************/
+class QUTestText : public quick_unit::QU_TEST_ANCESTOR {
+/******************************************************************************/
+public:
+  QUTestText(const char *msg) : quick_unit::QU_TEST_ANCESTOR(msg) {}
+
+  enum { shown = 60 }; // Characters of text shown in a failure
+
+  // Result matchers: pattern sets
+  ADD_MATCHER(includes_all, const std::vector<std::string> &patterns, const char *text, size_t size) {
+    const QUPatternSet &set = QUPatternSet::Cached(patterns);
+    std::vector<size_t> first;
+    if (set.Search(text, size, first) == patterns.size()) {
+      return result(true, "");
+    }
+    _expectation_builder.str("");
+    _expectation_builder << " (Expected to see all of " << patterns.size() << " patterns in " << size << " bytes of text. Missing:";
+    for (size_t i = 0, missing = 0; i < patterns.size(); i++) {
+      if (first[i] == std::string::npos && missing++ < 10) {
+        _expectation_builder << (missing > 1 ? ", '" : " '") << patterns[i] << "'";
+      }
+    }
+    _expectation_builder << ")";
+    _expectation = _expectation_builder.str();
+    return result(false, _expectation);
+  }
+  ADD_MATCHER(excludes_any, const std::vector<std::string> &patterns, const char *text, size_t size) {
+    const QUPatternSet &set = QUPatternSet::Cached(patterns);
+    std::vector<size_t> first;
+    if (set.Search(text, size, first, 1) == 0) {
+      return result(true, "");
+    }
+    size_t i = 0;
+    while (first[i] == std::string::npos) {
+      i++;
+    }
+    size_t line = 1;
+    for (const char *c = text; (c = (const char *)memchr(c, '\n', text + first[i] - c)) != NULL; c++) {
+      line++;
+    }
+    MATCHER(false, " (Expected not to see '" << patterns[i] << "', found at byte " << first[i] << " (line " << line << "): '" << excerpt(text + first[i], text + size) << "')");
+  }
+  ADD_MATCHER(includes_all, const std::vector<std::string> &patterns, const std::string &text) {
+    return includes_all(patterns, text.data(), text.size());
+  }
+  ADD_MATCHER(excludes_any, const std::vector<std::string> &patterns, const std::string &text) {
+    return excludes_any(patterns, text.data(), text.size());
+  }
+  ADD_MATCHER(includes_all, const std::vector<std::string> &patterns, const char *text) {
+    return includes_all(patterns, text, strlen(text));
+  }
+  ADD_MATCHER(excludes_any, const std::vector<std::string> &patterns, const char *text) {
+    return excludes_any(patterns, text, strlen(text));
+  }
+  template <size_t N> ADD_MATCHER(includes_all, const char *const (&patterns)[N], const std::string &text) {
+    return includes_all(std::vector<std::string>(patterns, patterns + N), text.data(), text.size());
+  }
+  template <size_t N> ADD_MATCHER(excludes_any, const char *const (&patterns)[N], const std::string &text) {
+    return excludes_any(std::vector<std::string>(patterns, patterns + N), text.data(), text.size());
+  }
+  template <size_t N> ADD_MATCHER(includes_all, const char *const (&patterns)[N], const char *text) {
+    return includes_all(std::vector<std::string>(patterns, patterns + N), text, strlen(text));
+  }
+  template <size_t N> ADD_MATCHER(excludes_any, const char *const (&patterns)[N], const char *text) {
+    return excludes_any(std::vector<std::string>(patterns, patterns + N), text, strlen(text));
+  }
+
+  #ifdef QU_HAS_REGEX
+  // Result matcher: regular expressions
+  ADD_MATCHER(matches, const char *regex, const std::string &text) {
+    MATCHER(std::regex_search(text, QURegexCache::Compiled(regex)), " (Expected to match /" << regex << "/ in " << text.size() << " bytes of text: '" << excerpt(text.data(), text.data() + text.size()) << "')");
+  }
+  #endif
+
+  // Assertions
+  ADD_ASSERTION(include_all, const std::vector<std::string> &patterns, const std::string &text) {ASSERTION(includes_all(patterns, text));}
+  ADD_ASSERTION(exclude_any, const std::vector<std::string> &patterns, const std::string &text) {ASSERTION(excludes_any(patterns, text));}
+  template <size_t N> ADD_ASSERTION(include_all, const char *const (&patterns)[N], const std::string &text) {ASSERTION(includes_all(patterns, text));}
+  template <size_t N> ADD_ASSERTION(exclude_any, const char *const (&patterns)[N], const std::string &text) {ASSERTION(excludes_any(patterns, text));}
+  ADD_ASSERTION(include_all, const std::vector<std::string> &patterns, const char *text) {ASSERTION(includes_all(patterns, text));}
+  ADD_ASSERTION(exclude_any, const std::vector<std::string> &patterns, const char *text) {ASSERTION(excludes_any(patterns, text));}
+  template <size_t N> ADD_ASSERTION(include_all, const char *const (&patterns)[N], const char *text) {ASSERTION(includes_all(patterns, text));}
+  template <size_t N> ADD_ASSERTION(exclude_any, const char *const (&patterns)[N], const char *text) {ASSERTION(excludes_any(patterns, text));}
+  #ifdef QU_HAS_REGEX
+  ADD_ASSERTION(matches, const char *regex, const std::string &text) {ASSERTION(matches(regex, text));}
+  #endif
+
+protected:
+  // The start of the text, up to the end of its line
+  static std::string excerpt(const char *text, const char *end) {
+    const char *stop = text;
+    while (stop < end && stop < text + shown && *stop != '\n') {
+      stop++;
+    }
+    return std::string(text, stop) + (stop < end && *stop != '\n' ? "..." : "");
+  }
+};
+#undef QU_TEST_ANCESTOR
+#define QU_TEST_ANCESTOR QUTestText
+
+} /* quick_unit */
+
+#endif	/* QUICK_UNIT_TEXT_HPP */
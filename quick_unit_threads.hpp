@@ -0,0 +1,116 @@
+/*
+ * quick_unit_threads.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This add-in to quick_unit runs a test body on many threads at once, to
+ *  hammer code that is meant to be thread safe. It needs C++11.
+ *
+ * TCriticalSection section;
+ * int total = 0;
+ *
+ * STRESS_TEST(Concurrent adds are not lost, 8) {
+ *   for (int i = 0; i < 10000; i++) {
+ *     section.Acquire();
+ *     total++;
+ *     section.Release();
+ *   }
+ *   assert(total > 0, SHOULD(count));
+ * }
+ *
+ * The body runs on 8 threads, which wait at a barrier until they have all
+ * started and are then let go together. Each gets its number (0 to 7) in
+ * 'thread'. The test fails if any thread fails; the first failure is the
+ * one reported, along with its thread number. A failed assertion ends only
+ * the thread that made it.
+ *
+ * Assertions and printf() can also be used from threads that an ordinary
+ * TEST starts itself. A failure there is recorded rather than thrown (the
+ * thread carries on), and fails the test when it finishes. Join the
+ * threads before the test ends.
+ */
+
+#ifndef QUICK_UNIT_THREADS_HPP
+#define	QUICK_UNIT_THREADS_HPP
+
+#ifndef QU_THREADS
+ #error quick_unit_threads.hpp needs C++11
+#endif
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+namespace quick_unit {
+
+/******************************************************************************/
+class QUStress {  // Runs a test body on several threads
+/******************************************************************************/
+public:
+  template <class T> static void Run(T *test, unsigned threads, void (T::*body)(unsigned)) {
+    std::atomic<unsigned> arrived(0);
+    std::vector<std::thread> workers;
+    #ifndef QU_NO_EXCEPTIONS
+    try {
+    #endif
+      for (unsigned thread = 0; thread < threads; thread++) {
+        workers.push_back(std::thread(Worker<T>, test, body, thread, threads, &arrived));
+      }
+    #ifndef QU_NO_EXCEPTIONS
+    } catch(...) {
+      arrived += threads; // Let the threads that did start go, then give up
+      Join(workers);
+      throw;
+    }
+    #endif
+    Join(workers);
+  }
+
+private:
+  template <class T> struct Call { // A thread's body, for QUTestFail::Catch()
+    T *test;
+    void (T::*body)(unsigned);
+    unsigned thread;
+    static void Run(void *call) {
+      Call *stress = (Call *)call;
+      (stress->test->*stress->body)(stress->thread);
+    }
+  };
+
+  static void Join(std::vector<std::thread> &workers) {
+    for (size_t i = 0; i < workers.size(); i++) {
+      workers[i].join();
+    }
+  }
+
+  template <class T> static void Worker(T *test, void (T::*body)(unsigned), unsigned thread, unsigned threads, std::atomic<unsigned> *arrived) {
+    std::ostringstream name;
+    name << "thread " << thread;
+    QUAssertionLock::ThreadName() = name.str();
+    QUAssertionLock::ThrowsFailures() = true;
+    // Spin rather than block at the barrier, so the threads set off as
+    // close together as the scheduler allows
+    arrived->fetch_add(1);
+    while (arrived->load() < threads) {
+      std::this_thread::yield();
+    }
+    Call<T> call = {test, body, thread};
+    #ifdef QU_NO_EXCEPTIONS
+    QUTestFail::Catch(Call<T>::Run, &call); // A failure is recorded by the assertion
+    #else
+    try {
+      QUTestFail::Catch(Call<T>::Run, &call); // A failure is recorded by the assertion
+    } catch(...) {
+      QUAssertionLock lock;
+      test->force_fail_message((name.str() + ": unexpected exception in the test.").c_str());
+    }
+    #endif
+  }
+};
+
+} /* quick_unit */
+
+// MUST be on a single line
+#define STRESS_TEST(name, threads) namespace { class QU_UNIQ_ID(QUTest) : public QU_TEST_ANCESTOR {public: QU_UNIQ_ID(QUTest)() : QU_TEST_ANCESTOR(#name) {if (QUTestSuiteTracker::CurrentQUTestSuite()) {QUTestSuiteTracker::CurrentQUTestSuite()->Add(this);}} void Run(void) { quick_unit::QUStress::Run(this, threads, &QU_UNIQ_ID(QUTest)::Stress); } void Stress(unsigned thread); } static QU_UNIQ_ID(test);} void QU_UNIQ_ID(QUTest)::Stress(unsigned thread)
+
+#endif	/* QUICK_UNIT_THREADS_HPP */
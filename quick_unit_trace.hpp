@@ -0,0 +1,173 @@
+/*
+ * quick_unit_trace.hpp : http://github.com/rifraf/quick_unit
+ * Author: David Lake
+ *
+ * Description:
+ *  This is a reporter add-in for quick_unit that writes a timeline of the
+ *  run in the Chrome trace-event format, to open in chrome://tracing or
+ *  https://ui.perfetto.dev. It shows where the time goes: each suite and
+ *  test, SETUP_SUITE/TEARDOWN_SUITE, SETUP/TEARDOWN, FIXTUREs being built
+ *  and released, and the reporters taking each test's results.
+ *
+ *   #include "quick_unit.hpp"
+ *   #include "quick_unit_trace.hpp"
+ *
+ *   ADDITIONAL_REPORTER(Trace)
+ *   DECLARE_SUITE(My First Tests)
+ *
+ * and run the tests with --trace=<file> (or set QU_TRACE). Without it the
+ * reporter does nothing, and the runner does not time anything for it.
+ *
+ * Each worker has a track of its own: the runner, each child forked by
+ * --fork, and each ASYNC_TEST running alongside the others. Counters show
+ * the tests still waiting in the suite and the ASYNC_TESTs still running.
+ * Each RECORD_METRIC name is a counter too, set as each test is reported.
+ *
+ * Events are written as they happen, so a trace of any size takes no
+ * memory. Forked children write their own events to the same file. If the
+ * run dies the file is left without its closing "]", which the viewers
+ * still read.
+ */
+
+#ifndef QUICK_UNIT_TRACE_HPP
+#define	QUICK_UNIT_TRACE_HPP
+
+#include <set>
+#ifdef _WIN32
+ #include <process.h>
+ #define getpid _getpid
+#else
+ #include <unistd.h>
+#endif
+
+BEGIN_REPORTER(Trace)
+  // Writes to path, or if that is NULL to the file named by --trace
+  TraceReporter(const char *path = NULL) {
+    _path = path ? path : "";
+    _file = NULL;
+    _tried = false;
+    _pid = 0;
+    _origin = 0;
+  }
+  ~TraceReporter() { Close(); }
+
+  bool WantsSpans(void) { return File() != NULL; }
+
+  void SpanById(QUSpanKind kind, QUNameId suite, QUNameId name, double start, double end, unsigned lane) {
+    static const char *const categories[] = {"suite", "suite setup", "suite teardown", "test", "test setup", "test teardown", "fixture setup", "fixture teardown", "reporting"};
+    static const char *const prefixes[] = {"", "set up ", "tear down ", "", "set up ", "tear down ", "build ", "release ", "report "};
+    FILE *file = File();
+    if (file) {
+      long track = Track(lane);
+      fprintf(file, "{\"name\":\"%s%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,\"args\":{\"suite\":\"%s\"}},\n",
+        prefixes[kind], QUNames::Form(name, Escaped()).c_str(), categories[kind], Microseconds(start), (end - start) * 1e6,
+        _pid, track, QUNames::Form(suite, Escaped()).c_str());
+    }
+  }
+
+  void CounterById(QUNameId suite, const char *counter, double value) {
+    FILE *file = File();
+    if (file) {
+      fprintf(file, "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%ld,\"args\":{\"%s\":%g}},\n",
+        counter, Microseconds(QUReporter::now()), _pid, counter, value);
+    }
+  }
+
+  void TestMetricById(QUNameId suite, QUNameId test, const QUMetric &metric) {
+    FILE *file = File();
+    if (file) {
+      std::string unit = metric.unit.empty() ? "value" : json_escaped(metric.unit);
+      fprintf(file, "{\"name\":\"%s\",\"cat\":\"metric\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%ld,\"args\":{\"%s\":%.15g",
+        json_escaped(metric.name).c_str(), Microseconds(QUReporter::now()), _pid, unit.c_str(), metric.value);
+      if (metric.per_second > 0) {
+        fprintf(file, ",\"%s/s\":%.15g", unit.c_str(), metric.per_second);
+      }
+      fprintf(file, "}},\n");
+    }
+  }
+
+  void CompletedSuiteById(QUNameId suite, double duration, unsigned passes, unsigned fails) {
+    if (_file) {
+      fflush(_file);
+    }
+  }
+
+  // Ends the trace. Only the process that opened it closes it.
+  void Close(void) {
+    if (_file && (long)getpid() == _pid) {
+      fprintf(_file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"args\":{\"name\":\"quick_unit\"}}\n]\n", _pid);
+      fclose(_file);
+      _file = NULL;
+    }
+  }
+
+  static std::string json_escaped(const std::string &str) {
+    std::string escaped;
+    for (size_t i = 0; i < str.length(); i++) {
+      unsigned char c = (unsigned char)str[i];
+      if (c == '"' || c == '\\') {
+        escaped += '\\';
+        escaped += (char)c;
+      } else if (c < 0x20) {
+        char code[8];
+        sprintf(code, "\\u%04x", c);
+        escaped += code;
+      } else {
+        escaped += (char)c;
+      }
+    }
+    return escaped;
+  }
+
+private:
+  std::string _path;
+  FILE *_file;
+  bool _tried;
+  long _pid;              // The process that opened the file
+  double _origin;         // now() when it was opened
+  std::set<long> _named;  // Tracks that have been given names
+
+  static unsigned Escaped() { static unsigned form = QUNames::AddForm(json_escaped); return form; }
+
+  FILE *File(void) {
+    if (!_tried) {
+      _tried = true;
+      if (_path.empty()) {
+        const char *option = QUOptionTracker::Option("trace");
+        _path = option ? option : "";
+      }
+      if (!_path.empty()) {
+        _file = fopen(_path.c_str(), "w");
+      }
+      if (_file) {
+        _pid = (long)getpid();
+        _origin = QUReporter::now();
+        fprintf(_file, "[\n");
+      }
+    }
+    return _file;
+  }
+
+  double Microseconds(double time) { return (time - _origin) * 1e6; }
+
+  // The runner's track has its process ID, as does a forked child's. Lanes
+  // are numbered above any process ID.
+  long Track(unsigned lane) {
+    long process = (long)getpid();
+    long track = lane ? 1000000000L + (long)lane : process;
+    if (_named.insert(track).second) {
+      char name[64];
+      if (lane) {
+        sprintf(name, "lane %u", lane);
+      } else if (process == _pid) {
+        sprintf(name, "runner");
+      } else {
+        sprintf(name, "forked child %ld", process);
+      }
+      fprintf(_file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}},\n", _pid, track, name);
+    }
+    return track;
+  }
+END_REPORTER()
+
+#endif	/* QUICK_UNIT_TRACE_HPP */